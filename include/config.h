@@ -1,23 +1,126 @@
 // Network config ***********************************************************
 
 /** 
- * Maximum message size.
+ * Default maximum message size.
+ * 
+ * It bounds the messages that can be written and received. The server sets
+ * its own at startup (--max-msg-size), smaller to reduce the memory of each
+ * connection or larger up to MAX_MSG_SIZE_LIMIT.
  * 
  * TODO: it is random, calculate it
  */
 #define MAX_MSG_SIZE 8192
 
+/**
+ * Largest value of the maximum message size: a packet, including its length,
+ * must fit in the 16-bit length field
+ */
+#define MAX_MSG_SIZE_LIMIT (65535 - 2)
+
+/**
+ * Maximum number of free receive buffers kept for reuse. The buffer of a
+ * received encrypted message is handed over to it and given back once the
+ * message has been handled (see SocketWrapper).
+ */
+#define RECV_BUFFER_POOL_SIZE 1024
+
+/**
+ * Maximum number of free send buffers kept for reuse. Messages are serialized
+ * in a buffer of the maximum message size taken for the duration of the send.
+ */
+#define SEND_BUFFER_POOL_SIZE 64
+
 
 
 
 // Server config ************************************************************
-#define MAX_USERS 1024
+// Defaults of the settings of the server config file (see server_config.h)
+
+/** Maximum number of connected users (not limited by FD_SETSIZE) */
+#define MAX_USERS 16384
+
+/**
+ * Maximum number of received messages of a user waiting to be handled, users
+ * sending more than that are disconnected
+ */
 #define MAX_QUEUE_LENGTH 1000
-#define N_THREADS 4
+
+/** Smallest accepted value of the maximum size of received messages */
+#define MIN_MSG_SIZE 1024
+
+/**
+ * Number of ephemeral ECDH keys generated in advance for the handshakes, 0 to
+ * generate them during the handshake
+ */
+#define EPH_KEY_POOL_SIZE 64
+
+/** Maximum value of the number of keys generated in advance */
+#define EPH_KEY_POOL_MAX_SIZE 1024
+
+/** Interval between two logs of the counters of the key pool (seconds) */
+#define EPH_KEY_POOL_LOG_INTERVAL 60
+
+/** Maximum number of messages of a user handled before switching to another */
+#define MAILBOX_BATCH 16
+
+/**
+ * Number of event loop threads, each one with its own listening socket on
+ * the server port (SO_REUSEPORT) and its own connections
+ */
+#define N_REACTORS 4
+
+/** Maximum number of event loop threads */
+#define MAX_REACTORS 256
+
+/**
+ * Default high-water mark of the outbound queue of a connection (bytes):
+ * clients that do not read fast enough to stay below it are disconnected
+ */
+#define MAX_OUTBOUND_BYTES (256*1024)
+
+/** Maximum number of queued messages written with a single sendmsg */
+#define MAX_WRITE_IOV 64
+
+/** Maximum number of events returned by a call to epoll_wait */
+#define EPOLL_MAX_EVENTS 64
+
+/** Sizes of the submission and completion rings of the io_uring backend */
+#define URING_ENTRIES 256
+#define URING_CQ_ENTRIES 4096
+
+/** Receive buffers given to the kernel by the io_uring backend */
+#define URING_N_BUFFERS 1024
+#define URING_BUFFER_SIZE 4096
 
 // Client config ************************************************************
 #define N_IN_A_ROW 4
 
+/** Time budget per move of the HARD and EXPERT AI levels (ms) */
+#define AI_HARD_TIME_MS 100
+#define AI_EXPERT_TIME_MS 1000
+
+/** Default size of the transposition table of the AI (MiB) */
+#define AI_DEFAULT_HASH_MB 16
+
+/** Maximum number of search threads of the AI */
+#define AI_MAX_THREADS 64
+
+/** Opening book loaded by default in single player mode, if present */
+#define AI_DEFAULT_BOOK "connect4.book"
+
+/** Default size of the transposition table of the solver (MiB) */
+#define SOLVER_DEFAULT_HASH_MB 64
+
+/** Playouts per move of the EASY and MEDIUM levels of the MCTS AI */
+#define MCTS_EASY_PLAYOUTS 1000
+#define MCTS_MEDIUM_PLAYOUTS 20000
+
+/** Maximum number of nodes of the MCTS tree (allocated once) */
+#define MCTS_DEFAULT_NODES (1 << 20)
+
+/** Maximum number of columns of a board played by the MCTS AI */
+#define MCTS_MAX_COLS 64
+
 // Misc *********************************************************************
 #define MAX_USERS_IN_MESSAGE 10
 #define MAX_USERNAME_LENGTH 16
@@ -81,7 +81,7 @@ inline void printtime(FILE* dbgstream){
 
 #define LOG(level, ...) do {  \
                           if (level <= LOG_LEVEL) { \
-                            FILE *dbgstream; \
+                            FILE *dbgstream = stderr; \
                             char where[50]; \
                             switch(level){ \
                               case LOG_FATAL: \
@@ -0,0 +1,69 @@
+/**
+ * @file buffer_pool.h
+ *
+ * @brief Definition of the BufferPool class
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <pthread.h>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Pool of equally sized buffers.
+ *
+ * Buffers that are released go back to the pool (up to a maximum number of
+ * free buffers) and are handed out again, so that in steady state getting a
+ * buffer does not allocate. Buffers may be released by a thread other than
+ * the one that got them.
+ *
+ * Thread-safe.
+ */
+class BufferPool{
+private:
+    size_t buffer_size;
+    size_t max_free;
+    std::vector<char*> free_buffers;
+    pthread_mutex_t mutex;
+
+    /** Non copyable */
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+public:
+    /**
+     * Constructor
+     *
+     * @param buffer_size   size of the buffers
+     * @param max_free      maximum number of free buffers kept in the pool
+     */
+    BufferPool(size_t buffer_size, size_t max_free);
+
+    ~BufferPool();
+
+    /**
+     * Changes the size of the buffers returned from now on.
+     *
+     * Free buffers of the old size are deleted, busy ones are deleted when
+     * they are released.
+     */
+    void setBufferSize(size_t size);
+
+    /**
+     * Returns a buffer, allocating it if the pool is empty.
+     *
+     * @param size  set to the size of the buffer
+     */
+    char* get(size_t* size);
+
+    /**
+     * Gives a buffer back to the pool.
+     *
+     * @param buf   the buffer, returned by get()
+     * @param size  its size, as returned by get()
+     */
+    void put(char* buf, size_t size);
+};
+
+#endif // BUFFER_POOL_H
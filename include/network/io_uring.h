@@ -0,0 +1,129 @@
+/**
+ * @file io_uring.h
+ *
+ * @brief Definition of a minimal wrapper around the io_uring system calls
+ */
+
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+/**
+ * Submission and completion rings of an io_uring instance.
+ *
+ * Only the operations needed by the server are wrapped. The rings are used by
+ * a single thread: operations are prepared with the prep*() functions and
+ * submitted all at once by submit(), completions are read with peekCqe() and
+ * released with advanceCq().
+ *
+ * The constructor throws if the kernel does not support io_uring.
+ */
+class IoUring{
+private:
+    int ring_fd;
+
+    /** Submission ring, shared with the kernel */
+    void* sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    /** Tail of the prepared entries, not yet visible to the kernel */
+    unsigned sqe_tail;
+
+    /** Number of entries prepared since the last submission */
+    unsigned to_submit;
+
+    /** Completion ring, shared with the kernel */
+    void* cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe* cqes;
+
+    /**
+     * Returns a free and zeroed submission entry, submitting the prepared
+     * ones if the ring is full.
+     */
+    struct io_uring_sqe* getSqe();
+
+    /** Non copyable */
+    IoUring(const IoUring&);
+    IoUring& operator=(const IoUring&);
+
+public:
+    /**
+     * Creates the rings.
+     *
+     * @param entries       size of the submission ring
+     * @param cq_entries    size of the completion ring
+     */
+    IoUring(unsigned entries, unsigned cq_entries);
+
+    ~IoUring();
+
+    /**
+     * Checks whether the kernel supports io_uring and the given operations.
+     *
+     * @param ops   the IORING_OP_* codes
+     * @param n     number of codes
+     */
+    static bool isSupported(const uint8_t* ops, int n);
+
+    /**
+     * Accepts a connection. The result is the new socket.
+     */
+    void prepAccept(int fd, struct sockaddr* addr, socklen_t* addrlen,
+                    uint64_t user_data);
+
+    /**
+     * Receives up to len bytes into a buffer chosen by the kernel from the
+     * given group (see prepProvideBuffers()). The id of the buffer is in the
+     * flags of the completion (IORING_CQE_BUFFER_SHIFT).
+     */
+    void prepRecvSelect(int fd, size_t len, uint16_t group, uint64_t user_data);
+
+    /**
+     * Sends the buffers described by msg with a single operation.
+     *
+     * msg and its iovec must stay valid until the completion.
+     */
+    void prepSendmsg(int fd, const struct msghdr* msg, int flags, uint64_t user_data);
+
+    /**
+     * Reads from any file descriptor (e.g. an eventfd).
+     */
+    void prepRead(int fd, void* buf, size_t len, uint64_t user_data);
+
+    /**
+     * Gives n contiguous buffers of len bytes to the kernel, with ids starting
+     * from bid.
+     */
+    void prepProvideBuffers(void* addr, size_t len, int n, uint16_t group,
+                            uint16_t bid, uint64_t user_data);
+
+    /**
+     * Submits all the prepared operations.
+     *
+     * @param wait_nr   number of completions to wait for
+     * @returns the number of submitted operations or -errno
+     */
+    int submit(unsigned wait_nr = 0);
+
+    /**
+     * Returns the oldest completion, NULL if there are none.
+     */
+    struct io_uring_cqe* peekCqe();
+
+    /**
+     * Releases the completion returned by peekCqe().
+     */
+    void advanceCq();
+};
+
+#endif // IO_URING_H
@@ -19,6 +19,7 @@
 #include "config.h"
 #include "network/inet_utils.h"
 #include "network/host.h"
+#include "network/buffer_pool.h"
 #include "security/crypto.h"
 #include "security/secure_host.h"
 
@@ -99,6 +100,13 @@ enum MessageType
 class Message
 {
 public:
+    /**
+     * Maximum size of the messages, MAX_MSG_SIZE unless changed at startup.
+     * 
+     * Messages are written in buffers of at least this size.
+     */
+    static msglen_t max_size;
+
     virtual ~Message(){};
     /** 
      * Write message to buffer
@@ -230,15 +238,20 @@ public:
 
 /**
  * Message that the server sends the client with the list of users
+ * 
+ * The cursor is opaque to the client: it is sent back in the next request to
+ * get the following page. It is empty if there are no more users.
  */
 class UsersListMessage : public Message
 {
 private:
     string usernames;
+    string cursor;
 
 public:
     UsersListMessage() {}
-    UsersListMessage(string usernames) : usernames(usernames) {}
+    UsersListMessage(string usernames, string cursor="") 
+            : usernames(usernames), cursor(cursor) {}
     ~UsersListMessage() {}
 
     msglen_t write(char *buffer);
@@ -248,20 +261,27 @@ public:
 
     string getUsernames() { return usernames; }
 
+    string getCursor() { return cursor; }
+
     MessageType getType() { return USERS_LIST; }
 };
 
 /**
  * Message with which the client asks for the list of connected users.
+ * 
+ * The list starts after the cursor returned by the previous UsersListMessage
+ * if there is one, at the given offset otherwise.
  */
 class UsersListRequestMessage : public Message
 {
 private:
     uint32_t offset;
+    string cursor;
 
 public:
     UsersListRequestMessage() : offset(0) {}
-    UsersListRequestMessage(unsigned int offset) : offset(offset) {}
+    UsersListRequestMessage(unsigned int offset, string cursor="") 
+            : offset(offset), cursor(cursor) {}
     ~UsersListRequestMessage() {}
 
     msglen_t write(char *buffer);
@@ -271,6 +291,8 @@ public:
 
     uint32_t getOffset() { return offset; }
 
+    string getCursor() { return cursor; }
+
     MessageType getType() { return USERS_LIST_REQ; }
 };
 
@@ -360,7 +382,7 @@ private:
     X509* cert;
 
 public:
-    GameStartMessage() {}
+    GameStartMessage() : cert(NULL) {}
     GameStartMessage(string username, struct sockaddr_in addr, X509* opp_cert)
         : username(username), addr(addr), cert(opp_cert) {} //TODO cert
     ~GameStartMessage() {}
@@ -377,6 +399,14 @@ public:
     MessageType getType() { return GAME_START; }
 };
 
+/**
+ * Encrypted message.
+ * 
+ * It does not copy the ciphertext and the tag: they are pointers into the
+ * buffer the message has been read from, where they are also decrypted in
+ * place. Unless the message is given that buffer with adoptBuffer(), it is
+ * valid only until the buffer is reused.
+ */
 class SecureMessage : public Message
 {
 private:
@@ -384,10 +414,25 @@ private:
     msglen_t ct_size;
     char* tag;
 
+    /** Buffer holding ct and tag, if owned by the message */
+    char* buffer;
+    size_t buffer_size;
+    BufferPool* pool;
+
 public:
-    SecureMessage() : ct(NULL), ct_size(0), tag(NULL){}
-    SecureMessage(char* ct, msglen_t ct_size, char* tag) : ct(ct), ct_size(ct_size), tag(tag){}
-    ~SecureMessage(){ if (ct != NULL) free(ct); if (tag != NULL) free(tag); }
+    SecureMessage() : ct(NULL), ct_size(0), tag(NULL), 
+                      buffer(NULL), buffer_size(0), pool(NULL){}
+    ~SecureMessage(){ if (buffer != NULL) pool->put(buffer, buffer_size); }
+
+    /**
+     * Takes ownership of the buffer the message has been read from, which is
+     * given back to the pool when the message is deleted.
+     */
+    void adoptBuffer(char* buffer, size_t size, BufferPool* pool){
+        this->buffer = buffer;
+        this->buffer_size = size;
+        this->pool = pool;
+    }
 
     MessageType getType() { return SECURE_MESSAGE; }
     string getName() { return "Secure message"; }
@@ -401,6 +446,12 @@ public:
     msglen_t read(char *buffer, msglen_t len);
 };
 
+/**
+ * First message of the handshake.
+ * 
+ * The cipher suite of the ephemeral key follows the key, so that peers that
+ * do not send it (P-256) can still be read.
+ */
 class ClientHelloMessage: public Message
 {
 private:
@@ -408,11 +459,14 @@ private:
     nonce_t nonce;
     string my_id;
     string other_id;
+    CipherSuite suite;
 
 public:
-    ClientHelloMessage() : eph_key(NULL) {}
-    ClientHelloMessage(EVP_PKEY* eph_key, nonce_t nonce, string my_id, string other_id) 
-        : eph_key(eph_key), nonce(nonce), my_id(my_id), other_id(other_id) {}
+    ClientHelloMessage() : eph_key(NULL), suite(SUITE_P256) {}
+    ClientHelloMessage(EVP_PKEY* eph_key, nonce_t nonce, string my_id, string other_id,
+                       CipherSuite suite) 
+        : eph_key(eph_key), nonce(nonce), my_id(my_id), other_id(other_id),
+          suite(suite) {}
 
     MessageType getType() {return CLIENT_HELLO; }
     string getName() { return "Client Hello message"; }
@@ -422,6 +476,7 @@ public:
     void setEphKey(EVP_PKEY* eph_key) { this->eph_key=eph_key; }
     string getMyId() { return my_id; }
     string getOtherId() { return other_id; }
+    CipherSuite getSuite() { return suite; }
 
     msglen_t write(char* buffer);
     msglen_t read(char* buffer, msglen_t len);
@@ -448,6 +503,11 @@ public:
     msglen_t read(char* buffer, msglen_t len);
 };
 
+/**
+ * Answer to the ClientHello.
+ * 
+ * Like in the ClientHello, the cipher suite follows the ephemeral key.
+ */
 class ServerHelloMessage: public Message
 {
 private:
@@ -457,11 +517,14 @@ private:
     string other_id;
     char* ds;
     uint32_t ds_size;
+    CipherSuite suite;
 
 public:
-    ServerHelloMessage() : eph_key(NULL), ds(NULL), ds_size(0) {}
-    ServerHelloMessage(EVP_PKEY* eph_key, nonce_t nonce, string my_id, string other_id, char* ds, uint32_t ds_size) 
-        : eph_key(eph_key), nonce(nonce), my_id(my_id), other_id(other_id), ds(ds), ds_size(ds_size) {}
+    ServerHelloMessage() : eph_key(NULL), ds(NULL), ds_size(0), suite(SUITE_P256) {}
+    ServerHelloMessage(EVP_PKEY* eph_key, nonce_t nonce, string my_id, string other_id, char* ds, uint32_t ds_size,
+                       CipherSuite suite) 
+        : eph_key(eph_key), nonce(nonce), my_id(my_id), other_id(other_id), ds(ds), ds_size(ds_size),
+          suite(suite) {}
     ~ServerHelloMessage();
 
     MessageType getType() {return SERVER_HELLO; }
@@ -474,6 +537,7 @@ public:
     string getOtherId() { return other_id; }
     char* getDs() { return ds; }
     uint32_t getDsSize() { return ds_size; }
+    CipherSuite getSuite() { return suite; }
 
     msglen_t write(char* buffer);
     msglen_t read(char* buffer, msglen_t len);
@@ -15,6 +15,38 @@
 #include "logging.h"
 #include "network/messages.h"
 #include "network/host.h"
+#include "network/buffer_pool.h"
+
+/**
+ * Destination of the serialized messages of a SocketWrapper.
+ *
+ * By default messages are written to the socket with send(). An I/O backend
+ * that owns the socket (e.g. io_uring) can take over the writes by setting a
+ * sender, which receives the whole packet (header included).
+ */
+class MessageSender{
+public:
+    virtual ~MessageSender(){}
+
+    /**
+     * Sends (or queues) a serialized packet. The buffer is reused after the
+     * call so it must be copied if needed.
+     *
+     * @returns 0 in case of success, something else otherwise
+     */
+    virtual int send(const char* buf, size_t len) = 0;
+
+    /**
+     * Holds the packets back until uncork(), so that the packets sent in
+     * between are written together.
+     */
+    virtual void cork(){}
+
+    /**
+     * Writes the packets held back since cork().
+     */
+    virtual void uncork(){}
+};
 
 /**
  * Wrapper class around sockaddr_in and socket descriptor
@@ -30,14 +62,54 @@ protected:
     /** Socket file descriptor */
     int socket_fd;
 
-    /** Pre-allocated buffer for incoming messages */
-    char buffer_in[MAX_MSG_SIZE];
+    /**
+     * Receive buffers, whose size is the maximum size of the incoming
+     * messages of new sockets.
+     * 
+     * Never destroyed: messages holding a buffer may be deleted by other
+     * threads while the process exits.
+     */
+    static BufferPool* buffers;
+
+    /**
+     * Buffers the outgoing messages are serialized in, whose size is the
+     * maximum message size plus the packet header.
+     * 
+     * Never destroyed, like buffers.
+     */
+    static BufferPool* send_buffers;
+
+    /** Buffer for incoming messages, taken from buffers */
+    char* buffer_in;
 
-    /** Pre-allocated buffer for outgoing messages */
-    char buffer_out[MAX_MSG_SIZE];
+    /** Size of buffer_in, maximum size of the incoming messages */
+    msglen_t buffer_in_size;
 
     /** Index in the buffer that has been read up to now */
     msglen_t buf_idx;
+
+    /** Sender of the outgoing messages, NULL to use send() */
+    MessageSender* sender;
+
+    /**
+     * Returns the number of bytes still needed to complete the length field
+     * or, once the length is known, the current message.
+     */
+    msglen_t missingBytes();
+
+    /**
+     * Accounts for len new bytes written in buffer_in at buf_idx.
+     *
+     * A complete SecureMessage is given buffer_in, which is replaced with
+     * a buffer from the pool, so that it stays valid after the call without
+     * copying it.
+     *
+     * Throws if the message length is not valid.
+     *
+     * @returns the message if it is complete, NULL otherwise or if it was
+     *          malformed (and discarded)
+     */
+    Message* appendedBytes(msglen_t len);
 public:
     /** 
      * Initialize on a new socket
@@ -47,9 +119,20 @@ public:
     /** 
      * Initialize using existing socket
      */
-    SocketWrapper(int sd) : socket_fd(sd), buf_idx(0) {}
+    SocketWrapper(int sd);
 
-    ~SocketWrapper(){closeSocket();}
+    ~SocketWrapper();
+
+    /**
+     * Sets the maximum size of the messages, which is also the size of the
+     * receive buffer of the sockets created from now on and of the buffers
+     * the messages are sent from.
+     *
+     * To be called at startup, before any message is sent.
+     *
+     * @param size  the size, at most MAX_MSG_SIZE_LIMIT
+     */
+    static void setMaxMsgSize(msglen_t size);
 
     /** 
      * Returns current socket file descriptor
@@ -60,18 +143,42 @@ public:
      * Read any new data from the socket but does not wait for the 
      * whole message to be ready.
      * 
-     * This API is blocking iff socket was not ready.
+     * This API is never blocking: it reads until either a whole message is
+     * ready or no more data is available. Partial messages are kept in the
+     * buffer until the next call. Call it until it returns NULL to consume all
+     * the available data (as required by edge-triggered epoll).
      * 
-     * @param size the size of the temporary buffer
-     * @returns the received message or null if an error occurred
+     * Throws in case of error or if the connection was closed.
+     * 
+     * @returns the received message or null if no whole message is available
      */
     Message* readPartMsg();
 
+    /**
+     * Parses data that has already been read from the socket by someone
+     * else (e.g. an io_uring receive).
+     *
+     * Bytes are consumed up to the end of the first complete message: data
+     * and len are advanced accordingly. Call it until it returns NULL to
+     * consume all the data. Partial messages are kept in the buffer until the
+     * next call.
+     *
+     * Throws if the message length is not valid.
+     *
+     * @param data  pointer to the received bytes, advanced
+     * @param len   pointer to the number of received bytes, decreased
+     * @returns the received message or null if no whole message is available
+     */
+    Message* consumeBytes(const char** data, size_t* len);
+
     /** 
      * Receive any new message from the socket.
      * 
      * This API is blocking.
      * 
+     * A returned SecureMessage points into the receive buffer: it must be
+     * handled before receiving the next message.
+     * 
      * @returns the received message or null if an error occurred
      */
     Message* receiveAnyMsg();
@@ -109,6 +216,37 @@ public:
      */
     int sendMsg(Message *msg);
 
+    /**
+     * Sends an already serialized packet (header included) to the peer host.
+     * 
+     * @param buf the packet
+     * @param len the length of the packet
+     * @returns 0 in case of success, something else otherwise
+     */
+    int sendPacket(const char* buf, msglen_t len);
+
+    /**
+     * Sets the sender of the outgoing messages.
+     *
+     * The sender is owned by the SocketWrapper and deleted with it.
+     */
+    void setSender(MessageSender* sender){delete this->sender; this->sender = sender;}
+
+    /**
+     * Holds the outgoing messages back until uncork(), if supported by the
+     * sender.
+     *
+     * @see MessageSender::cork()
+     */
+    void cork(){if (sender != NULL) sender->cork();}
+
+    /**
+     * Writes the outgoing messages held back since cork().
+     *
+     * @see MessageSender::uncork()
+     */
+    void uncork(){if (sender != NULL) sender->uncork();}
+
     /**
      * Closes the socket.
      */
@@ -173,11 +311,33 @@ public:
      */
     int bindPort();
 
+    /**
+     * Allows other sockets to bind to the same port (SO_REUSEPORT), the
+     * kernel then spreads the incoming connections among them.
+     *
+     * Must be called before bindPort().
+     *
+     * @returns true in case of success
+     */
+    bool setReusePort();
+
     /**
      * Accepts any incoming connection and returns the related SocketWrapper.
+     * 
+     * @returns the new SocketWrapper or NULL in case of error or if the socket
+     *          is non-blocking and there are no pending connections
      */
     SocketWrapper* acceptClient();
 
+    /**
+     * Returns the SocketWrapper of a connection that has been accepted
+     * by someone else (e.g. an io_uring accept).
+     *
+     * @param sd    the socket of the connection
+     * @param addr  the address of the client
+     */
+    SocketWrapper* wrapClient(int sd, struct sockaddr_in addr);
+
     /**
      * Returns port the server is listening new connections on.
      */
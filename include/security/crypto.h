@@ -24,6 +24,22 @@
 
 typedef uint32_t nonce_t;
 
+/**
+ * Cipher suites of the handshake, identified by their key agreement.
+ * 
+ * The client signals the suite of its ephemeral key in the ClientHello and
+ * the server answers with a key of the same suite. Peers that do not signal
+ * it use P-256. The signatures depend on the keys of the certificates: an
+ * Ed25519 key signs with Ed25519, other keys sign with SHA-256.
+ */
+enum CipherSuite {SUITE_P256 = 0, SUITE_X25519 = 1};
+
+/** Number of cipher suites */
+#define N_SUITES 2
+
+/** Suite offered by the clients */
+#define PREFERRED_SUITE SUITE_X25519
+
 /**
  * @brief Print OpenSSL errors
  */
@@ -48,6 +64,9 @@ typedef uint32_t nonce_t;
 /**
  * Encrypts using AES in GCM mode
  * 
+ * A new cipher context is created and freed at every call: use
+ * aes_gcm_encrypt_ctx() when encrypting many messages with the same key.
+ * 
  * @param plaintext     buffer where the plaintext is stored
  * @param plaintext_len length of said buffer
  * @param aad           additional authenticated data buffer
@@ -68,6 +87,9 @@ int aes_gcm_encrypt(char *plaintext, int plaintext_len,
 /**
  * Decrypts using AES in GCM mode
  * 
+ * A new cipher context is created and freed at every call: use
+ * aes_gcm_decrypt_ctx() when decrypting many messages with the same key.
+ * 
  * @param ciphertext        buffer where the ciphertext is stored
  * @param ciphertext_len    length of said buffer
  * @param aad               additional authenticated data buffer
@@ -87,18 +109,92 @@ int aes_gcm_decrypt(char *ciphertext, int ciphertext_len,
                     char *plaintext,
                     char *tag);
 
+/**
+ * Creates an AES-GCM cipher context bound to the given key
+ * 
+ * The key schedule is computed once here, so that the context can be reused
+ * by aes_gcm_encrypt_ctx() or aes_gcm_decrypt_ctx() for any number of
+ * messages, each with its own IV. Free it with EVP_CIPHER_CTX_free().
+ * 
+ * @param key       encryption/decryption key
+ * @param enc       1 for encryption, 0 for decryption
+ * 
+ * @return the new context
+ */
+EVP_CIPHER_CTX* aes_gcm_new_ctx(char *key, int enc);
+
+/**
+ * Encrypts using AES in GCM mode with a context from aes_gcm_new_ctx()
+ * 
+ * @see aes_gcm_encrypt
+ */
+int aes_gcm_encrypt_ctx(EVP_CIPHER_CTX *ctx,
+                        char *plaintext, int plaintext_len,
+                        char *aad, int aad_len,
+                        char *iv,
+                        char *ciphertext,
+                        char *tag);
+
+/**
+ * Decrypts using AES in GCM mode with a context from aes_gcm_new_ctx()
+ * 
+ * @see aes_gcm_decrypt
+ */
+int aes_gcm_decrypt_ctx(EVP_CIPHER_CTX *ctx,
+                        char *ciphertext, int ciphertext_len,
+                        char *aad, int aad_len,
+                        char *iv,
+                        char *plaintext,
+                        char *tag);
+
 /**
  * @brief Generate a ECDH key
  * 
+ * The curve parameters (prime256v1) are generated at the first call and
+ * shared by all the following ones. Thread-safe.
+ * 
  * Example of usage:
  * EVP_PKEY *key=NULL;
  * int ret = get_ecdh_key(&key);
  * 
+ * Throws in case of error.
+ * 
  * @param key   the generated key 
- * @return int  ???
+ * @return int  1 in case of success
  */
 int get_ecdh_key(EVP_PKEY **key);
 
+/**
+ * @brief Generate a X25519 key
+ * 
+ * Throws in case of error.
+ * 
+ * @param key   the generated key 
+ * @return int  1 in case of success
+ */
+int get_x25519_key(EVP_PKEY **key);
+
+/**
+ * @brief Generate an ephemeral key of the given cipher suite
+ * 
+ * Throws in case of error.
+ * 
+ * @param suite the cipher suite
+ * @param key   the generated key 
+ * @return int  1 in case of success
+ */
+int get_eph_key(CipherSuite suite, EVP_PKEY **key);
+
+/**
+ * @brief Checks whether a key belongs to the given cipher suite
+ */
+bool is_suite_key(CipherSuite suite, EVP_PKEY *key);
+
+/**
+ * @brief Returns the name of a cipher suite, NULL if it is not valid
+ */
+const char* suite_name(int suite);
+
 /**
  * @brief Apply the DHKE to derive a shared secret
  * 
@@ -226,6 +322,8 @@ void hkdf(char *key, size_t key_len,
 /**
  * Signs the given message
  * 
+ * Ed25519 keys sign the message itself, the other keys its SHA-256 digest.
+ * 
  * @param msg the message to be signed
  * @param msglen the length of the message to be signed
  * @param signature pointer to the output signature
@@ -39,7 +39,7 @@ int pkey2buf(EVP_PKEY *key, char* buf, int buflen);
  * @param buf the buffer
  * @param buflen the buffer length
  * @param key the key 
- * @returns 1 in case of success, <=0 otherwise
+ * @returns the number of read bytes in case of success, <=0 otherwise
  */
 int buf2pkey(char* buf, int buflen, EVP_PKEY **key);
 
@@ -0,0 +1,116 @@
+/**
+ * @file eph_key_pool.h
+ *
+ * @brief Definition of the EphKeyPool class
+ */
+
+#ifndef EPH_KEY_POOL_H
+#define EPH_KEY_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <openssl/evp.h>
+
+#include "config.h"
+#include "security/crypto.h"
+#include "utils/message_queue.h"
+
+/**
+ * Pool of ready-made ephemeral keys of a cipher suite.
+ *
+ * A background thread generates keys until the pool holds the requested
+ * number of them, so that a handshake takes a key instead of generating it
+ * (e.g. when many clients reconnect at once). When the pool is empty, or it
+ * has not been started, the key is generated inline.
+ *
+ * The keys are kept in a lock-free queue. The background thread sleeps while
+ * the pool is above half of its size and logs the counters every
+ * EPH_KEY_POOL_LOG_INTERVAL seconds, if they changed.
+ */
+class EphKeyPool{
+public:
+    /** Counters of the pool */
+    struct Stats{
+        /** Keys taken from the pool */
+        uint64_t hits;
+
+        /** Keys generated inline since the pool was empty */
+        uint64_t misses;
+
+        /** Keys generated by the background thread */
+        uint64_t refilled;
+
+        /** Keys currently in the pool */
+        size_t available;
+    };
+
+private:
+    MessageQueue<EVP_PKEY*, EPH_KEY_POOL_MAX_SIZE> keys;
+
+    /** Suite of the keys */
+    CipherSuite suite;
+
+    /** Number of keys kept in the pool, 0 if not started */
+    size_t target;
+
+    /** The background thread is woken up below this number of keys */
+    size_t low_water;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t refilled;
+
+    /** Whether the background thread is waiting to be woken up */
+    bool sleeping;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    /** Non copyable */
+    EphKeyPool(const EphKeyPool&);
+    EphKeyPool& operator=(const EphKeyPool&);
+
+    /**
+     * Body of the background thread.
+     */
+    void refill();
+
+    static void* refillThread(void* arg);
+
+    /**
+     * Logs the counters if they changed since the last call.
+     */
+    void logStats(Stats* last, double elapsed);
+public:
+    /**
+     * Constructor
+     *
+     * @param suite the cipher suite of the keys
+     */
+    EphKeyPool(CipherSuite suite);
+
+    /**
+     * Starts the background thread.
+     *
+     * @param size  number of keys to keep ready, at most EPH_KEY_POOL_MAX_SIZE
+     * @returns false if the thread could not be started
+     */
+    bool start(size_t size);
+
+    /**
+     * Takes a key from the pool or, if it is empty, generates it.
+     *
+     * Throws in case of error.
+     *
+     * @param key   set to the key, owned by the caller
+     */
+    void take(EVP_PKEY** key);
+
+    /**
+     * Returns the counters.
+     */
+    Stats getStats();
+};
+
+#endif // EPH_KEY_POOL_H
@@ -17,14 +17,21 @@
 #include "network/socket_wrapper.h"
 #include "security/crypto.h"
 #include "security/crypto_utils.h"
+#include "security/eph_key_pool.h"
 #include "security/secure_host.h"
 #include "utils/dump_buffer.h"
 
-#define MAX_MSG_TO_SIGN_SIZE (2*MAX_USERNAME_LENGTH + 2 * sizeof(nonce_t) + 2 * KEY_BIO_MAX_SIZE )
-#define MAX_SEC_MSG_SIZE (MAX_MSG_SIZE - TAG_SIZE - sizeof(msglen_t) - 1)
+#define MAX_MSG_TO_SIGN_SIZE (2*MAX_USERNAME_LENGTH + 2 * sizeof(nonce_t) + 2 * KEY_BIO_MAX_SIZE + 1)
+#define MAX_SEC_MSG_SIZE (Message::max_size - TAG_SIZE - sizeof(msglen_t) - 1)
 
 #define AAD_SIZE (sizeof(msglen_t) + 1)
 
+/**
+ * Size of the buffer of an outgoing SecureMessage packet: messages are
+ * serialized in it before their size is checked against MAX_SEC_MSG_SIZE
+ */
+#define SEC_PACKET_BUFFER_SIZE (AAD_SIZE + Message::max_size + TAG_SIZE)
+
 class SecureSocketWrapper
 {
 protected:
@@ -36,6 +43,14 @@ protected:
     char recv_iv_static[IV_SIZE];
     char send_iv[IV_SIZE];
     char recv_iv[IV_SIZE];
+
+    /**
+     * Cipher contexts keyed once by generateKeys(), so that every message of
+     * the connection only sets its IV
+     */
+    EVP_CIPHER_CTX *send_ctx;
+    EVP_CIPHER_CTX *recv_ctx;
+
     uint64_t send_seq_num;
     uint64_t recv_seq_num;
     string my_id;
@@ -53,18 +68,42 @@ protected:
 
     char msg_to_sign_buf[MAX_MSG_TO_SIGN_SIZE];
 
+    /** Cipher suite of the handshake */
+    CipherSuite suite;
+
+    /**
+     * Ephemeral keys of the handshakes for each cipher suite, shared by all
+     * connections.
+     * 
+     * Never destroyed: their threads run until the process exits.
+     */
+    static EphKeyPool* eph_keys[N_SUITES];
+
+    /**
+     * Buffers of the outgoing SecureMessage packets, of SEC_PACKET_BUFFER_SIZE
+     * bytes.
+     * 
+     * Never destroyed, like the buffers of SocketWrapper.
+     */
+    static BufferPool* packets;
+
     /** 
      * Empty constructor to use in child classes.
      */
     SecureSocketWrapper(){};
 
     /**
-     * @brief Derives the key
+     * @brief Derives the key and sets up the cipher contexts
      * 
      * @param role          Role in the communication
      */
     void generateKeys(const char *role);
 
+    /**
+     * @brief Frees the cipher contexts, if any
+     */
+    void freeCipherContexts();
+
     /**
      * @brief Calculates the IV to use when sending the next message
      * 
@@ -80,21 +119,36 @@ protected:
     /** Internal initialization */
     void init(X509 *cert, EVP_PKEY *my_priv_key, X509_STORE *store);
 
+    /**
+     * Opens a new connection to the same peer, to retry the handshake.
+     * 
+     * Only client sockets can reconnect.
+     * 
+     * @returns 0 in case of success, something else otherwise
+     */
+    virtual int reconnect(){return 1;}
+
     /**
      * @brief Decrypts a Secure Message into a Message
      * 
+     * The ciphertext is decrypted in place, in the buffer it was received in.
+     * 
      * @param sm             Secure message ptr
      * @return Message*      Read message
      */
     Message *decryptMsg(SecureMessage *sm);
 
     /**
-     * @brief Encrypts a Message into a SecureMessage
+     * @brief Encrypts a Message into a SecureMessage packet
+     * 
+     * The message is serialized right after the packet header, encrypted in
+     * place and followed by the tag. The header is also the AAD.
      * 
-     * @param m                   Message to encrypt
-     * @return SecureMessage*     Encrypted SecureMessage
+     * @param m             Message to encrypt
+     * @param packet        Buffer of at least SEC_PACKET_BUFFER_SIZE bytes
+     * @return msglen_t     Length of the packet, 0 in case of error
      */
-    SecureMessage *encryptMsg(Message *m);
+    msglen_t encryptMsg(Message *m, char *packet);
 
     /**
      * Make the signature for the handshake protocol
@@ -148,19 +202,76 @@ public:
     /** 
      * Destructor
      */
-    ~SecureSocketWrapper();
+    virtual ~SecureSocketWrapper();
+
+    /**
+     * Sets the maximum size of the messages, of the plain ones and of the
+     * SecureMessage packets.
+     * 
+     * To be called at startup, before any message is sent.
+     * 
+     * @param size  the size, at most MAX_MSG_SIZE_LIMIT
+     * @see SocketWrapper::setMaxMsgSize()
+     */
+    static void setMaxMsgSize(msglen_t size);
+
+    /**
+     * Starts generating ephemeral keys of every cipher suite in the
+     * background, so that the handshakes do not wait for them.
+     * 
+     * @param size  number of keys of each suite kept ready
+     * @returns false if the pools could not be started
+     * @see EphKeyPool
+     */
+    static bool startKeyPool(size_t size);
+
+    /**
+     * Returns the counters of the ephemeral key pool of a cipher suite.
+     */
+    static EphKeyPool::Stats getKeyPoolStats(CipherSuite suite){
+        return eph_keys[suite]->getStats();
+    }
 
     /** 
      * Read any new data from the socket but does not wait for the 
      * whole message to be ready. This does not decrypt the message!
      * 
-     * This API is blocking iff socket was not ready.
+     * This API is never blocking.
      * 
-     * @param size the size of the temporary buffer
-     * @returns the received message or null if an error occurred
+     * @see SocketWrapper::readPartMsg()
+     * @returns the received message or null if no whole message is available
      */
     Message *readPartMsg();
 
+    /**
+     * Parses data already read from the socket. This does not decrypt the
+     * message!
+     *
+     * @see SocketWrapper::consumeBytes()
+     */
+    Message *consumeBytes(const char** data, size_t* len) { return sw->consumeBytes(data, len); }
+
+    /**
+     * Sets the sender of the outgoing messages.
+     *
+     * @see SocketWrapper::setSender()
+     */
+    void setSender(MessageSender* sender) { sw->setSender(sender); }
+
+    /**
+     * Holds the outgoing messages back until uncork().
+     *
+     * @see SocketWrapper::cork()
+     */
+    void cork() { sw->cork(); }
+
+    /**
+     * Writes the outgoing messages held back since cork().
+     *
+     * @see SocketWrapper::uncork()
+     */
+    void uncork() { sw->uncork(); }
+
     /** 
      * Receive any new message from the socket.
      * 
@@ -229,6 +340,10 @@ public:
     /**
      * @brief Estiblishes a secure connection over the already specified socket. To be run client-side.
      * 
+     * PREFERRED_SUITE is offered first. A peer that predates the suite
+     * negotiation drops the connection (or answers with P-256): in that case
+     * the client reconnects, if it can, and offers P-256.
+     * 
      * @return int  0 in case of success, something else otherwise
      */
     int handshakeClient();
@@ -294,6 +409,7 @@ public:
      */
     int connectServer(SecureHost host);
 
+    int reconnect();
 };
 
 /**
@@ -332,8 +448,18 @@ public:
      */
     int bindPort() { return ssw->bindPort(); }
 
+    /**
+     * Allows other sockets to bind to the same port.
+     *
+     * @see ServerSocketWrapper::setReusePort()
+     */
+    bool setReusePort() { return ssw->setReusePort(); }
+
     /**
      * Accepts any incoming connection and returns the related SocketWrapper.
+     * 
+     * @returns the new SecureSocketWrapper or NULL if no connection was
+     *          accepted
      */
     SecureSocketWrapper *acceptClient();
 
@@ -344,6 +470,14 @@ public:
      */
     SecureSocketWrapper *acceptClient(X509 *other_cert);
 
+    /**
+     * Returns the SecureSocketWrapper of a connection accepted by someone
+     * else.
+     *
+     * @see ServerSocketWrapper::wrapClient()
+     */
+    SecureSocketWrapper *wrapClient(int sd, struct sockaddr_in addr);
+
     /**
      * Returns port the server is listening new connections on.
      */
@@ -1,7 +1,7 @@
- /**
+/**
  * @file message_queue.h
  * @author Riccardo Mancini
- * 
+ *
  * @brief Definition and implementation of the MessageQueue class
  *
  * @date 2020-05-23
@@ -10,57 +10,120 @@
 #ifndef MESSAGE_QUEUE_H
 #define MESSAGE_QUEUE_H
 
-#include <iostream>
 #include <cstdlib>
-#include <ctime>
-#include <pthread.h>
-#include <queue>
-#include <utility>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "config.h"
 
-using namespace std;
+/** Number of failed attempts before a consumer yields the CPU */
+#define MESSAGE_QUEUE_SPIN 64
+
+/** Number of times a consumer yields the CPU before going to sleep */
+#define MESSAGE_QUEUE_YIELD 4
+
+/**
+ * Returns the smallest power of two >= n
+ */
+static constexpr size_t messageQueueCapacity(size_t n, size_t p = 1){
+    return p >= n ? p : messageQueueCapacity(n, p*2);
+}
+
+static inline long messageQueueFutex(uint32_t* addr, int op, uint32_t val){
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
 
 /**
- * Thread-safe message queue template
- * 
- * Threads are blocked on a pthread_cond if no message is available and are 
- * awaken by a pthread_cond_signal when a new item is added. Access to the class
- * is regulated by a mutex.
+ * Thread-safe bounded message queue template
+ *
+ * It is a lock-free ring buffer for many producers and many consumers: every
+ * slot has a sequence number telling whether it is ready to be written or
+ * read in the current lap, and producers and consumers reserve slots by
+ * advancing their own index with a compare-and-swap, so no lock is taken.
+ *
+ * Consumers that find the queue empty spin for a while, then yield the CPU a
+ * few times (so that producers on the same core make progress without a
+ * wakeup) and finally sleep on a futex. A producer that signals an item
+ * claims one of the sleeping consumers and gives it a wakeup token, so every
+ * signaled item wakes one consumer (no wakeup is lost when several consumers
+ * are idle) and the futex system call is only made when a consumer is
+ * actually sleeping.
+ *
+ * The capacity is MAX_SIZE rounded up to a power of two.
  */
 template <typename T, int MAX_SIZE>
 class MessageQueue{
 private:
-    queue<T> msg_queue;
-    pthread_mutex_t mutex;
-    pthread_cond_t available_messages;
+    static const size_t CAPACITY = messageQueueCapacity(MAX_SIZE);
+
+    struct Cell{
+        /** Position the slot is ready for: pos to write, pos+1 to read */
+        size_t seq;
+        T data;
+    };
+
+    Cell cells[CAPACITY];
+
+    /** Indexes are on separate cache lines, they are written by different threads */
+    char pad0[64];
+    size_t enqueue_pos;
+    char pad1[64];
+    size_t dequeue_pos;
+    char pad2[64];
+
+    /** Number of sleeping consumers not yet claimed by a producer */
+    uint32_t waiters;
+
+    /** Futex word: wakeup tokens given to claimed consumers */
+    uint32_t tokens;
+
+    /**
+     * Wakes up one sleeping consumer, if any.
+     */
+    void signal();
+
+    /**
+     * Sleeps until a wakeup token is available and takes it.
+     */
+    void waitToken();
 public:
     /**
-     * Default constructor that creates an empty queue and initializes both 
-     * mutex and cond
+     * Default constructor that creates an empty queue
      */
     MessageQueue();
 
     /**
-     * Insert a new element to the back of the queue WITHOUT SIGNALING on cond.
-     * 
+     * Insert a new element to the back of the queue WITHOUT SIGNALING
+     * sleeping consumers.
+     *
      * @param T the element to be inserted
-     * @return true if insertion was successfull, false otherwise
+     * @return true if insertion was successfull, false if the queue is full
      */
     bool push(T e);
 
     /**
-     * Insert a new element to the back of the queue, signaling any blocked
-     * thread that new items are available.
-     * 
+     * Insert a new element to the back of the queue, waking up a sleeping
+     * consumer if any.
+     *
      * @param T the element to be inserted
-     * @return true if insertion was successfull, false otherwise
+     * @return true if insertion was successfull, false if the queue is full
      */
     bool pushSignal(T e);
 
     /**
      * Retrieves and pops the first element from the queue, if any.
-     * 
+     *
+     * @param e where the element is stored
+     * @return true if an element was retrieved, false if the queue is empty
+     */
+    bool tryPull(T* e);
+
+    /**
+     * Retrieves and pops the first element from the queue, if any.
+     *
      * @return the first item, if any, undefined behaviour otherwise.
      */
     T pull();
@@ -68,73 +131,169 @@ public:
     /**
      * Retrieves and pops the first element from the queue. If no item is in the
      * queue, the thread is blocked waiting for new items to be inserted.
-     * 
+     *
      * @return the first item.
      */
     T pullWait();
 
     /**
-     * Returns the number of elements in queue
+     * Returns the number of elements in queue (approximate if the queue is
+     * being modified)
      */
-    size_t size(){return msg_queue.size();}
+    size_t size(){
+        size_t head = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+        size_t tail = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        return tail > head ? tail - head : 0;
+    }
 
     /**
      * Returns true if the queue is empty, false otherwise
      */
-    size_t empty(){return msg_queue.empty();}
+    size_t empty(){return size() == 0;}
 };
 
 // implementation must stay in header since I've used a template
 
 template <typename T, int MAX_SIZE>
-MessageQueue<T,MAX_SIZE>::MessageQueue(){
-    pthread_mutex_init(&mutex, NULL);
+MessageQueue<T,MAX_SIZE>::MessageQueue()
+        : enqueue_pos(0), dequeue_pos(0), waiters(0), tokens(0) {
+    for (size_t i = 0; i < CAPACITY; i++){
+        cells[i].seq = i;
+    }
 }
 
 template <typename T, int MAX_SIZE>
 bool MessageQueue<T,MAX_SIZE>::push(T e){
-    bool success;
-    pthread_mutex_lock(&mutex);
-    if ((success = msg_queue.size() < MAX_SIZE))
-        msg_queue.push(e);
-    pthread_mutex_unlock(&mutex);
-    return success;
+    size_t pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    Cell* cell;
+    while (1){
+        cell = &cells[pos & (CAPACITY-1)];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0){
+            // the slot is free in this lap, try to reserve it
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos+1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0){
+            // the slot still holds the item of the previous lap
+            return false;
+        } else{
+            // another producer took it
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    cell->data = e;
+    __atomic_store_n(&cell->seq, pos+1, __ATOMIC_RELEASE);
+    return true;
+}
+
+template <typename T, int MAX_SIZE>
+bool MessageQueue<T,MAX_SIZE>::tryPull(T* e){
+    size_t pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+    Cell* cell;
+    while (1){
+        cell = &cells[pos & (CAPACITY-1)];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos+1);
+        if (diff == 0){
+            if (__atomic_compare_exchange_n(&dequeue_pos, &pos, pos+1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0){
+            // empty
+            return false;
+        } else{
+            pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    *e = cell->data;
+    // the slot is free for the next lap
+    __atomic_store_n(&cell->seq, pos+CAPACITY, __ATOMIC_RELEASE);
+    return true;
 }
 
 template <typename T, int MAX_SIZE>
 T MessageQueue<T,MAX_SIZE>::pull(){
     T e;
-    pthread_mutex_lock(&mutex);
-    e = msg_queue.front();
-    msg_queue.pop();
-    pthread_mutex_unlock(&mutex);
+    tryPull(&e);
     return e;
 }
 
+template <typename T, int MAX_SIZE>
+void MessageQueue<T,MAX_SIZE>::signal(){
+    // pairs with the fence in pullWait(): either the consumer sees the new
+    // item or we see the consumer
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t w = __atomic_load_n(&waiters, __ATOMIC_RELAXED);
+    while (w > 0){
+        if (__atomic_compare_exchange_n(&waiters, &w, w-1, true,
+                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)){
+            __atomic_fetch_add(&tokens, 1, __ATOMIC_RELEASE);
+            messageQueueFutex(&tokens, FUTEX_WAKE_PRIVATE, 1);
+            return;
+        }
+    }
+}
+
+template <typename T, int MAX_SIZE>
+void MessageQueue<T,MAX_SIZE>::waitToken(){
+    uint32_t t = __atomic_load_n(&tokens, __ATOMIC_ACQUIRE);
+    while (1){
+        if (t == 0){
+            // returns immediately if a token arrived in the meantime
+            messageQueueFutex(&tokens, FUTEX_WAIT_PRIVATE, 0);
+            t = __atomic_load_n(&tokens, __ATOMIC_ACQUIRE);
+        } else if (__atomic_compare_exchange_n(&tokens, &t, t-1, true,
+                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)){
+            return;
+        }
+    }
+}
+
 template <typename T, int MAX_SIZE>
 T MessageQueue<T,MAX_SIZE>::pullWait(){
     T e;
-    pthread_mutex_lock(&mutex);
-    while(msg_queue.empty())
-        pthread_cond_wait(&available_messages, &mutex);
-    e = msg_queue.front();
-    msg_queue.pop();
-    pthread_mutex_unlock(&mutex);
-    return e;
+    while (1){
+        for (int i = 0; i < MESSAGE_QUEUE_SPIN; i++){
+            if (tryPull(&e))
+                return e;
+        }
+        for (int i = 0; i < MESSAGE_QUEUE_YIELD; i++){
+            sched_yield();
+            if (tryPull(&e))
+                return e;
+        }
+
+        __atomic_fetch_add(&waiters, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (!tryPull(&e)){
+            waitToken();
+            continue;
+        }
+
+        // not going to sleep: unregister, or take the token of the producer
+        // that has already claimed us
+        uint32_t w = __atomic_load_n(&waiters, __ATOMIC_RELAXED);
+        while (1){
+            if (w == 0){
+                waitToken();
+                break;
+            }
+            if (__atomic_compare_exchange_n(&waiters, &w, w-1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        return e;
+    }
 }
 
 template <typename T, int MAX_SIZE>
 bool MessageQueue<T,MAX_SIZE>::pushSignal(T e){
-    bool success;
-    pthread_mutex_lock(&mutex);
-    if ((success = msg_queue.size() < MAX_SIZE)){
-        msg_queue.push(e);
-        if (msg_queue.size() == 1)
-            pthread_cond_signal(&available_messages);
-    }
-    pthread_mutex_unlock(&mutex);
-    return success;
-
+    if (!push(e))
+        return false;
+    signal();
+    return true;
 }
 
 #endif // MESSAGE_QUEUE_H
@@ -0,0 +1,141 @@
+ /**
+ * @file mutex_message_queue.h
+ * 
+ * @brief Definition and implementation of the MutexMessageQueue class
+ *
+ * This is the original implementation of MessageQueue, kept as a reference
+ * for the benchmarks (see bench_queue).
+ */
+
+#ifndef MUTEX_MESSAGE_QUEUE_H
+#define MUTEX_MESSAGE_QUEUE_H
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+#include <queue>
+#include <utility>
+
+#include "config.h"
+
+using namespace std;
+
+/**
+ * Thread-safe message queue template
+ * 
+ * Threads are blocked on a pthread_cond if no message is available and are 
+ * awaken by a pthread_cond_signal when a new item is added. Access to the class
+ * is regulated by a mutex.
+ */
+template <typename T, int MAX_SIZE>
+class MutexMessageQueue{
+private:
+    queue<T> msg_queue;
+    pthread_mutex_t mutex;
+    pthread_cond_t available_messages;
+public:
+    /**
+     * Default constructor that creates an empty queue and initializes both 
+     * mutex and cond
+     */
+    MutexMessageQueue();
+
+    /**
+     * Insert a new element to the back of the queue WITHOUT SIGNALING on cond.
+     * 
+     * @param T the element to be inserted
+     * @return true if insertion was successfull, false otherwise
+     */
+    bool push(T e);
+
+    /**
+     * Insert a new element to the back of the queue, signaling any blocked
+     * thread that new items are available.
+     * 
+     * @param T the element to be inserted
+     * @return true if insertion was successfull, false otherwise
+     */
+    bool pushSignal(T e);
+
+    /**
+     * Retrieves and pops the first element from the queue, if any.
+     * 
+     * @return the first item, if any, undefined behaviour otherwise.
+     */
+    T pull();
+
+    /**
+     * Retrieves and pops the first element from the queue. If no item is in the
+     * queue, the thread is blocked waiting for new items to be inserted.
+     * 
+     * @return the first item.
+     */
+    T pullWait();
+
+    /**
+     * Returns the number of elements in queue
+     */
+    size_t size(){return msg_queue.size();}
+
+    /**
+     * Returns true if the queue is empty, false otherwise
+     */
+    size_t empty(){return msg_queue.empty();}
+};
+
+// implementation must stay in header since I've used a template
+
+template <typename T, int MAX_SIZE>
+MutexMessageQueue<T,MAX_SIZE>::MutexMessageQueue(){
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&available_messages, NULL);
+}
+
+template <typename T, int MAX_SIZE>
+bool MutexMessageQueue<T,MAX_SIZE>::push(T e){
+    bool success;
+    pthread_mutex_lock(&mutex);
+    if ((success = msg_queue.size() < MAX_SIZE))
+        msg_queue.push(e);
+    pthread_mutex_unlock(&mutex);
+    return success;
+}
+
+template <typename T, int MAX_SIZE>
+T MutexMessageQueue<T,MAX_SIZE>::pull(){
+    T e;
+    pthread_mutex_lock(&mutex);
+    e = msg_queue.front();
+    msg_queue.pop();
+    pthread_mutex_unlock(&mutex);
+    return e;
+}
+
+template <typename T, int MAX_SIZE>
+T MutexMessageQueue<T,MAX_SIZE>::pullWait(){
+    T e;
+    pthread_mutex_lock(&mutex);
+    while(msg_queue.empty())
+        pthread_cond_wait(&available_messages, &mutex);
+    e = msg_queue.front();
+    msg_queue.pop();
+    pthread_mutex_unlock(&mutex);
+    return e;
+}
+
+template <typename T, int MAX_SIZE>
+bool MutexMessageQueue<T,MAX_SIZE>::pushSignal(T e){
+    bool success;
+    pthread_mutex_lock(&mutex);
+    if ((success = msg_queue.size() < MAX_SIZE)){
+        msg_queue.push(e);
+        // every item may be for a different waiting thread
+        pthread_cond_signal(&available_messages);
+    }
+    pthread_mutex_unlock(&mutex);
+    return success;
+
+}
+
+#endif // MUTEX_MESSAGE_QUEUE_H
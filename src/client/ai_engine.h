@@ -0,0 +1,53 @@
+/**
+ * @file ai_engine.h
+ *
+ * @brief Header file for the common interface of the AI opponents
+ */
+
+#ifndef AI_ENGINE_H
+#define AI_ENGINE_H
+#include <iostream>
+#include "connect4_bitboard.h"
+
+/**
+ * Opponent of the single player mode.
+ */
+class AIEngine {
+    public:
+    virtual ~AIEngine() {}
+
+    /**
+     * Chooses the move for the given player.
+     *
+     * @param board     current board
+     * @param player    marker of the player to move
+     * @return the chosen column, -1 if no move is possible
+     */
+    virtual int chooseMove(const Connect4Bitboard& board, char player) = 0;
+
+    /**
+     * Chooses the move on a board of any size.
+     *
+     * By default the board is copied to a bitboard, which throws if it does
+     * not fit: engines that can play on larger boards override it.
+     *
+     * @param board     current board
+     * @param player    marker of the player to move
+     * @return the chosen column, -1 if no move is possible
+     */
+    virtual int chooseMove(const Connect4& board, char player){
+        return chooseMove(Connect4Bitboard(board), player);
+    }
+
+    /**
+     * Forgets what was learned in the previous games, if anything.
+     */
+    virtual void newGame() {}
+
+    /**
+     * Prints the statistics of the last call to chooseMove().
+     */
+    virtual void printStats(std::ostream& os) = 0;
+};
+
+#endif //AI_ENGINE_H
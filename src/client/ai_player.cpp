@@ -0,0 +1,408 @@
+/**
+ * @file ai_player.cpp
+ *
+ * @brief Implementation of ai_player.h
+ *
+ * @see ai_player.h
+ */
+#include <cstring>
+#include <ctime>
+#include "ai_player.h"
+
+/** Depth that is never reached: it means "search until the board is full" */
+#define MAX_PLIES 64
+
+/** Number of nodes between two checks of the clock */
+#define CLOCK_CHECK_INTERVAL 4096
+
+/** Minimum depth at which positions are stored in the table */
+#define TT_MIN_DEPTH 1
+
+/**
+ * Returns the current time of the monotonic clock in milliseconds
+ */
+static int64_t nowMs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+static char other(char player){
+    return player == 'X' ? 'O' : 'X';
+}
+
+/**
+ * Win scores depend on the distance from the root: they are stored in the
+ * table as distance from the current position instead.
+ */
+static int scoreToTT(int score, int ply){
+    if (score >= AIPlayer::WIN_SCORE - MAX_PLIES){
+        return score + ply;
+    } else if (score <= -AIPlayer::WIN_SCORE + MAX_PLIES){
+        return score - ply;
+    }
+    return score;
+}
+
+static int scoreFromTT(int score, int ply){
+    if (score >= AIPlayer::WIN_SCORE - MAX_PLIES){
+        return score - ply;
+    } else if (score <= -AIPlayer::WIN_SCORE + MAX_PLIES){
+        return score + ply;
+    }
+    return score;
+}
+
+bool parseDifficulty(const char* name, Difficulty* difficulty){
+    for (int d = EASY; d <= EXPERT; ++d){
+        if (strcmp(name, difficultyName((Difficulty) d)) == 0){
+            *difficulty = (Difficulty) d;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* difficultyName(Difficulty difficulty){
+    switch(difficulty){
+        case EASY:
+            return "easy";
+        case MEDIUM:
+            return "medium";
+        case HARD:
+            return "hard";
+        case EXPERT:
+            return "expert";
+        default:
+            return "unknown";
+    }
+}
+
+AIPlayer::AIPlayer(Difficulty difficulty /* = HARD */,
+                   size_t hash_mb /* = AI_DEFAULT_HASH_MB */)
+        : tt_(hash_mb), book_(NULL), n_threads_(1),
+          nodes_(0), last_depth_(0), last_score_(0), last_from_book_(false) {
+    switch(difficulty){
+        case EASY:
+            max_depth_ = 2;
+            time_budget_ms_ = 0;
+            break;
+        case MEDIUM:
+            max_depth_ = 6;
+            time_budget_ms_ = 0;
+            break;
+        case HARD:
+            max_depth_ = MAX_PLIES;
+            time_budget_ms_ = AI_HARD_TIME_MS;
+            break;
+        case EXPERT:
+        default:
+            max_depth_ = MAX_PLIES;
+            time_budget_ms_ = AI_EXPERT_TIME_MS;
+            break;
+    }
+}
+
+AIPlayer::AIPlayer(int max_depth, int time_budget_ms, size_t hash_mb)
+        : tt_(hash_mb), book_(NULL), n_threads_(1), max_depth_(max_depth),
+          time_budget_ms_(time_budget_ms),
+          nodes_(0), last_depth_(0), last_score_(0), last_from_book_(false) {}
+
+bool AIPlayer::setThreads(int n_threads){
+    if (n_threads < 1 || n_threads > AI_MAX_THREADS){
+        return false;
+    }
+    n_threads_ = n_threads;
+    return true;
+}
+
+void AIPlayer::prepare(const Connect4Bitboard& board){
+    // center first: e.g. 3 2 4 1 5 0 6 for 7 columns, 2 3 1 4 0 5 for 6
+    int cols = board.getNumCols();
+    int order[64];
+    for (int i = 0; i < cols; ++i){
+        int offset = (1-2*(i%2))*(i+1)/2;
+        order[i] = cols%2 == 1 ? cols/2 + offset : cols/2 - 1 - offset;
+    }
+
+    for (int t = 0; t < n_threads_; ++t){
+        Worker& w = workers_[t];
+        w.ai = this;
+        w.id = t;
+        w.board = board;
+        w.nodes = 0;
+        memcpy(w.order, order, cols*sizeof(order[0]));
+        // odd helpers prefer the columns on the other side of the center
+        if (t%2 == 1){
+            for (int i = 1; i+1 < cols; i += 2){
+                w.order[i] = order[i+1];
+                w.order[i+1] = order[i];
+            }
+        }
+    }
+
+    center_mask_ = 0;
+    int height = board.getNumRows()+1;
+    bitboard_t column = ((bitboard_t) 1 << board.getNumRows()) - 1;
+    center_mask_ |= column << ((cols/2)*height);
+    if (cols%2 == 0){
+        center_mask_ |= column << ((cols/2-1)*height);
+    }
+}
+
+int AIPlayer::evaluate(Worker& w, char side){
+    bitboard_t mine = w.board.getTokens(side);
+    bitboard_t theirs = w.board.getTokens(other(side));
+
+    int threats = __builtin_popcountll(w.board.winningCells(mine))
+                - __builtin_popcountll(w.board.winningCells(theirs));
+    int center = __builtin_popcountll(mine & center_mask_)
+               - __builtin_popcountll(theirs & center_mask_);
+
+    return 8*threats + center;
+}
+
+int AIPlayer::negamax(Worker& w, char side, int depth, int ply, int alpha, int beta){
+    Connect4Bitboard& board = w.board;
+    int cols = board.getNumCols();
+
+    w.nodes++;
+    if (time_budget_ms_ > 0 && w.nodes % CLOCK_CHECK_INTERVAL == 0
+            && nowMs() >= deadline_){
+        stop();
+    }
+    if (isStopped()){
+        return 0;
+    }
+
+    // winning in one move is always the best thing to do
+    for (int i = 0; i < cols; ++i){
+        if (board.canPlay(i) && board.isWinningMove(i, side)){
+            return WIN_SCORE - ply;
+        }
+    }
+
+    if (board.isFull()){
+        return 0;
+    }
+
+    if (depth == 0){
+        return evaluate(w, side);
+    }
+
+    uint64_t key = board.getKey(side);
+    int alpha_orig = alpha;
+    int tt_move = -1;
+    TTResult entry;
+
+    if (tt_.probe(key, &entry)){
+        tt_move = entry.move;
+        if (entry.depth >= depth){
+            int score = scoreFromTT(entry.score, ply);
+            if (entry.bound == TT_EXACT){
+                return score;
+            } else if (entry.bound == TT_LOWER && score > alpha){
+                alpha = score;
+            } else if (entry.bound == TT_UPPER && score < beta){
+                beta = score;
+            }
+            if (alpha >= beta){
+                return score;
+            }
+        }
+    }
+
+    int best = -WIN_SCORE;
+    int best_move = -1;
+    // the best move of a previous search is tried first
+    for (int i = -1; i < cols; ++i){
+        int col = i < 0 ? tt_move : w.order[i];
+        if ((i >= 0 && col == tt_move) || !board.canPlay(col)){
+            continue;
+        }
+
+        board.makeMove(col, side);
+        int score = -negamax(w, other(side), depth-1, ply+1, -beta, -alpha);
+        board.undo();
+
+        if (isStopped()){
+            return 0;
+        }
+
+        if (score > best){
+            best = score;
+            best_move = col;
+            if (score > alpha){
+                alpha = score;
+                if (alpha >= beta){
+                    break;
+                }
+            }
+        }
+    }
+
+    if (depth >= TT_MIN_DEPTH){
+        TTBound bound = best <= alpha_orig ? TT_UPPER
+                      : best >= beta ? TT_LOWER
+                      : TT_EXACT;
+        tt_.store(key, scoreToTT(best, ply), depth, best_move, bound);
+    }
+
+    return best;
+}
+
+void AIPlayer::search(Worker& w){
+    Connect4Bitboard& board = w.board;
+    int cols = board.getNumCols();
+    int root_order[64];
+
+    // helpers start from a different column
+    for (int i = 0; i < cols; ++i){
+        root_order[i] = w.order[(i + w.id) % cols];
+    }
+
+    w.best_move = -1;
+    w.best_score = -WIN_SCORE;
+    w.depth = 0;
+
+    // fallback in case not even the first iteration completes
+    for (int i = 0; i < cols && w.best_move == -1; ++i){
+        if (board.canPlay(root_order[i])){
+            w.best_move = root_order[i];
+        }
+    }
+    if (w.best_move == -1){
+        stop();
+        return;
+    }
+
+    // half of the helpers skip the first iteration to desynchronize
+    for (int depth = 1 + w.id%2; depth <= search_depth_; ++depth){
+        int alpha = -WIN_SCORE-1;
+        int iter_move = -1;
+
+        for (int i = 0; i < cols; ++i){
+            int col = root_order[i];
+            if (!board.canPlay(col)){
+                continue;
+            }
+
+            int score;
+            if (board.isWinningMove(col, player_)){
+                score = WIN_SCORE;
+            } else {
+                board.makeMove(col, player_);
+                score = -negamax(w, other(player_), depth-1, 1, -WIN_SCORE-1, -alpha);
+                board.undo();
+            }
+
+            if (isStopped()){
+                break;
+            }
+
+            if (score > alpha){
+                alpha = score;
+                iter_move = col;
+            }
+        }
+
+        if (isStopped()){
+            return;
+        }
+
+        w.best_move = iter_move;
+        w.best_score = alpha;
+        w.depth = depth;
+
+        // search the best move first in the next iteration
+        int i = 0;
+        while (root_order[i] != iter_move){
+            i++;
+        }
+        memmove(&root_order[1], &root_order[0], i*sizeof(root_order[0]));
+        root_order[0] = iter_move;
+
+        // the result is certain, no need to search deeper
+        if (alpha >= WIN_SCORE - MAX_PLIES || alpha <= -WIN_SCORE + MAX_PLIES){
+            break;
+        }
+    }
+
+    // the first thread that completes its search stops the others
+    stop();
+}
+
+void* AIPlayer::searchThread(void* arg){
+    Worker* w = (Worker*) arg;
+    w->ai->search(*w);
+    return NULL;
+}
+
+int AIPlayer::chooseMove(const Connect4Bitboard& board, char player){
+    BookEntry entry;
+    if (book_ != NULL && book_->lookup(board, player, &entry)
+            && board.canPlay(entry.move)){
+        nodes_ = 0;
+        last_depth_ = entry.depth;
+        last_score_ = entry.score;
+        last_from_book_ = true;
+        LOG(LOG_DEBUG, "AI chose column %d from the book (score %d)",
+            entry.move, entry.score);
+        return entry.move;
+    }
+    last_from_book_ = false;
+
+    prepare(board);
+
+    player_ = player;
+    stopped_ = false;
+    tt_.newSearch();
+    deadline_ = nowMs() + time_budget_ms_;
+
+    search_depth_ = board.getNumRows()*board.getNumCols() - board.getNumMoves();
+    if (search_depth_ > max_depth_){
+        search_depth_ = max_depth_;
+    }
+
+    int n_started = 1;
+    for (int t = 1; t < n_threads_; ++t){
+        if (pthread_create(&workers_[t].thread, NULL, searchThread, &workers_[t]) != 0){
+            LOG(LOG_WARN, "Could not start search thread %d", t);
+            break;
+        }
+        n_started++;
+    }
+
+    search(workers_[0]);
+
+    for (int t = 1; t < n_started; ++t){
+        pthread_join(workers_[t].thread, NULL);
+    }
+
+    // the deepest result wins, the main thread in case of ties
+    Worker* best = &workers_[0];
+    nodes_ = 0;
+    for (int t = 0; t < n_started; ++t){
+        nodes_ += workers_[t].nodes;
+        if (workers_[t].depth > best->depth){
+            best = &workers_[t];
+        }
+    }
+
+    last_depth_ = best->depth;
+    last_score_ = best->best_score;
+    LOG(LOG_DEBUG, "AI chose column %d (score %d, depth %d, %lu nodes, %d threads)",
+        best->best_move, last_score_, last_depth_, (unsigned long) nodes_, n_started);
+    return best->best_move;
+}
+
+void AIPlayer::printStats(std::ostream& os){
+    if (last_from_book_){
+        os<<"Move taken from the opening book, score "<<last_score_<<std::endl;
+        return;
+    }
+    os<<"Search: depth "<<last_depth_<<", "<<nodes_<<" nodes, score "
+      <<last_score_<<", "<<n_threads_<<" threads"<<std::endl;
+    os<<"Table: "<<tt_.getHits()<<" hits, "<<tt_.getMisses()<<" misses, "
+      <<tt_.getCollisions()<<" collisions"<<std::endl;
+}
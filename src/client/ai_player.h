@@ -0,0 +1,247 @@
+/**
+ * @file ai_player.h
+ *
+ * @brief Header file for the search-based opponent of the single player mode
+ */
+
+#ifndef AI_PLAYER_H
+#define AI_PLAYER_H
+#include <stdint.h>
+#include <pthread.h>
+#include "config.h"
+#include "connect4_bitboard.h"
+#include "transposition_table.h"
+#include "opening_book.h"
+#include "ai_engine.h"
+
+/**
+ * Available difficulty levels.
+ *
+ * EASY:   looks only 2 plies ahead.
+ * MEDIUM: looks 6 plies ahead.
+ * HARD:   iterative deepening for AI_HARD_TIME_MS per move.
+ * EXPERT: iterative deepening for AI_EXPERT_TIME_MS per move.
+ */
+enum Difficulty {EASY, MEDIUM, HARD, EXPERT};
+
+/**
+ * Parses the name of a difficulty level (case sensitive, lowercase).
+ *
+ * @param name          name of the level ("easy", "medium", ...)
+ * @param difficulty    output level
+ * @return true if the name is valid, false otherwise
+ */
+bool parseDifficulty(const char* name, Difficulty* difficulty);
+
+/**
+ * Returns the name of the given difficulty level.
+ */
+const char* difficultyName(Difficulty difficulty);
+
+/**
+ * Opponent that chooses its moves through a negamax search with alpha-beta
+ * pruning.
+ *
+ * Moves are explored center first and the search is iteratively deepened
+ * until either the maximum depth or the time budget is reached. The search is
+ * performed on a private copy of the board using makeMove()/undo(), so no
+ * memory is allocated while searching.
+ *
+ * The search can run on several threads (Lazy SMP): all the threads search
+ * the same position sharing the transposition table, each one with a slightly
+ * different move ordering and starting depth so that they fill the table with
+ * results that are useful to the others. The move of the thread that
+ * completed the deepest iteration is played.
+ */
+class AIPlayer : public AIEngine {
+    /**
+     * State private to each search thread
+     */
+    struct Worker {
+        /** Owner of the worker */
+        AIPlayer* ai;
+
+        /** Index of the thread, 0 is the main one */
+        int id;
+
+        pthread_t thread;
+
+        /** Board used during the search */
+        Connect4Bitboard board;
+
+        /** Order in which the columns are explored */
+        int order[64];
+
+        /** Nodes visited by this thread */
+        uint64_t nodes;
+
+        /** Result of the deepest completed iteration */
+        int best_move;
+        int best_score;
+        int depth;
+    };
+
+    /** Results of the previous searches, kept between moves */
+    TranspositionTable tt_;
+
+    /** Opening book, NULL if not used */
+    const OpeningBook* book_;
+
+    /** Search threads */
+    Worker workers_[AI_MAX_THREADS];
+    int n_threads_;
+
+    /** Maximum depth of the search (in plies) */
+    int max_depth_;
+
+    /** Time budget per move in milliseconds */
+    int time_budget_ms_;
+
+    /** Bitboard of the central column(s) */
+    bitboard_t center_mask_;
+
+    /** Player to move at the root */
+    char player_;
+
+    /** Depth of the search of the current move */
+    int search_depth_;
+
+    /** Deadline of the current search (monotonic clock, ms) */
+    int64_t deadline_;
+
+    /** Set when the search must be stopped, shared by all threads */
+    bool stopped_;
+
+    /** Statistics of the last search */
+    uint64_t nodes_;
+    int last_depth_;
+    int last_score_;
+    bool last_from_book_;
+
+    /**
+     * Negamax search with alpha-beta pruning.
+     *
+     * @param w         worker running the search
+     * @param side      player to move
+     * @param depth     remaining depth
+     * @param ply       distance from the root
+     * @param alpha     lower bound of the window
+     * @param beta      upper bound of the window
+     * @return the score of the position from the point of view of side
+     */
+    int negamax(Worker& w, char side, int depth, int ply, int alpha, int beta);
+
+    /**
+     * Iterative deepening search from the root, run by each worker.
+     */
+    void search(Worker& w);
+
+    /**
+     * Entry point of the helper threads.
+     */
+    static void* searchThread(void* arg);
+
+    /**
+     * Static evaluation of a position, from the point of view of side.
+     */
+    int evaluate(Worker& w, char side);
+
+    /**
+     * Initializes the boards, move orderings and masks of the workers.
+     */
+    void prepare(const Connect4Bitboard& board);
+
+    /**
+     * Returns true if the search must stop.
+     */
+    bool isStopped() { return __atomic_load_n(&stopped_, __ATOMIC_RELAXED); }
+
+    /**
+     * Stops all the search threads.
+     */
+    void stop() { __atomic_store_n(&stopped_, true, __ATOMIC_RELAXED); }
+
+    /** Non copyable */
+    AIPlayer(const AIPlayer&);
+    AIPlayer& operator=(const AIPlayer&);
+
+    public:
+
+    /** Score of a win at the root, wins closer to the root score more */
+    static const int WIN_SCORE = 100000;
+
+    /**
+     * @brief Construct an AI of the given difficulty
+     *
+     * @param difficulty        difficulty level
+     * @param hash_mb           size of the transposition table in MiB
+     */
+    AIPlayer(Difficulty difficulty = HARD, size_t hash_mb = AI_DEFAULT_HASH_MB);
+
+    /**
+     * @brief Construct an AI with custom limits
+     *
+     * @param max_depth         maximum search depth in plies
+     * @param time_budget_ms    time budget per move (<= 0 means no limit)
+     * @param hash_mb           size of the transposition table in MiB
+     */
+    AIPlayer(int max_depth, int time_budget_ms, size_t hash_mb);
+
+    /**
+     * Chooses the move for the given player.
+     *
+     * @param board     current board
+     * @param player    marker of the player to move
+     * @return the chosen column, -1 if no move is possible
+     */
+    int chooseMove(const Connect4Bitboard& board, char player);
+    using AIEngine::chooseMove;
+
+    /**
+     * Prints depth, nodes and score of the last search and the counters of
+     * the transposition table.
+     */
+    void printStats(std::ostream& os);
+
+    /**
+     * Clears the transposition table.
+     */
+    void newGame() { tt_.clear(); }
+
+    /**
+     * Sets the number of search threads (1 by default).
+     *
+     * @param n_threads     number of threads, at most AI_MAX_THREADS
+     * @return false if the number is not valid
+     */
+    bool setThreads(int n_threads);
+
+    /**
+     * Sets the opening book: moves are taken from it while the position is in
+     * the book, then the AI falls back to search.
+     *
+     * @param book      the book, NULL to disable it. It must stay open while
+     *                  the AI is used.
+     */
+    void setBook(const OpeningBook* book) { book_ = book; }
+
+    /** Returns the number of search threads */
+    int getThreads() { return n_threads_; }
+
+    /** Returns the depth reached by the last search */
+    int getLastDepth() { return last_depth_; }
+
+    /** Returns the number of nodes visited by the last search (all threads) */
+    uint64_t getLastNodes() { return nodes_; }
+
+    /** Returns the score of the move chosen by the last search */
+    int getLastScore() { return last_score_; }
+
+    /** Returns true if the last move was taken from the opening book */
+    bool isLastFromBook() { return last_from_book_; }
+
+    /** Returns the transposition table, e.g. to read its counters */
+    TranspositionTable& getTable() { return tt_; }
+};
+
+#endif //AI_PLAYER_H
@@ -49,7 +49,8 @@ struct ConnectionMode promptChooseConnection(){
     cout<<"To connect to a server type: `server host port [path/to/server_cert.pem]`"<< endl;
     cout<<"To connect to a peer type: `peer host port path/to/peer_cert.pem`"<< endl;
     cout<<"To wait for a peer type: `peer listen_port path/to/peer_cert.pem`"<< endl;
-    cout<<"To play offline type: `offline`"<< endl;
+    cout<<"To play offline type: `offline [easy|medium|hard|expert] [--hash MB] [--threads N] [--book FILE|--no-book] [--stats] [--engine alphabeta|mcts] [--playouts N] [--time MS]`"<< endl;
+    cout<<"To solve a position type: `solve moves` (e.g. `solve 4453`)"<< endl;
     cout<<"To exit type: `exit`"<< endl;
 
     do {
@@ -75,9 +76,16 @@ struct ConnectionMode promptChooseConnection(){
             return ConnectionMode(CONNECT_TO_SERVER, args.getArgv(1), 
                                         atoi(args.getArgv(2)), cert, 0);
                                         
-        } else if (args.getArgc() == 1 && strcmp(args.getArgv(0), "offline") == 0){
-            return ConnectionMode(SINGLE_PLAYER);
+        } else if (args.getArgc() >= 1 && strcmp(args.getArgv(0), "offline") == 0){
+            struct SinglePlayerOptions options;
+            if (parseSinglePlayerOptions(args, &options)){
+                return ConnectionMode(SINGLE_PLAYER, options);
+            }
+            cout << "Could not parse arguments: "<< args << endl;
             
+        } else if (args.getArgc() == 2 && strcmp(args.getArgv(0), "solve") == 0){
+            solvePosition(args.getArgv(1));
+
         } else if (args.getArgc() == 1 && strcmp(args.getArgv(0), "exit") == 0){
             cout << "Bye" << endl;
             return ConnectionMode(EXIT, OK);
@@ -109,7 +117,7 @@ int main(int argc, char** argv){
 
     srand(time(NULL));
 
-    int ret;
+    int ret = OK;
 
     printWelcome();
     cout<<endl<<"Welcome to 4-in-a-row!"<<endl;
@@ -163,7 +171,7 @@ int main(int argc, char** argv){
                         loopLobby = true;
                         break;
                     case SINGLE_PLAYER:
-                        ret = playSinglePlayer();
+                        ret = playSinglePlayer(ucc.sp_options);
                         loopLobby = false;
                         break;
                     case EXIT:
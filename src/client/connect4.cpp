@@ -10,13 +10,67 @@
  * 
  */
 #include "connect4.h"
+#include "connect4_board.h"
 using namespace std;
 
-void Connect4::print(ostream& os){
-    os<<*this;
+uint64_t zobristKey(int player, int index){
+    // splitmix64 with a fixed seed. The first 128 keys are the ones of
+    // Connect4Bitboard (64 per player), larger boards continue the sequence.
+    uint64_t n = index < 64 ? player*64 + index : 128 + 2*(index-64) + player;
+    uint64_t z = 0x4c617275696e6121ULL + (n+1)*0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
 }
 
-Connect4::Connect4(int rows /* = 6 */, int columns /* = 7 */){
+/**
+ * Board of any size, kept as a matrix of markers.
+ */
+class Connect4Generic : public Connect4Impl {
+    /** Rows, cols and total size of the board */
+    int rows_, cols_, size_;
+
+    /** State of the board */
+    bool full_;
+
+    /** Matrix data structure for the board */
+    char* cells_;
+
+    /** 
+     * Counts the tokens of the player towards a direction (di, dj) 
+     * starting from  (row, col)  
+     * 
+     * @param player   player marker for whom we count the tokens
+     * @param row      starting row
+     * @param col      starting col
+     * @param di       step size for rows (each iteration row+di)
+     * @param dj       step size for cols (each iteration row+dj)
+     *
+     * @return         number of tokens along the (one way) direction
+     */
+    int countNexts(char player, int row, int col, int di, int dj) const;
+
+    /**
+     * @brief Checks if the top row is full, this would mean all the board is full
+     * 
+     * @return true if full
+     * @return false if at least one cell is empty
+     */
+    bool checkFullTopRow() const;
+
+    public:
+    Connect4Generic(int rows, int columns);
+    Connect4Generic(const Connect4Generic& other);
+    ~Connect4Generic();
+
+    Connect4Impl* clone() const { return new Connect4Generic(*this); }
+    char getCell(int row, int col) const;
+    int8_t play(int column, char player);
+    bool checkWin(int row, int col, char player) const;
+    void undo(int column);
+};
+
+Connect4Generic::Connect4Generic(int rows, int columns){
     rows_ = rows;
     cols_ = columns;
     size_ = rows*columns;
@@ -28,20 +82,29 @@ Connect4::Connect4(int rows /* = 6 */, int columns /* = 7 */){
     memset(cells_, 0, size_);
 }
 
-int8_t Connect4::play(int col, char player){
-    // bool col_full = true;
-    if(player == 0){
-        player = player_;
-    }
+Connect4Generic::Connect4Generic(const Connect4Generic& other)
+        : rows_(other.rows_), cols_(other.cols_), size_(other.size_),
+          full_(other.full_) {
+    cells_ = new char[size_];
+    memcpy(cells_, other.cells_, size_);
+}
 
+Connect4Generic::~Connect4Generic(){
+    delete[] cells_;
+}
+
+int8_t Connect4Generic::play(int col, char player){
     //Trying to play with a full board
     if(full_){
         return -2;
     }
 
+    if(col < 0 || col >= cols_){
+        return -1;
+    }
+
     for(int i = rows_-1; i>=0; --i){
         if(cells_[i*cols_+col] == 0){
-            // col_full = false;
             cells_[i*cols_+col] = player;
             if( checkWin(i, col, player) ){
                 return 1;
@@ -63,7 +126,17 @@ int8_t Connect4::play(int col, char player){
     return -1;
 }
 
-int Connect4::countNexts(char player, int row, int col, int di, int dj){
+void Connect4Generic::undo(int col){
+    for(int i = 0; i < rows_; ++i){
+        if(cells_[i*cols_+col] != 0){
+            cells_[i*cols_+col] = 0;
+            full_ = false;
+            return;
+        }
+    }
+}
+
+int Connect4Generic::countNexts(char player, int row, int col, int di, int dj) const{
     int count = 0;
     for(
         int i = row+di, j = col+dj;
@@ -80,7 +153,7 @@ int Connect4::countNexts(char player, int row, int col, int di, int dj){
     return count;
 }
 
-bool Connect4::checkWin(int row, int col, char player){
+bool Connect4Generic::checkWin(int row, int col, char player) const{
     /*
         Take any of the 4 possible directions
         count how many token of the same player there are
@@ -89,9 +162,6 @@ bool Connect4::checkWin(int row, int col, char player){
     */
 
     LOG(LOG_DEBUG, "Checking (%d, %d)", row, col); 
-    if(player == 0){
-        player = player_;
-    }
 
     for(int di = 1; di >= 0 && di != -1; --di){
         for(int dj = 1; dj >= 0 && di != -1; --dj){
@@ -102,8 +172,8 @@ bool Connect4::checkWin(int row, int col, char player){
                 dj = 1;
             }
 
-            int count_forward = Connect4::countNexts(player, row, col, di, dj);
-            int count_backward = Connect4::countNexts(player, row, col, -di, -dj);
+            int count_forward = countNexts(player, row, col, di, dj);
+            int count_backward = countNexts(player, row, col, -di, -dj);
 
             // N_IN_A_ROW minus 1 since the token just inserted is excluded
             if(count_forward + count_backward >= (N_IN_A_ROW - 1)){
@@ -116,7 +186,7 @@ bool Connect4::checkWin(int row, int col, char player){
 
 }
 
-bool Connect4::checkFullTopRow(){
+bool Connect4Generic::checkFullTopRow() const{
     for(int j = 0; j<cols_; ++j){
         if(cells_[j] == 0){
             return false;
@@ -125,10 +195,126 @@ bool Connect4::checkFullTopRow(){
     return true;
 }
 
-int Connect4::getNumCols(){
+char Connect4Generic::getCell(int row, int col) const{
+    return cells_[row*cols_+col];
+}
+
+/**
+ * Adapter of a board specialized at compile time.
+ */
+template <class Board>
+class Connect4Fixed : public Connect4Impl {
+    Board board_;
+    public:
+    Connect4Impl* clone() const { return new Connect4Fixed(*this); }
+    char getCell(int row, int col) const { return board_.getCell(row, col); }
+    int8_t play(int column, char player) { return board_.play(column, player); }
+    bool checkWin(int row, int col, char player) const {
+        return board_.checkWin(row, col, player);
+    }
+    void undo(int column) { board_.undo(column); }
+};
+
+/**
+ * Returns the implementation for the given size.
+ */
+static Connect4Impl* createImpl(int rows, int columns){
+    if (rows == 6 && columns == 7){
+        return new Connect4Fixed<Connect4Board<6, 7, N_IN_A_ROW> >();
+    } else if (rows == 7 && columns == 8){
+        return new Connect4Fixed<Connect4Board<7, 8, N_IN_A_ROW> >();
+    } else if (rows == 8 && columns == 9){
+        return new Connect4Fixed<Connect4Board<8, 9, N_IN_A_ROW> >();
+    } else {
+        return new Connect4Generic(rows, columns);
+    }
+}
+
+Connect4::Connect4(int rows /* = 6 */, int columns /* = 7 */)
+        : rows_(rows), cols_(columns), heights_(columns, 0), hash_(0),
+          player_(0), adversary_(0) {
+    impl_ = createImpl(rows, columns);
+}
+
+Connect4::Connect4(const Connect4& other)
+        : rows_(other.rows_), cols_(other.cols_), heights_(other.heights_),
+          history_(other.history_), hash_(other.hash_),
+          player_(other.player_), adversary_(other.adversary_) {
+    impl_ = other.impl_->clone();
+}
+
+Connect4& Connect4::operator=(const Connect4& other){
+    if (this != &other){
+        Connect4Impl* impl = other.impl_->clone();
+        delete impl_;
+        impl_ = impl;
+        rows_ = other.rows_;
+        cols_ = other.cols_;
+        heights_ = other.heights_;
+        history_ = other.history_;
+        hash_ = other.hash_;
+        player_ = other.player_;
+        adversary_ = other.adversary_;
+    }
+    return *this;
+}
+
+Connect4::~Connect4(){
+    delete impl_;
+}
+
+void Connect4::print(ostream& os){
+    os<<*this;
+}
+
+int8_t Connect4::play(int col, char player){
+    if(player == 0){
+        player = player_;
+    }
+    // -2 is also returned when the move fills the board
+    bool was_full = (int) history_.size() == rows_*cols_;
+    int8_t ret = impl_->play(col, player);
+    if(ret >= 0 || (ret == -2 && !was_full)){
+        int row = rows_-1-heights_[col];
+        hash_ ^= zobristKey(player == 'O' ? 1 : 0, cellIndex(row, col));
+        heights_[col]++;
+        history_.push_back(col);
+    }
+    return ret;
+}
+
+int Connect4::undo(){
+    if(history_.empty()){
+        return -1;
+    }
+    int col = history_.back();
+    history_.pop_back();
+    heights_[col]--;
+    int row = rows_-1-heights_[col];
+    hash_ ^= zobristKey(impl_->getCell(row, col) == 'O' ? 1 : 0, cellIndex(row, col));
+    impl_->undo(col);
+    return col;
+}
+
+bool Connect4::checkWin(int row, int col, char player){
+    if(player == 0){
+        player = player_;
+    }
+    return impl_->checkWin(row, col, player);
+}
+
+int Connect4::getNumCols() const{
     return cols_;
 }
 
+int Connect4::getNumRows() const{
+    return rows_;
+}
+
+char Connect4::getCell(int row, int col) const{
+    return impl_->getCell(row, col);
+}
+
 bool Connect4::setPlayer(char player){
     if(player == 'X' || player == 'x'
         || player == 'O' || player == 'o'){
@@ -148,36 +334,5 @@ char Connect4::getAdv(){
 }
 
 ostream& operator<<(ostream& os, const Connect4& c){
-    int width = 2+3*(c.rows_+1);
-    for(int i = 0; i<width; ++i){
-        os<<'*';
-    }
-    os<<endl;
-
-    for(int i = 0; i<c.rows_; ++i){
-        os<<"*";
-        for(int j = 0; j<c.cols_; ++j){
-            if(c.cells_[i*c.cols_+j] == 0){
-                os<<"   ";
-            } else {
-                os<< " " << (c.cells_[i*c.cols_+j] == 'X' ? "\033[31mX" : "\033[34mO") <<" ";
-            }
-        }
-        os<<"\033[0m*"<<endl;
-    }
-    
-    for(int i = 0; i<width; ++i){
-        os<<'*';
-    }
-    os<<endl;
-
-    for(int i = 0; i<width; ++i){
-        if( (i+1)%3 == 0  ){
-            os<<(i+1)/3;
-        } else {
-            os<<" ";
-        }
-    }
-    os<<endl;
-    return os;
-}
\ No newline at end of file
+    return printBoard(os, c);
+}
@@ -11,19 +11,67 @@
 #define CONNECT4_H
 #include <iostream>
 #include <cstring>
+#include <vector>
+#include <stdint.h>
 #include "config.h"
 #include "logging.h"
 
 
+/**
+ * Returns the Zobrist key of a token of the given player in the given cell.
+ *
+ * Cells are numbered as the bits of Connect4Bitboard (rows+1 per column,
+ * from the bottom), so that boards fitting in a Connect4Bitboard get the same
+ * hash from both classes. The keys are the same at every run.
+ *
+ * @param player    0 for X, 1 for O
+ * @param index     index of the cell
+ */
+uint64_t zobristKey(int player, int index);
+
+/**
+ * Operations of a board of a given size, see Connect4.
+ */
+class Connect4Impl {
+    public:
+    virtual ~Connect4Impl() {}
+    virtual Connect4Impl* clone() const = 0;
+    virtual char getCell(int row, int col) const = 0;
+    virtual int8_t play(int column, char player) = 0;
+    virtual bool checkWin(int row, int col, char player) const = 0;
+
+    /** Removes the last token of a non empty column */
+    virtual void undo(int column) = 0;
+};
+
+/**
+ * Board of a Connect4 game.
+ * 
+ * The most common sizes (6x7, 7x8 and 8x9) are dispatched to a
+ * Connect4Board specialized at compile time, the others to a generic
+ * implementation which works with any size.
+ *
+ * The board keeps the Zobrist hash of the position, updated by play() and
+ * undo().
+ */
 class Connect4 {
-    /** Rows, cols and total size of the board */
-    int rows_, cols_, size_;
+    /** Rows and cols of the board */
+    int rows_, cols_;
+
+    /** Implementation for the size of the board */
+    Connect4Impl* impl_;
+
+    /** Number of tokens in each column */
+    std::vector<int> heights_;
+
+    /** Columns played so far, used by undo() */
+    std::vector<int8_t> history_;
 
-    /** State of the board */
-    bool full_;
+    /** Zobrist hash of the position */
+    uint64_t hash_;
 
-    /** Matrix data structure for the board */
-    char* cells_;
+    /** Returns the index of the Zobrist key of the given cell */
+    int cellIndex(int row, int col) const { return col*(rows_+1) + rows_-1-row; }
 
     /** Player marker */
     char player_;
@@ -31,27 +79,6 @@ class Connect4 {
     /** Adversary marker */
     char adversary_;
 
-    /** 
-     * Counts the tokens of the player towards a direction (di, dj) 
-     * starting from  (row, col)  
-     * 
-     * @param player   player marker for whom we count the tokens
-     * @param row      starting row
-     * @param col      starting col
-     * @param di       step size for rows (each iteration row+di)
-     * @param dj       step size for cols (each iteration row+dj)
-     *
-     * @return         number of tokens along the (one way) direction
-     */
-    int countNexts(char player, int row, int col, int di, int dj);
-
-    /**
-     * @brief Checks if the top row is full, this would mean all the board is full
-     * 
-     * @return true if full
-     * @return false if at least one cell is empty
-     */
-    bool checkFullTopRow();
     public:
 
     /**
@@ -62,12 +89,32 @@ class Connect4 {
      */
     Connect4(int rows = 6, int columns = 7);
 
+    Connect4(const Connect4& other);
+    Connect4& operator=(const Connect4& other);
+    ~Connect4();
+
     /**
      * @brief Get the number of columns of the board
      * 
      * @return number of columns 
      */
-    int getNumCols();
+    int getNumCols() const;
+
+    /**
+     * @brief Get the number of rows of the board
+     * 
+     * @return number of rows 
+     */
+    int getNumRows() const;
+
+    /**
+     * @brief Get the marker in the given cell
+     * 
+     * @param row   row of the cell (0 is the top row)
+     * @param col   column of the cell
+     * @return the player marker, 0 if the cell is empty
+     */
+    char getCell(int row, int col) const;
 
     /**
      * Inserts a token.
@@ -82,6 +129,67 @@ class Connect4 {
      */
     int8_t play(int column, char player = 0);
 
+    /**
+     * Removes the last token inserted by play() and updates the hash
+     * accordingly.
+     *
+     * @return the column of the removed token, -1 if the board is empty
+     */
+    int undo();
+
+    /**
+     * @brief Get the number of tokens on the board
+     */
+    int getNumMoves() const { return history_.size(); }
+
+    /**
+     * @brief Checks whether the board is full
+     */
+    bool isFull() const { return (int) history_.size() == rows_*cols_; }
+
+    /**
+     * @brief Checks whether a token can be inserted in the given column
+     *
+     * @param col   column to check
+     * @return true if the column exists and is not full
+     */
+    bool canPlay(int col) const {
+        return col >= 0 && col < cols_ && heights_[col] < rows_;
+    }
+
+    /**
+     * @brief Checks whether inserting a token in the given column wins
+     *
+     * The column must be playable.
+     *
+     * @param col       column where the token would be added
+     * @param player    player who is making the move
+     * @return true if the move wins the game
+     */
+    bool isWinningMove(int col, char player) const {
+        return impl_->checkWin(rows_-1-heights_[col], col, player);
+    }
+
+    /**
+     * Inserts a token in a playable column, ignoring the result.
+     *
+     * Same interface of Connect4Bitboard::makeMove(), so that the AI can
+     * work on boards of any size. The move can be reverted with undo().
+     *
+     * @param col       column where the token is added
+     * @param player    player who is making the move
+     */
+    void makeMove(int col, char player) { play(col, player); }
+
+    /**
+     * @brief Get the Zobrist hash of the position
+     *
+     * It only depends on the tokens on the board, not on the order in which
+     * they were played, and it is the same of Connect4Bitboard::getHash() for
+     * the boards that fit in a bitboard.
+     */
+    uint64_t getHash() const { return hash_; }
+
     /**
      * Checks if an inserted token causes a win
      * 
@@ -125,4 +233,53 @@ class Connect4 {
 
     friend std::ostream& operator<<(std::ostream& os, const Connect4& b);
 };
+
+/**
+ * @brief Prints a board in the format used by the game
+ * 
+ * It is shared among the board implementations, which only need to provide
+ * getNumRows(), getNumCols() and getCell().
+ * 
+ * @param os    Output stream where the board has to be printed
+ * @param b     Board to be printed
+ * @return the output stream
+ */
+template <class Board>
+std::ostream& printBoard(std::ostream& os, const Board& b){
+    int rows = b.getNumRows();
+    int cols = b.getNumCols();
+    int width = 2+3*cols;
+    for(int i = 0; i<width; ++i){
+        os<<'*';
+    }
+    os<<std::endl;
+
+    for(int i = 0; i<rows; ++i){
+        os<<"*";
+        for(int j = 0; j<cols; ++j){
+            char cell = b.getCell(i, j);
+            if(cell == 0){
+                os<<"   ";
+            } else {
+                os<< " " << (cell == 'X' ? "\033[31mX" : "\033[34mO") <<" ";
+            }
+        }
+        os<<"\033[0m*"<<std::endl;
+    }
+    
+    for(int i = 0; i<width; ++i){
+        os<<'*';
+    }
+    os<<std::endl;
+
+    for(int i = 0; i<width; ++i){
+        if( (i+1)%3 == 0  ){
+            os<<(i+1)/3;
+        } else {
+            os<<" ";
+        }
+    }
+    os<<std::endl;
+    return os;
+}
 #endif //CONNECT4_H
\ No newline at end of file
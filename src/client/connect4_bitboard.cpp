@@ -0,0 +1,179 @@
+/**
+ * @file connect4_bitboard.cpp
+ *
+ * @brief Implementation of connect4_bitboard.h
+ *
+ * @see connect4_bitboard.h
+ */
+#include "connect4_bitboard.h"
+using namespace std;
+
+uint64_t Connect4Bitboard::zobrist_[2][64];
+
+/** Forces the initialization of the keys before main() */
+bool Connect4Bitboard::zobrist_initialized_ = Connect4Bitboard::initZobrist();
+
+bool Connect4Bitboard::initZobrist(){
+    // the same keys of Connect4
+    for (int p = 0; p < 2; ++p){
+        for (int i = 0; i < 64; ++i){
+            zobrist_[p][i] = zobristKey(p, i);
+        }
+    }
+    return true;
+}
+
+Connect4Bitboard::Connect4Bitboard(int rows /* = 6 */, int columns /* = 7 */){
+    if (!fits(rows, columns)){
+        throw "Board does not fit in a bitboard";
+    }
+
+    rows_ = rows;
+    cols_ = columns;
+    size_ = rows*columns;
+    height_ = rows+1;
+
+    tokens_[0] = 0;
+    tokens_[1] = 0;
+    mask_ = 0;
+    moves_ = 0;
+    hash_ = 0;
+    player_ = 0;
+    adversary_ = 0;
+
+    bottom_mask_ = 0;
+    board_mask_ = 0;
+    for (int j = 0; j < cols_; ++j){
+        bottom_mask_ |= (bitboard_t) 1 << (j*height_);
+        board_mask_ |= columnMask(j);
+    }
+}
+
+Connect4Bitboard::Connect4Bitboard(const Connect4& board)
+        : Connect4Bitboard(board.getNumRows(), board.getNumCols()) {
+    for (int j = 0; j < cols_; ++j){
+        for (int i = rows_-1; i >= 0 && board.getCell(i, j) != 0; --i){
+            makeMove(j, board.getCell(i, j));
+        }
+    }
+}
+
+void Connect4Bitboard::print(ostream& os){
+    os<<*this;
+}
+
+char Connect4Bitboard::getCell(int row, int col) const{
+    bitboard_t cell = cellBit(row, col);
+    if (tokens_[0] & cell){
+        return 'X';
+    } else if (tokens_[1] & cell){
+        return 'O';
+    } else {
+        return 0;
+    }
+}
+
+int8_t Connect4Bitboard::play(int col, char player){
+    if(player == 0){
+        player = player_;
+    }
+
+    //Trying to play with a full board
+    if(moves_ == size_){
+        return -2;
+    }
+
+    if(col < 0 || col >= cols_ || (mask_ & topBit(col))){
+        return -1;
+    }
+
+    bitboard_t cell = nextCell(col);
+    makeMove(col, player);
+
+    if (checkCell(tokens_[playerIndex(player)], cell)){
+        return 1;
+    }
+
+    //All the board could be full now
+    return moves_ == size_ ? -2 : 0;
+}
+
+bool Connect4Bitboard::checkDirection(bitboard_t tokens, bitboard_t cell, int shift){
+    // bit i of run is set iff bits i, i+shift, ..., i+(N-1)*shift are set
+    bitboard_t run = tokens;
+    // cells from which an alignment containing cell may start
+    bitboard_t starts = cell;
+    for (int k = 1; k < N_IN_A_ROW; ++k){
+        run &= tokens >> (k*shift);
+        starts |= cell >> (k*shift);
+    }
+    return (run & starts) != 0;
+}
+
+bool Connect4Bitboard::checkWin(int row, int col, char player){
+    if(player == 0){
+        player = player_;
+    }
+
+    // the cell is counted as the player's one even if it is not set yet
+    bitboard_t cell = cellBit(row, col);
+    bitboard_t tokens = tokens_[playerIndex(player)] | cell;
+
+    return checkCell(tokens, cell);
+}
+
+bool Connect4Bitboard::checkCell(bitboard_t tokens, bitboard_t cell) const{
+    return checkDirection(tokens, cell, 1)
+        || checkDirection(tokens, cell, height_)
+        || checkDirection(tokens, cell, height_-1)
+        || checkDirection(tokens, cell, height_+1);
+}
+
+bool Connect4Bitboard::hasAlignment(bitboard_t tokens) const{
+    int shifts[] = {1, height_, height_-1, height_+1};
+    for (int d = 0; d < 4; ++d){
+        bitboard_t run = tokens;
+        for (int k = 1; k < N_IN_A_ROW; ++k){
+            run &= tokens >> (k*shifts[d]);
+        }
+        if (run){
+            return true;
+        }
+    }
+    return false;
+}
+
+bitboard_t Connect4Bitboard::winningCells(bitboard_t tokens) const{
+    int shifts[] = {1, height_, height_-1, height_+1};
+    bitboard_t cells = 0;
+    for (int d = 0; d < 4; ++d){
+        // j is the position of the empty cell inside the alignment
+        for (int j = 0; j < N_IN_A_ROW; ++j){
+            bitboard_t r = board_mask_;
+            for (int i = 0; i < N_IN_A_ROW; ++i){
+                int offset = (i-j)*shifts[d];
+                if (offset > 0){
+                    r &= tokens >> offset;
+                } else if (offset < 0){
+                    r &= tokens << -offset;
+                }
+            }
+            cells |= r;
+        }
+    }
+    return cells & ~mask_;
+}
+
+bool Connect4Bitboard::setPlayer(char player){
+    if(player == 'X' || player == 'x'
+        || player == 'O' || player == 'o'){
+        player_ = toupper(player);
+        adversary_ = player_ == 'X' ? 'O' : 'X';
+        return true;
+    }
+    return false;
+}
+
+ostream& operator<<(ostream& os, const Connect4Bitboard& c){
+    return printBoard(os, c);
+}
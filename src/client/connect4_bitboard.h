@@ -0,0 +1,378 @@
+/**
+ * @file connect4_bitboard.h
+ *
+ * @brief Header file for the bitboard implementation of the Connect4 board
+ */
+
+#ifndef CONNECT4_BITBOARD_H
+#define CONNECT4_BITBOARD_H
+#include <iostream>
+#include <stdint.h>
+#include "config.h"
+#include "logging.h"
+#include "connect4.h"
+
+/** Type of a bitboard: one bit per cell of the board */
+typedef uint64_t bitboard_t;
+
+/** Xored to the position hash when O is to move */
+#define SIDE_KEY 0xd1b54a32d192ed03ULL
+
+/**
+ * Connect4 board that keeps the tokens of each player in a bitboard.
+ *
+ * It exposes the same interface of Connect4, but checking for a win is done
+ * with a few shift-and-AND operations instead of walking the board.
+ *
+ * Layout of the bits (6x7 board): each column uses rows+1 bits, the extra one
+ * (sentinel) is always empty so that alignments cannot wrap around columns.
+ *
+ *   6 13 20 27 34 41 48   <- sentinel row
+ *   5 12 19 26 33 40 47   <- row 0 (top)
+ *   4 11 18 25 32 39 46
+ *   3 10 17 24 31 38 45
+ *   2  9 16 23 30 37 44
+ *   1  8 15 22 29 36 43
+ *   0  7 14 21 28 35 42   <- row rows-1 (bottom)
+ *
+ * Therefore the board must satisfy columns*(rows+1) <= 64.
+ */
+class Connect4Bitboard {
+    /** Rows, cols, total size of the board and bits per column */
+    int rows_, cols_, size_, height_;
+
+    /** Tokens of each player: index 0 for X and 1 for O */
+    bitboard_t tokens_[2];
+
+    /** Occupied cells (union of tokens_) */
+    bitboard_t mask_;
+
+    /** Bottom cell of each column */
+    bitboard_t bottom_mask_;
+
+    /** All playable cells (i.e. without the sentinel row) */
+    bitboard_t board_mask_;
+
+    /** Number of tokens on the board */
+    int moves_;
+
+    /** Columns played so far, used by undo() */
+    int8_t history_[64];
+
+    /** Zobrist hash of the position, updated at every move */
+    uint64_t hash_;
+
+    /** Zobrist keys: a random number for each player and bit */
+    static uint64_t zobrist_[2][64];
+
+    /** Fills zobrist_, called once at startup */
+    static bool initZobrist();
+    static bool zobrist_initialized_;
+
+    /** Player marker */
+    char player_;
+
+    /** Adversary marker */
+    char adversary_;
+
+    /**
+     * @brief Returns the index in tokens_ of the given marker
+     *
+     * @param player    player marker ('X' or 'O')
+     * @return 0 for X, 1 for O
+     */
+    static int playerIndex(char player) { return player == 'O' ? 1 : 0; }
+
+    /**
+     * @brief Returns the bit of the given cell
+     *
+     * @param row   row of the cell (0 is the top row)
+     * @param col   column of the cell
+     */
+    bitboard_t cellBit(int row, int col) const {
+        return (bitboard_t) 1 << (col*height_ + rows_-1-row);
+    }
+
+    /**
+     * @brief Returns the top cell of the given column
+     */
+    bitboard_t topBit(int col) const {
+        return (bitboard_t) 1 << (col*height_ + rows_-1);
+    }
+
+    /**
+     * @brief Returns all the cells of the given column
+     */
+    bitboard_t columnMask(int col) const {
+        return (((bitboard_t) 1 << rows_) - 1) << (col*height_);
+    }
+
+    /**
+     * @brief Returns the first empty cell of the given column
+     *
+     * Adding the bottom bit of the column to the occupied cells of the
+     * column sets the first empty one.
+     */
+    bitboard_t nextCell(int col) const {
+        return (mask_ + (bottom_mask_ & columnMask(col))) & columnMask(col);
+    }
+
+    /**
+     * Checks whether the given cell is part of an alignment of N_IN_A_ROW
+     * tokens along the direction identified by shift.
+     *
+     * @param tokens    bitboard of the player
+     * @param cell      bit of the cell to check
+     * @param shift     1 (vertical), height_ (horizontal), height_-1 and
+     *                  height_+1 (diagonals)
+     * @return true if the cell is part of the alignment
+     */
+    static bool checkDirection(bitboard_t tokens, bitboard_t cell, int shift);
+
+    /**
+     * Checks whether the given cell is part of an alignment of N_IN_A_ROW
+     * tokens along any direction.
+     *
+     * @param tokens    bitboard of the player
+     * @param cell      bit of the cell to check
+     * @return true if the cell is part of an alignment
+     */
+    bool checkCell(bitboard_t tokens, bitboard_t cell) const;
+
+    public:
+
+    /**
+     * @brief Construct a new Connect 4 bitboard
+     *
+     * Throws if the board does not fit in a bitboard.
+     *
+     * @param rows      Number of rows
+     * @param columns   Number of columns
+     */
+    Connect4Bitboard(int rows = 6, int columns = 7);
+
+    /**
+     * @brief Construct a bitboard with the tokens of the given board
+     *
+     * Throws if the board does not fit in a bitboard. The move history is
+     * not kept: undo() removes the tokens column by column.
+     *
+     * @param board     board to be copied
+     */
+    explicit Connect4Bitboard(const Connect4& board);
+
+    /**
+     * @brief Checks whether a board of the given size fits in a bitboard
+     */
+    static bool fits(int rows, int columns) {
+        return rows > 0 && columns > 0 && columns*(rows+1) <= 64;
+    }
+
+    /**
+     * @brief Get the number of columns of the board
+     *
+     * @return number of columns
+     */
+    int getNumCols() const { return cols_; }
+
+    /**
+     * @brief Get the number of rows of the board
+     *
+     * @return number of rows
+     */
+    int getNumRows() const { return rows_; }
+
+    /**
+     * @brief Get the marker in the given cell
+     *
+     * @param row   row of the cell (0 is the top row)
+     * @param col   column of the cell
+     * @return the player marker, 0 if the cell is empty
+     */
+    char getCell(int row, int col) const;
+
+    /**
+     * Inserts a token.
+     *
+     * @param column   target column where the token should be added
+     * @param player   player who is making the move
+     *
+     * @retval 1        Success with win
+     * @retval 0        Success without win
+     * @retval -1       Failure for full (or non existing) column
+     * @retval -2       Board is full, it could be so before or after the move takes place
+     */
+    int8_t play(int column, char player = 0);
+
+    /**
+     * Checks if an inserted token causes a win
+     *
+     * @param starting_row  row of the token
+     * @param starting_col  col of the token
+     * @param player        marker of the player inserting the token
+     *
+     * @return              true if winning, false otherwise
+     */
+    bool checkWin(int starting_row, int starting_col, char player = 0);
+
+    /**
+     * @brief Checks whether a token can be inserted in the given column
+     *
+     * @param col   column to check
+     * @return true if the column exists and is not full
+     */
+    bool canPlay(int col) const {
+        return col >= 0 && col < cols_ && !(mask_ & topBit(col));
+    }
+
+    /**
+     * @brief Checks whether inserting a token in the given column wins
+     *
+     * The column must be playable.
+     *
+     * @param col       column where the token would be added
+     * @param player    player who is making the move
+     * @return true if the move wins the game
+     */
+    bool isWinningMove(int col, char player) const {
+        bitboard_t cell = nextCell(col);
+        return checkCell(tokens_[playerIndex(player)] | cell, cell);
+    }
+
+    /**
+     * Inserts a token without checking for a win.
+     *
+     * This is the fast path used by the AI: the column must be playable and
+     * no memory is allocated. The move can be reverted with undo().
+     *
+     * @param col       column where the token is added
+     * @param player    player who is making the move
+     */
+    void makeMove(int col, char player){
+        bitboard_t cell = nextCell(col);
+        int p = playerIndex(player);
+        tokens_[p] |= cell;
+        mask_ |= cell;
+        hash_ ^= zobrist_[p][__builtin_ctzll(cell)];
+        history_[moves_++] = col;
+    }
+
+    /**
+     * Removes the last inserted token, either by play() or makeMove(), and
+     * updates the hash accordingly.
+     *
+     * @return the column of the removed token, -1 if the board is empty
+     */
+    int undo(){
+        if (moves_ == 0){
+            return -1;
+        }
+        int col = history_[--moves_];
+        // the last token of the column is right below the first empty cell
+        bitboard_t cell = canPlay(col) ? nextCell(col) >> 1 : topBit(col);
+        hash_ ^= zobrist_[tokens_[0] & cell ? 0 : 1][__builtin_ctzll(cell)];
+        tokens_[0] &= ~cell;
+        tokens_[1] &= ~cell;
+        mask_ &= ~cell;
+        return col;
+    }
+
+    /**
+     * @brief Get the number of tokens on the board
+     */
+    int getNumMoves() const { return moves_; }
+
+    /**
+     * @brief Checks whether the board is full
+     */
+    bool isFull() const { return moves_ == size_; }
+
+    /**
+     * @brief Get the bitboard of the given player
+     */
+    bitboard_t getTokens(char player) const { return tokens_[playerIndex(player)]; }
+
+    /**
+     * @brief Get the bitboard of the occupied cells
+     */
+    bitboard_t getMask() const { return mask_; }
+
+    /**
+     * @brief Get the cells where a token can be inserted (one per column)
+     */
+    bitboard_t getPlayableCells() const {
+        return (mask_ + bottom_mask_) & board_mask_;
+    }
+
+    /**
+     * @brief Get the bitboard of all the cells of the given column
+     */
+    bitboard_t getColumnMask(int col) const { return columnMask(col); }
+
+    /**
+     * @brief Get the Zobrist hash of the position
+     *
+     * It only depends on the tokens on the board, not on the order in which
+     * they were played.
+     */
+    uint64_t getHash() const { return hash_; }
+
+    /**
+     * Returns the hash of the position together with the player to move,
+     * used as key by the transposition table and the opening book.
+     */
+    uint64_t getKey(char side) const {
+        return hash_ ^ (side == 'O' ? SIDE_KEY : 0);
+    }
+
+    /**
+     * Returns the empty cells that would complete an alignment of N_IN_A_ROW
+     * tokens for the given player, even if they are not playable yet.
+     *
+     * @param tokens    bitboard of the player
+     * @return bitboard of the winning cells
+     */
+    bitboard_t winningCells(bitboard_t tokens) const;
+
+    /**
+     * Checks whether the given bitboard contains an alignment of N_IN_A_ROW
+     * tokens anywhere on the board.
+     *
+     * @param tokens    bitboard of the player
+     * @return true if there is an alignment
+     */
+    bool hasAlignment(bitboard_t tokens) const;
+
+    /**
+     * @brief Sets the default player
+     *
+     * @param player    player to be set
+     * @return true if a valid player was supplied and set
+     * @return false otherwise
+     */
+    bool setPlayer(char player);
+
+    /**
+     * @brief Get the default player
+     *
+     * @return player marker
+     */
+    char getPlayer() { return player_; }
+
+    /**
+     * @brief Get the adversary, when a default player is set
+     *
+     * @return enemy marker
+     */
+    char getAdv() { return adversary_; }
+
+    /**
+     * @brief Prints the board
+     *
+     * @param os    Output stream where the board has to be printed
+     */
+    void print(std::ostream& os);
+
+    friend std::ostream& operator<<(std::ostream& os, const Connect4Bitboard& b);
+};
+#endif //CONNECT4_BITBOARD_H
@@ -0,0 +1,217 @@
+/**
+ * @file connect4_board.h
+ *
+ * @brief Header file for the Connect4 board specialized at compile time for
+ *        a given size
+ */
+
+#ifndef CONNECT4_BOARD_H
+#define CONNECT4_BOARD_H
+#include <stdint.h>
+#include <cctype>
+#include <type_traits>
+
+/**
+ * Connect4 board whose size and length of the alignments are template
+ * parameters.
+ *
+ * Tokens are kept in bitboards with the same layout of Connect4Bitboard
+ * (Rows+1 bits per column, the extra one is always empty), but all the masks
+ * and shifts are compile time constants: index computations fold into
+ * constants and the loops of the win check have a constant trip count, so
+ * the compiler fully unrolls them.
+ *
+ * Boards with more than 64 bits use a 128 bits integer.
+ *
+ * @tparam Rows     number of rows
+ * @tparam Cols     number of columns
+ * @tparam K        number of tokens of an alignment
+ */
+template <int Rows, int Cols, int K>
+class Connect4Board {
+    static_assert(Rows > 0 && Cols > 0 && K > 1, "Invalid board size");
+    static_assert(Cols*(Rows+1) <= 128, "Board does not fit in 128 bits");
+
+public:
+    /** Type of a bitboard: one bit per cell of the board */
+    typedef typename std::conditional<(Cols*(Rows+1) <= 64),
+                                      uint64_t, unsigned __int128>::type bits_t;
+
+    /** Bits per column */
+    static constexpr int HEIGHT = Rows+1;
+
+    /** Number of cells */
+    static constexpr int SIZE = Rows*Cols;
+
+private:
+    /** Shifts of the four directions: vertical, horizontal and diagonals */
+    static constexpr int SHIFTS[4] = {1, HEIGHT, HEIGHT-1, HEIGHT+1};
+
+    /** Returns the bottom cell of each column */
+    static constexpr bits_t bottomMask(){
+        bits_t mask = 0;
+        for (int j = 0; j < Cols; ++j){
+            mask |= (bits_t) 1 << (j*HEIGHT);
+        }
+        return mask;
+    }
+
+    /** All the cells of a column */
+    static constexpr bits_t columnMask(int col){
+        return (((bits_t) 1 << Rows) - 1) << (col*HEIGHT);
+    }
+
+    /** Top cell of a column */
+    static constexpr bits_t topBit(int col){
+        return (bits_t) 1 << (col*HEIGHT + Rows-1);
+    }
+
+    /** Bit of a cell (row 0 is the top row) */
+    static constexpr bits_t cellBit(int row, int col){
+        return (bits_t) 1 << (col*HEIGHT + Rows-1-row);
+    }
+
+    static constexpr bits_t BOTTOM_MASK = bottomMask();
+
+    /** Tokens of each player: index 0 for X and 1 for O */
+    bits_t tokens_[2];
+
+    /** Occupied cells */
+    bits_t mask_;
+
+    /** Number of tokens on the board */
+    int moves_;
+
+    /** Player marker */
+    char player_;
+
+    /** Adversary marker */
+    char adversary_;
+
+    static int playerIndex(char player) { return player == 'O' ? 1 : 0; }
+
+    /**
+     * Checks whether the given cell is part of an alignment of K tokens along
+     * the direction identified by Shift.
+     */
+    template <int Shift>
+    static bool checkDirection(bits_t tokens, bits_t cell){
+        // bit i of run is set iff bits i, i+Shift, ..., i+(K-1)*Shift are set
+        bits_t run = tokens;
+        // cells from which an alignment containing cell may start
+        bits_t starts = cell;
+        for (int k = 1; k < K; ++k){
+            run &= tokens >> (k*Shift);
+            starts |= cell >> (k*Shift);
+        }
+        return (run & starts) != 0;
+    }
+
+    /**
+     * Checks whether the given cell is part of an alignment along any
+     * direction.
+     */
+    static bool checkCell(bits_t tokens, bits_t cell){
+        return checkDirection<SHIFTS[0]>(tokens, cell)
+            || checkDirection<SHIFTS[1]>(tokens, cell)
+            || checkDirection<SHIFTS[2]>(tokens, cell)
+            || checkDirection<SHIFTS[3]>(tokens, cell);
+    }
+
+public:
+    Connect4Board() : mask_(0), moves_(0), player_(0), adversary_(0) {
+        tokens_[0] = 0;
+        tokens_[1] = 0;
+    }
+
+    static constexpr int getNumRows() { return Rows; }
+    static constexpr int getNumCols() { return Cols; }
+
+    /**
+     * @brief Get the marker in the given cell
+     *
+     * @param row   row of the cell (0 is the top row)
+     * @param col   column of the cell
+     * @return the player marker, 0 if the cell is empty
+     */
+    char getCell(int row, int col) const {
+        bits_t cell = cellBit(row, col);
+        return tokens_[0] & cell ? 'X' : tokens_[1] & cell ? 'O' : 0;
+    }
+
+    /**
+     * Inserts a token.
+     *
+     * @see Connect4::play()
+     */
+    int8_t play(int col, char player = 0){
+        if (player == 0){
+            player = player_;
+        }
+
+        if (moves_ == SIZE){
+            return -2;
+        }
+
+        if (col < 0 || col >= Cols || (mask_ & topBit(col))){
+            return -1;
+        }
+
+        bits_t cell = (mask_ + (BOTTOM_MASK & columnMask(col))) & columnMask(col);
+        int p = playerIndex(player);
+        tokens_[p] |= cell;
+        mask_ |= cell;
+        moves_++;
+
+        if (checkCell(tokens_[p], cell)){
+            return 1;
+        }
+        return moves_ == SIZE ? -2 : 0;
+    }
+
+    /**
+     * Removes the last token of a non empty column.
+     */
+    void undo(int col){
+        // the last token is right below the first empty cell, if any
+        bits_t next = (mask_ + (BOTTOM_MASK & columnMask(col))) & columnMask(col);
+        bits_t cell = next ? next >> 1 : topBit(col);
+        tokens_[0] &= ~cell;
+        tokens_[1] &= ~cell;
+        mask_ &= ~cell;
+        moves_--;
+    }
+
+    /**
+     * Checks if a token in the given cell causes a win. The cell is counted
+     * as the player's one even if it is not set yet.
+     *
+     * @see Connect4::checkWin()
+     */
+    bool checkWin(int row, int col, char player = 0) const {
+        if (player == 0){
+            player = player_;
+        }
+        bits_t cell = cellBit(row, col);
+        return checkCell(tokens_[playerIndex(player)] | cell, cell);
+    }
+
+    /**
+     * @brief Sets the default player
+     *
+     * @return true if a valid player was supplied and set
+     */
+    bool setPlayer(char player){
+        if (player == 'X' || player == 'x' || player == 'O' || player == 'o'){
+            player_ = toupper(player);
+            adversary_ = player_ == 'X' ? 'O' : 'X';
+            return true;
+        }
+        return false;
+    }
+
+    char getPlayer() const { return player_; }
+    char getAdv() const { return adversary_; }
+};
+
+#endif //CONNECT4_BOARD_H
@@ -10,6 +10,7 @@
 #define CONNECTION_MODE_H
 
 #include "security/secure_host.h"
+#include "single_player.h"
 
 /** 
  * Type of gmae connection requested by the user:
@@ -19,7 +20,7 @@
  *      game.
  * WAIT_FOR_PEER: the user waits for requests from other peers on the given 
  *      port and accepts any incoming game.
- * SINGLE_PLAYER: the player plays against an AI (tbf it's random).
+ * SINGLE_PLAYER: the player plays against an AI with the given options.
  * EXIT: (used internally) exit the game with the given return code.
  */
 enum ConnectionType {CONNECT_TO_SERVER, CONNECT_TO_PEER, WAIT_FOR_PEER, SINGLE_PLAYER, EXIT, CONTINUE};
@@ -37,6 +38,7 @@ struct ConnectionMode {
     union{
         uint16_t listen_port;
         enum ExitCode exit_code;
+        struct SinglePlayerOptions sp_options;
     };
     ConnectionMode(enum ConnectionType connection_type, 
                         const char* ip, int port, X509* cert, uint16_t listen_port) 
@@ -47,6 +49,9 @@ struct ConnectionMode {
     ConnectionMode(enum ConnectionType connection_type, enum ExitCode exit_code) 
             : connection_type(connection_type), exit_code(exit_code) {}
 
+    ConnectionMode(enum ConnectionType connection_type, struct SinglePlayerOptions sp_options) 
+            : connection_type(connection_type), sp_options(sp_options) {}
+
     ConnectionMode(enum ConnectionType connection_type) 
             : connection_type(connection_type) {}
 
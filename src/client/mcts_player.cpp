@@ -0,0 +1,440 @@
+/**
+ * @file mcts_player.cpp
+ *
+ * @brief Implementation of mcts_player.h
+ *
+ * @see mcts_player.h
+ */
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include "mcts_player.h"
+#include "logging.h"
+
+/** Exploration constant of UCT */
+#define UCT_C 1.41f
+
+/**
+ * Playouts per thread of every leaf when running on several threads: waking
+ * up the pool costs much more than a single playout.
+ */
+#define PARALLEL_BATCH 16
+
+/** Minimum size of the tree: the root and its children must always fit */
+#define MIN_NODES (MCTS_MAX_COLS + 1)
+
+/**
+ * Returns the current time of the monotonic clock in milliseconds
+ */
+static int64_t nowMs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+static char other(char player){
+    return player == 'X' ? 'O' : 'X';
+}
+
+/**
+ * xorshift64* generator, the state must not be 0
+ */
+static inline uint64_t nextRandom(uint64_t* state){
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+NodeArena::NodeArena(uint32_t capacity) : capacity_(capacity), used_(0) {
+    nodes_ = (MCTSNode*) malloc(sizeof(MCTSNode)*capacity);
+    if (nodes_ == NULL){
+        throw "Could not allocate the MCTS tree";
+    }
+}
+
+NodeArena::~NodeArena(){
+    free(nodes_);
+}
+
+MCTSPlayer::MCTSPlayer(Difficulty difficulty /* = HARD */,
+                       uint32_t max_nodes /* = MCTS_DEFAULT_NODES */)
+        : MCTSPlayer(0, 0, max_nodes) {
+    switch(difficulty){
+        case EASY:
+            max_playouts_ = MCTS_EASY_PLAYOUTS;
+            break;
+        case MEDIUM:
+            max_playouts_ = MCTS_MEDIUM_PLAYOUTS;
+            break;
+        case HARD:
+            time_budget_ms_ = AI_HARD_TIME_MS;
+            break;
+        case EXPERT:
+        default:
+            time_budget_ms_ = AI_EXPERT_TIME_MS;
+            break;
+    }
+}
+
+MCTSPlayer::MCTSPlayer(int max_playouts, int time_budget_ms, uint32_t max_nodes)
+        : arena_(max_nodes), n_threads_(1), batch_id_(0), pending_(0),
+          quit_(false), leaf_(NULL), generic_leaf_(NULL), leaf_side_('X'),
+          batch_size_(1),
+          max_playouts_(max_playouts), time_budget_ms_(time_budget_ms),
+          playouts_(0), last_nodes_(0), last_time_ms_(0), last_value_(0) {
+    if (max_nodes < MIN_NODES){
+        throw "MCTS tree too small";
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (int t = 0; t < AI_MAX_THREADS; ++t){
+        workers_[t].ai = this;
+        workers_[t].id = t;
+        workers_[t].rng = ((uint64_t) ts.tv_nsec ^ (uint64_t) ts.tv_sec << 32)
+                          + (t+1)*0x9e3779b97f4a7c15ULL;
+        if (workers_[t].rng == 0){
+            workers_[t].rng = 1;
+        }
+        workers_[t].result = 0;
+    }
+
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&start_cond_, NULL);
+    pthread_cond_init(&done_cond_, NULL);
+}
+
+MCTSPlayer::~MCTSPlayer(){
+    stopPool();
+    pthread_cond_destroy(&done_cond_);
+    pthread_cond_destroy(&start_cond_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+bool MCTSPlayer::setThreads(int n_threads){
+    if (n_threads < 1 || n_threads > AI_MAX_THREADS){
+        return false;
+    }
+    stopPool();
+    n_threads_ = n_threads;
+    startPool();
+    return true;
+}
+
+void MCTSPlayer::startPool(){
+    for (int t = 1; t < n_threads_; ++t){
+        workers_[t].batch_id = batch_id_;
+        if (pthread_create(&workers_[t].thread, NULL, poolThread, &workers_[t]) != 0){
+            LOG(LOG_WARN, "Could not start playout thread %d", t);
+            n_threads_ = t;
+            break;
+        }
+    }
+    batch_size_ = n_threads_ > 1 ? PARALLEL_BATCH : 1;
+}
+
+void MCTSPlayer::stopPool(){
+    pthread_mutex_lock(&mutex_);
+    quit_ = true;
+    pthread_cond_broadcast(&start_cond_);
+    pthread_mutex_unlock(&mutex_);
+
+    for (int t = 1; t < n_threads_; ++t){
+        pthread_join(workers_[t].thread, NULL);
+    }
+    quit_ = false;
+    n_threads_ = 1;
+}
+
+void* MCTSPlayer::poolThread(void* arg){
+    Worker* w = (Worker*) arg;
+    MCTSPlayer* ai = w->ai;
+
+    pthread_mutex_lock(&ai->mutex_);
+    while (1){
+        while (!ai->quit_ && ai->batch_id_ == w->batch_id){
+            pthread_cond_wait(&ai->start_cond_, &ai->mutex_);
+        }
+        if (ai->quit_){
+            break;
+        }
+        w->batch_id = ai->batch_id_;
+        pthread_mutex_unlock(&ai->mutex_);
+
+        ai->runBatch(*w);
+
+        pthread_mutex_lock(&ai->mutex_);
+        if (--ai->pending_ == 0){
+            pthread_cond_signal(&ai->done_cond_);
+        }
+    }
+    pthread_mutex_unlock(&ai->mutex_);
+    return NULL;
+}
+
+template <class Board>
+float MCTSPlayer::playout(Board& board, char side, uint64_t* rng){
+    char last = other(side);
+    int cols = board.getNumCols();
+    int playable[MCTS_MAX_COLS];
+
+    while (!board.isFull()){
+        int n = 0;
+        for (int col = 0; col < cols; ++col){
+            if (board.canPlay(col)){
+                playable[n++] = col;
+            }
+        }
+
+        int col = playable[nextRandom(rng) % n];
+        if (board.isWinningMove(col, side)){
+            return side == last ? 1 : 0;
+        }
+        board.makeMove(col, side);
+        side = other(side);
+    }
+    return 0.5f;
+}
+
+template <class Board>
+float MCTSPlayer::runPlayouts(const Board& leaf, Worker& w){
+    // a single copy, taken back to the leaf after every playout, so that
+    // the generic board is not allocated at every playout
+    Board board = leaf;
+    float result = 0;
+    for (int i = 0; i < batch_size_; ++i){
+        result += playout(board, leaf_side_, &w.rng);
+        while (board.getNumMoves() > leaf.getNumMoves()){
+            board.undo();
+        }
+    }
+    return result;
+}
+
+void MCTSPlayer::runBatch(Worker& w){
+    if (generic_leaf_ != NULL){
+        w.result = runPlayouts(*generic_leaf_, w);
+    } else {
+        w.result = runPlayouts(*leaf_, w);
+    }
+}
+
+void MCTSPlayer::setLeaf(const Connect4Bitboard& board){
+    leaf_ = &board;
+    generic_leaf_ = NULL;
+}
+
+void MCTSPlayer::setLeaf(const Connect4& board){
+    leaf_ = NULL;
+    generic_leaf_ = &board;
+}
+
+template <class Board>
+float MCTSPlayer::simulate(const Board& board, char side){
+    // the board is alive until all the threads are done with it
+    setLeaf(board);
+    leaf_side_ = side;
+
+    if (n_threads_ > 1){
+        pthread_mutex_lock(&mutex_);
+        pending_ = n_threads_-1;
+        batch_id_++;
+        pthread_cond_broadcast(&start_cond_);
+        pthread_mutex_unlock(&mutex_);
+    }
+
+    runBatch(workers_[0]);
+    float result = workers_[0].result;
+
+    if (n_threads_ > 1){
+        pthread_mutex_lock(&mutex_);
+        while (pending_ > 0){
+            pthread_cond_wait(&done_cond_, &mutex_);
+        }
+        pthread_mutex_unlock(&mutex_);
+
+        for (int t = 1; t < n_threads_; ++t){
+            result += workers_[t].result;
+        }
+    }
+    return result;
+}
+
+template <class Board>
+bool MCTSPlayer::expand(uint32_t node, const Board& board, char side){
+    int cols = board.getNumCols();
+    int n_children = 0;
+    for (int col = 0; col < cols; ++col){
+        n_children += board.canPlay(col);
+    }
+
+    uint32_t first = arena_.alloc(n_children);
+    if (first == 0){
+        return false;
+    }
+
+    uint32_t child = first;
+    for (int col = 0; col < cols; ++col){
+        if (!board.canPlay(col)){
+            continue;
+        }
+        MCTSNode& c = arena_[child++];
+        c.first_child = 0;
+        c.visits = 0;
+        c.wins = 0;
+        c.move = col;
+        c.n_children = 0;
+        if (board.isWinningMove(col, side)){
+            c.terminal = 1;
+        } else if (board.getNumMoves()+1 == board.getNumRows()*cols){
+            c.terminal = 2;
+        } else {
+            c.terminal = 0;
+        }
+    }
+
+    arena_[node].first_child = first;
+    arena_[node].n_children = n_children;
+    return true;
+}
+
+uint32_t MCTSPlayer::select(uint32_t node){
+    MCTSNode& parent = arena_[node];
+    float log_visits = logf((float) parent.visits);
+    uint32_t best = parent.first_child;
+    float best_value = -1;
+
+    for (uint32_t i = 0; i < parent.n_children; ++i){
+        uint32_t child = parent.first_child + i;
+        MCTSNode& c = arena_[child];
+        if (c.visits == 0){
+            return child;
+        }
+        float value = c.wins/c.visits + UCT_C*sqrtf(log_visits/c.visits);
+        if (value > best_value){
+            best_value = value;
+            best = child;
+        }
+    }
+    return best;
+}
+
+template <class Board>
+int MCTSPlayer::search(const Board& board, char player){
+    if (board.isFull()){
+        return -1;
+    }
+    if (board.getNumCols() > MCTS_MAX_COLS){
+        throw "Board too wide for MCTS";
+    }
+
+    int64_t start = nowMs();
+    int64_t deadline = start + time_budget_ms_;
+
+    arena_.reset();
+    uint32_t root = arena_.alloc(1);
+    arena_[root].first_child = 0;
+    arena_[root].visits = 0;
+    arena_[root].wins = 0;
+    arena_[root].move = -1;
+    arena_[root].n_children = 0;
+    arena_[root].terminal = 0;
+    expand(root, board, player);
+
+    playouts_ = 0;
+    path_.resize(board.getNumRows()*board.getNumCols() + 1);
+    uint32_t* path = &path_[0];
+    Board b = board;
+    while (1){
+        if (max_playouts_ > 0 && playouts_ >= (uint64_t) max_playouts_){
+            break;
+        }
+        if (time_budget_ms_ > 0 && nowMs() >= deadline){
+            break;
+        }
+
+        // selection, b is taken back to the root at the end
+        char side = player;
+        uint32_t node = root;
+        int depth = 0;
+        path[depth++] = node;
+        while (arena_[node].n_children > 0){
+            node = select(node);
+            b.makeMove(arena_[node].move, side);
+            side = other(side);
+            path[depth++] = node;
+        }
+
+        // expansion, on the second visit of a leaf
+        if (!arena_[node].terminal && arena_[node].visits > 0
+                && expand(node, b, side)){
+            node = select(node);
+            b.makeMove(arena_[node].move, side);
+            side = other(side);
+            path[depth++] = node;
+        }
+
+        // simulation
+        float result;
+        uint32_t count;
+        if (arena_[node].terminal){
+            result = arena_[node].terminal == 1 ? 1 : 0.5f;
+            count = 1;
+        } else {
+            result = simulate(b, side);
+            count = batch_size_*n_threads_;
+        }
+        playouts_ += count;
+
+        // backpropagation, alternating the point of view
+        for (int i = depth-1; i >= 0; --i){
+            arena_[path[i]].visits += count;
+            arena_[path[i]].wins += result;
+            result = count - result;
+        }
+
+        while (b.getNumMoves() > board.getNumMoves()){
+            b.undo();
+        }
+    }
+
+    // the most visited move is the most reliable
+    MCTSNode& r = arena_[root];
+    uint32_t best = r.first_child;
+    for (uint32_t i = 1; i < r.n_children; ++i){
+        if (arena_[r.first_child+i].visits > arena_[best].visits){
+            best = r.first_child+i;
+        }
+    }
+
+    last_nodes_ = arena_.getUsed();
+    last_time_ms_ = nowMs() - start;
+    last_value_ = arena_[best].visits > 0 ? arena_[best].wins/arena_[best].visits : 0;
+    LOG(LOG_DEBUG, "MCTS chose column %d (value %.3f, %lu playouts, %u nodes, %d threads)",
+        arena_[best].move, last_value_, (unsigned long) playouts_, last_nodes_,
+        n_threads_);
+    return arena_[best].move;
+}
+
+int MCTSPlayer::chooseMove(const Connect4Bitboard& board, char player){
+    return search(board, player);
+}
+
+int MCTSPlayer::chooseMove(const Connect4& board, char player){
+    if (Connect4Bitboard::fits(board.getNumRows(), board.getNumCols())){
+        return search(Connect4Bitboard(board), player);
+    }
+    return search(board, player);
+}
+
+void MCTSPlayer::printStats(std::ostream& os){
+    os<<"MCTS: "<<playouts_<<" playouts";
+    if (last_time_ms_ > 0){
+        os<<" ("<<playouts_*1000/last_time_ms_<<"/s)";
+    }
+    os<<", "<<last_nodes_<<"/"<<arena_.getCapacity()<<" nodes, win rate "
+      <<last_value_<<", "<<n_threads_<<" threads"<<std::endl;
+}
@@ -0,0 +1,333 @@
+/**
+ * @file mcts_player.h
+ *
+ * @brief Header file for the Monte Carlo Tree Search opponent
+ */
+
+#ifndef MCTS_PLAYER_H
+#define MCTS_PLAYER_H
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include "config.h"
+#include "connect4.h"
+#include "connect4_bitboard.h"
+#include "ai_player.h"
+#include "ai_engine.h"
+
+/**
+ * Node of the search tree.
+ *
+ * Nodes are referenced by their index in the arena, the children of a node
+ * are contiguous.
+ */
+struct MCTSNode {
+    /** Index of the first child, 0 if the node has not been expanded */
+    uint32_t first_child;
+
+    /** Number of playouts through the node */
+    uint32_t visits;
+
+    /**
+     * Sum of the results of the playouts (1 win, 0.5 draw) from the point of
+     * view of the player who made the move leading to the node
+     */
+    float wins;
+
+    /** Column played to reach the node */
+    int8_t move;
+
+    /** Number of children */
+    uint8_t n_children;
+
+    /** The game is over after the move: 1 won, 2 drawn, 0 not over */
+    uint8_t terminal;
+};
+
+/**
+ * Fixed size pool of tree nodes.
+ *
+ * Memory is allocated once when the AI is created and released all at once
+ * at the beginning of every search, so no allocation happens while
+ * searching.
+ */
+class NodeArena {
+    MCTSNode* nodes_;
+    uint32_t capacity_;
+    uint32_t used_;
+
+    /** Non copyable */
+    NodeArena(const NodeArena&);
+    NodeArena& operator=(const NodeArena&);
+
+    public:
+    /**
+     * Allocates the arena, throws if the memory is not available.
+     *
+     * @param capacity  maximum number of nodes
+     */
+    NodeArena(uint32_t capacity);
+    ~NodeArena();
+
+    /**
+     * Allocates n contiguous nodes.
+     *
+     * @return index of the first node, 0 if the arena is full (0 is only
+     *         returned for the first allocation, i.e. the root)
+     */
+    uint32_t alloc(uint32_t n){
+        if (n > capacity_ - used_){
+            return 0;
+        }
+        uint32_t first = used_;
+        used_ += n;
+        return first;
+    }
+
+    /** Releases all the nodes */
+    void reset() { used_ = 0; }
+
+    MCTSNode& operator[](uint32_t i) { return nodes_[i]; }
+
+    /** Returns the number of allocated nodes */
+    uint32_t getUsed() { return used_; }
+
+    uint32_t getCapacity() { return capacity_; }
+};
+
+/**
+ * Opponent that chooses its moves through Monte Carlo Tree Search.
+ *
+ * Every iteration descends the tree choosing the child with the highest UCT
+ * value, expands the reached leaf and runs random playouts from it, then
+ * propagates the results back to the root. The most visited move is played.
+ *
+ * Playouts are run in parallel by a pool of threads that is kept for the
+ * whole life of the AI (leaf parallelization): the tree is only accessed by
+ * the calling thread, each thread of the pool plays a share of the playouts
+ * of every leaf on its own copy of the board.
+ *
+ * The search runs on a Connect4Bitboard when the board fits in it, on the
+ * generic Connect4 otherwise (e.g. 8x9), so any size can be played.
+ */
+class MCTSPlayer : public AIEngine {
+    /**
+     * State private to each playout thread
+     */
+    struct Worker {
+        /** Owner of the worker */
+        MCTSPlayer* ai;
+
+        /** Index of the thread, 0 is the calling one */
+        int id;
+
+        pthread_t thread;
+
+        /** Last batch run by the thread */
+        uint64_t batch_id;
+
+        /** State of the xorshift random generator */
+        uint64_t rng;
+
+        /** Sum of the results of the last batch of playouts */
+        float result;
+    };
+
+    /** Nodes of the tree, index 0 is the root */
+    NodeArena arena_;
+
+    /** Playout threads */
+    Worker workers_[AI_MAX_THREADS];
+    int n_threads_;
+
+    /** Synchronization of the pool */
+    pthread_mutex_t mutex_;
+    pthread_cond_t start_cond_;
+    pthread_cond_t done_cond_;
+
+    /** Incremented at every batch, threads wait for it to change */
+    uint64_t batch_id_;
+
+    /** Number of threads of the pool still running the current batch */
+    int pending_;
+
+    /** Set to terminate the pool */
+    bool quit_;
+
+    /**
+     * Leaf of the current batch and player to move on it: only one of the
+     * two boards is set, depending on the board of the search
+     */
+    const Connect4Bitboard* leaf_;
+    const Connect4* generic_leaf_;
+    char leaf_side_;
+
+    /** Nodes from the root to the current leaf */
+    std::vector<uint32_t> path_;
+
+    /** Playouts per thread of every leaf */
+    int batch_size_;
+
+    /** Maximum number of playouts per move (<= 0 means no limit) */
+    int max_playouts_;
+
+    /** Time budget per move in milliseconds (<= 0 means no limit) */
+    int time_budget_ms_;
+
+    /** Statistics of the last search */
+    uint64_t playouts_;
+    uint32_t last_nodes_;
+    int64_t last_time_ms_;
+    float last_value_;
+
+    /**
+     * Plays a random game from board.
+     *
+     * @param board     starting position, modified
+     * @param side      player to move
+     * @param rng       state of the random generator
+     * @return 1 if the player who moved last on the starting position wins,
+     *         0.5 for a draw and 0 if it loses
+     */
+    template <class Board>
+    static float playout(Board& board, char side, uint64_t* rng);
+
+    /**
+     * Runs batch_size_ playouts from leaf with the generator of worker w.
+     *
+     * @return the sum of the results (see playout())
+     */
+    template <class Board>
+    float runPlayouts(const Board& leaf, Worker& w);
+
+    /**
+     * Runs the playouts of worker w on the current leaf.
+     */
+    void runBatch(Worker& w);
+
+    /**
+     * Entry point of the pool threads.
+     */
+    static void* poolThread(void* arg);
+
+    /** Sets the leaf of the next batch */
+    void setLeaf(const Connect4Bitboard& board);
+    void setLeaf(const Connect4& board);
+
+    /**
+     * Runs batch_size_ playouts per thread from board.
+     *
+     * @return the sum of the results (see playout())
+     */
+    template <class Board>
+    float simulate(const Board& board, char side);
+
+    /**
+     * Creates the children of a node.
+     *
+     * @return false if the arena is full
+     */
+    template <class Board>
+    bool expand(uint32_t node, const Board& board, char side);
+
+    /**
+     * Searches the best move on a Connect4Bitboard or a Connect4.
+     *
+     * Throws if the board has more than MCTS_MAX_COLS columns.
+     */
+    template <class Board>
+    int search(const Board& board, char player);
+
+    /**
+     * Returns the child of node with the highest UCT value.
+     */
+    uint32_t select(uint32_t node);
+
+    /**
+     * Starts the thread pool.
+     */
+    void startPool();
+
+    /**
+     * Stops the thread pool.
+     */
+    void stopPool();
+
+    /** Non copyable */
+    MCTSPlayer(const MCTSPlayer&);
+    MCTSPlayer& operator=(const MCTSPlayer&);
+
+    public:
+    /**
+     * @brief Construct an AI of the given difficulty
+     *
+     * EASY and MEDIUM run MCTS_EASY_PLAYOUTS and MCTS_MEDIUM_PLAYOUTS
+     * playouts per move, HARD and EXPERT search for AI_HARD_TIME_MS and
+     * AI_EXPERT_TIME_MS.
+     *
+     * @param difficulty        difficulty level
+     * @param max_nodes         size of the tree
+     */
+    MCTSPlayer(Difficulty difficulty = HARD, uint32_t max_nodes = MCTS_DEFAULT_NODES);
+
+    /**
+     * @brief Construct an AI with custom limits
+     *
+     * At least one of the limits must be set.
+     *
+     * @param max_playouts      playouts per move (<= 0 means no limit)
+     * @param time_budget_ms    time budget per move (<= 0 means no limit)
+     * @param max_nodes         size of the tree
+     */
+    MCTSPlayer(int max_playouts, int time_budget_ms, uint32_t max_nodes);
+
+    ~MCTSPlayer();
+
+    /**
+     * Chooses the move for the given player.
+     *
+     * @param board     current board
+     * @param player    marker of the player to move
+     * @return the chosen column, -1 if no move is possible
+     */
+    int chooseMove(const Connect4Bitboard& board, char player);
+
+    /**
+     * Chooses the move for the given player on a board of any size.
+     *
+     * The board is copied to a bitboard if it fits, otherwise the search
+     * runs on the generic board, which is several times slower.
+     *
+     * @param board     current board
+     * @param player    marker of the player to move
+     * @return the chosen column, -1 if no move is possible
+     */
+    int chooseMove(const Connect4& board, char player);
+
+    /**
+     * Prints playouts, tree size and estimated win rate of the last search.
+     */
+    void printStats(std::ostream& os);
+
+    /**
+     * Sets the number of playout threads (1 by default).
+     *
+     * @param n_threads     number of threads, at most AI_MAX_THREADS
+     * @return false if the number is not valid
+     */
+    bool setThreads(int n_threads);
+
+    /** Returns the number of playout threads */
+    int getThreads() { return n_threads_; }
+
+    /** Returns the number of playouts of the last search */
+    uint64_t getLastPlayouts() { return playouts_; }
+
+    /** Returns the number of nodes of the tree of the last search */
+    uint32_t getLastNodes() { return last_nodes_; }
+
+    /** Returns the estimated win rate of the chosen move (0 to 1) */
+    float getLastValue() { return last_value_; }
+};
+
+#endif //MCTS_PLAYER_H
@@ -0,0 +1,135 @@
+/**
+ * @file opening_book.cpp
+ *
+ * @brief Implementation of opening_book.h
+ *
+ * @see opening_book.h
+ */
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "opening_book.h"
+#include "logging.h"
+
+using namespace std;
+
+static bool compareEntries(const BookEntry& a, const BookEntry& b){
+    return a.key < b.key;
+}
+
+OpeningBook::OpeningBook()
+        : map_(NULL), map_size_(0), header_(NULL), entries_(NULL) {}
+
+OpeningBook::~OpeningBook(){
+    close();
+}
+
+bool OpeningBook::open(const char* path){
+    struct stat st;
+
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0){
+        LOG_PERROR(LOG_INFO, "Could not open opening book: %s");
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(BookHeader)){
+        LOG(LOG_ERR, "Opening book %s is too short", path);
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the file is closed
+    ::close(fd);
+    if (map == MAP_FAILED){
+        LOG_PERROR(LOG_ERR, "Could not map opening book: %s");
+        return false;
+    }
+
+    const BookHeader* header = (const BookHeader*) map;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0
+            || header->version != BOOK_VERSION
+            || header->n_entries != (st.st_size - sizeof(BookHeader))/sizeof(BookEntry)){
+        LOG(LOG_ERR, "%s is not a valid opening book", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    map_ = map;
+    map_size_ = st.st_size;
+    header_ = header;
+    entries_ = (const BookEntry*) (header + 1);
+
+    LOG(LOG_INFO, "Loaded opening book %s (%dx%d, %d plies, %lu positions)",
+        path, header_->rows, header_->cols, header_->plies,
+        (unsigned long) header_->n_entries);
+    return true;
+}
+
+void OpeningBook::close(){
+    if (map_ != NULL){
+        munmap(map_, map_size_);
+        map_ = NULL;
+        map_size_ = 0;
+        header_ = NULL;
+        entries_ = NULL;
+    }
+}
+
+bool OpeningBook::lookup(const Connect4Bitboard& board, char side, BookEntry* entry) const{
+    if (header_ == NULL
+            || header_->rows != board.getNumRows()
+            || header_->cols != board.getNumCols()
+            || board.getNumMoves() > header_->plies){
+        return false;
+    }
+
+    BookEntry needle;
+    needle.key = board.getKey(side);
+
+    const BookEntry* end = entries_ + header_->n_entries;
+    const BookEntry* it = lower_bound(entries_, end, needle, compareEntries);
+    if (it == end || it->key != needle.key){
+        return false;
+    }
+
+    *entry = *it;
+    return true;
+}
+
+bool OpeningBook::write(const char* path, int rows, int cols, int plies,
+                        vector<BookEntry>& entries){
+    BookHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.version = BOOK_VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.plies = plies;
+    header.n_entries = entries.size();
+
+    sort(entries.begin(), entries.end(), compareEntries);
+
+    FILE* f = fopen(path, "wb");
+    if (f == NULL){
+        LOG_PERROR(LOG_ERR, "Could not create opening book: %s");
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && (entries.empty()
+            || fwrite(&entries[0], sizeof(BookEntry), entries.size(), f) == entries.size());
+
+    if (fclose(f) != 0 || !ok){
+        LOG(LOG_ERR, "Could not write opening book %s", path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file opening_book.h
+ *
+ * @brief Header file for the precomputed opening book of the AI
+ */
+
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+#include "config.h"
+#include "connect4_bitboard.h"
+
+/** First bytes of a book file */
+#define BOOK_MAGIC "C4BOOK\0"
+
+/** Version of the file format */
+#define BOOK_VERSION 1
+
+/**
+ * Header of a book file.
+ *
+ * The file is made of the header followed by n_entries BookEntry sorted by
+ * key. Integers are stored in the byte order of the machine that built the
+ * book.
+ */
+struct BookHeader {
+    char magic[8];
+    uint32_t version;
+    /** Size of the board */
+    uint8_t rows;
+    uint8_t cols;
+    /** Positions with up to plies tokens are in the book */
+    uint8_t plies;
+    uint8_t reserved;
+    uint64_t n_entries;
+};
+
+/**
+ * Move to play in a position.
+ */
+struct BookEntry {
+    /** Key of the position (see Connect4Bitboard::getKey()) */
+    uint64_t key;
+    /** Score of the move from the point of view of the player to move */
+    int32_t score;
+    /** Column to play */
+    int8_t move;
+    /** Depth of the search that chose the move */
+    uint8_t depth;
+    uint16_t reserved;
+};
+
+/**
+ * Read-only opening book mapped in memory.
+ *
+ * The file is mapped with mmap() and entries are looked up with a binary
+ * search directly on the mapping, so opening a book costs no parsing nor
+ * copying and pages are loaded only when needed.
+ */
+class OpeningBook {
+    /** Mapped file, NULL if no book is open */
+    void* map_;
+    size_t map_size_;
+
+    const BookHeader* header_;
+    const BookEntry* entries_;
+
+    /** Non copyable */
+    OpeningBook(const OpeningBook&);
+    OpeningBook& operator=(const OpeningBook&);
+public:
+    OpeningBook();
+    ~OpeningBook();
+
+    /**
+     * Maps a book file in memory, closing the previous one.
+     *
+     * @param path      path of the book file
+     * @return true in case of success, false if the file could not be opened
+     *         or is not a valid book
+     */
+    bool open(const char* path);
+
+    /**
+     * Unmaps the book.
+     */
+    void close();
+
+    /** Returns true if a book is open */
+    bool isOpen() const { return map_ != NULL; }
+
+    /**
+     * Looks up the move to play in a position.
+     *
+     * @param board     current board
+     * @param side      player to move
+     * @param entry     output entry
+     * @return true if the position is in the book
+     */
+    bool lookup(const Connect4Bitboard& board, char side, BookEntry* entry) const;
+
+    /** Returns the number of plies covered by the book */
+    int getPlies() const { return header_ ? header_->plies : 0; }
+
+    /** Returns the number of positions in the book */
+    uint64_t getNumEntries() const { return header_ ? header_->n_entries : 0; }
+
+    /**
+     * Writes a book file.
+     *
+     * @param path      path of the book file
+     * @param rows      rows of the board
+     * @param cols      columns of the board
+     * @param plies     maximum number of tokens of the positions in the book
+     * @param entries   entries of the book, they get sorted by key
+     * @return true in case of success, false otherwise
+     */
+    static bool write(const char* path, int rows, int cols, int plies,
+                      std::vector<BookEntry>& entries);
+};
+
+#endif //OPENING_BOOK_H
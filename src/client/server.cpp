@@ -62,9 +62,9 @@ int Server::registerToServer()
     return ret;
 }
 
-string Server::getUserList()
+string Server::getUserList(bool next)
 {
-    UsersListRequestMessage req_msg;
+    UsersListRequestMessage req_msg(0, next ? list_cursor : "");
 
     if (sw->sendMsg(&req_msg) != 0)
     {
@@ -87,9 +87,13 @@ string Server::getUserList()
     }
 
     if (res_msg == NULL)
+    {
+        connected = false;
         return "";
+    }
 
     string usernames = res_msg->getUsernames();
+    list_cursor = res_msg->getCursor();
     delete res_msg;
 
     return usernames;
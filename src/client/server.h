@@ -24,6 +24,9 @@ private:
     SecureHost host;
     ClientSecureSocketWrapper* sw;
     bool connected;
+
+    /** Cursor of the next page of the list of users, empty if none */
+    string list_cursor;
 public:
     /**
      * Constructor
@@ -57,9 +60,16 @@ public:
      * Returns the list of available users in the server as a comma separated 
      * list.
      * 
+     * @param next  true to get the page following the one of the previous 
+     *              call, if any
      * @return the list of users.
      */
-    string getUserList();
+    string getUserList(bool next=false);
+
+    /**
+     * Returns whether there are more users after the last retrieved page.
+     */
+    bool hasMoreUsers(){return !list_cursor.empty();}
 
     /**
      * Challenges the given peer and wait for a reply.
@@ -31,7 +31,7 @@ using namespace std;
 
 void printAvailableActions(){
     cout<<"You can list users, challenge a user, exit or simply wait for other users to challenge you."<< endl;
-    cout<<"To list users type: `list`"<< endl;
+    cout<<"To list users type: `list` (`list more` for the next page)"<< endl;
     cout<<"To challenge a user type: `challenge username`"<< endl;
     cout<<"To disconnect type: `exit`"<< endl;
     cout<<"NB: you cannot receive challenges if you are challenging another user"<< endl;
@@ -41,13 +41,22 @@ int doAction(Args args, Server *server, SecureHost* peer_host){
     LOG(LOG_DEBUG, "Args: %s", args.c_str());
     if (args.getArgc() == 1 && strcmp(args.getArgv(0), "exit") == 0){
         return -2;
-    } else if (args.getArgc() == 1 && strcmp(args.getArgv(0), "list") == 0){
+    } else if ((args.getArgc() == 1 && strcmp(args.getArgv(0), "list") == 0)
+            || (args.getArgc() == 2 && strcmp(args.getArgv(0), "list") == 0
+                && strcmp(args.getArgv(1), "more") == 0)){
         cout<<"Retrieving the list of users..."<<endl;
-        string userlist = server->getUserList();
+        string userlist = server->getUserList(args.getArgc() == 2);
         if (userlist.empty()){
-            return 1;
+            if (!server->isConnected()){
+                return 1;
+            }
+            cout<<"No available users"<<endl;
+            return 0;
         }
         cout<<"Online users: "<<userlist<<endl;
+        if (server->hasMoreUsers()){
+            cout<<"Type `list more` for more users"<<endl;
+        }
         return 0;
     } else if (args.getArgc() == 2 && strcmp(args.getArgv(0), "challenge") == 0){
         cout<<"Sending challenge to "<<args.getArgv(1)<<" and waiting for response..."<<endl;
@@ -10,15 +10,114 @@
 
 #include "single_player.h"
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "utils/args.h"
-#include "connect4.h"
+#include "connect4_bitboard.h"
+#include "ai_player.h"
+#include "mcts_player.h"
+#include "opening_book.h"
+#include "solver.h"
 
 using namespace std;
 
-int playSinglePlayer(){
+bool parseSinglePlayerOptions(Args& args, struct SinglePlayerOptions* options){
+    options->difficulty = HARD;
+    options->hash_mb = AI_DEFAULT_HASH_MB;
+    options->threads = 1;
+    options->stats = false;
+    options->engine = ENGINE_ALPHABETA;
+    options->playouts = 0;
+    options->time_ms = 0;
+    strcpy(options->book_path, AI_DEFAULT_BOOK);
+
+    for (int i = 1; i < args.getArgc(); ++i){
+        if (strcmp(args.getArgv(i), "--hash") == 0 && i+1 < args.getArgc()){
+            options->hash_mb = atoi(args.getArgv(++i));
+            if (options->hash_mb <= 0){
+                return false;
+            }
+        } else if (strcmp(args.getArgv(i), "--threads") == 0 && i+1 < args.getArgc()){
+            options->threads = atoi(args.getArgv(++i));
+            if (options->threads <= 0 || options->threads > AI_MAX_THREADS){
+                return false;
+            }
+        } else if (strcmp(args.getArgv(i), "--book") == 0 && i+1 < args.getArgc()){
+            const char* path = args.getArgv(++i);
+            if (strlen(path) >= sizeof(options->book_path)){
+                return false;
+            }
+            strcpy(options->book_path, path);
+        } else if (strcmp(args.getArgv(i), "--no-book") == 0){
+            options->book_path[0] = '\0';
+        } else if (strcmp(args.getArgv(i), "--stats") == 0){
+            options->stats = true;
+        } else if (strcmp(args.getArgv(i), "--engine") == 0 && i+1 < args.getArgc()){
+            const char* engine = args.getArgv(++i);
+            if (strcmp(engine, "alphabeta") == 0){
+                options->engine = ENGINE_ALPHABETA;
+            } else if (strcmp(engine, "mcts") == 0){
+                options->engine = ENGINE_MCTS;
+            } else {
+                return false;
+            }
+        } else if (strcmp(args.getArgv(i), "--playouts") == 0 && i+1 < args.getArgc()){
+            options->playouts = atoi(args.getArgv(++i));
+            if (options->playouts <= 0){
+                return false;
+            }
+        } else if (strcmp(args.getArgv(i), "--time") == 0 && i+1 < args.getArgc()){
+            options->time_ms = atoi(args.getArgv(++i));
+            if (options->time_ms <= 0){
+                return false;
+            }
+        } else if (!parseDifficulty(args.getArgv(i), &options->difficulty)){
+            return false;
+        }
+    }
+    return true;
+}
+
+int solvePosition(const char* moves){
+    Connect4Bitboard c;
+    char side;
+
+    if (!Solver::playSequence(moves, &c, &side)){
+        cout<<"Invalid position: "<<moves<<endl;
+        return 1;
+    }
+
+    Solver solver;
+    int score;
+    int col = solver.bestMove(c, side, &score);
+
+    cout<<c;
+    if (col == -1){
+        cout<<"The board is full: it is a draw"<<endl;
+        return 0;
+    }
+
+    cout<<side<<" to move, score "<<score;
+    if (score > 0){
+        cout<<" ("<<side<<" wins)";
+    } else if (score < 0){
+        cout<<" ("<<side<<" loses)";
+    } else {
+        cout<<" (draw)";
+    }
+    cout<<", best column "<<col+1<<" ("<<solver.getNodes()<<" nodes)"<<endl;
+    return 0;
+}
+
+/**
+ * Plays a game against the given AI.
+ *
+ * @return 0 when the game ends, 1 if the input is closed
+ */
+static int playGame(AIEngine& ai, struct SinglePlayerOptions& options){
     int choosen_col, adv_col;
     int win;
-    Connect4 c;
+    Connect4Bitboard c;
 
     cout<<"Who do you want to be? X or O ?"<<endl;
 
@@ -34,13 +133,12 @@ int playSinglePlayer(){
         }
     } while (1);
 
-    cout<<"You are playing as "<<c.getPlayer()<<endl;
+    cout<<"You are playing as "<<c.getPlayer()<<" against a "
+        <<difficultyName(options.difficulty)<<" opponent"<<endl;
 
     cout<<"This is the starting board:"<<endl;
     cout<<c;
 
-    srand(time(NULL));
-
     do {
         cout<<"Write the column you want to insert the token to"<<endl;
         do {
@@ -68,22 +166,48 @@ int playSinglePlayer(){
         }
 
         if(win != 1){
-            do {
-                adv_col = rand()%c.getNumCols();
-                cout<<"Your enemy has chosen column "<<adv_col<<endl;
-                win = c.play(adv_col, c.getAdv());
-                cout<<c;
-                if(win == 1){
-                    cout<<"Damn! You lost!"<<endl;
-                } else if(win == -1){
-                    cout<<"The column is full, the adversary has to chose a different one!"<<endl;
-                    continue;
-                } else if(win == -2){
-                    cout<<"The entire board is filled: it is a draw!"<<endl;
-                    break;
-                }
-            } while (win == -1);
+            // the AI never chooses a full column
+            adv_col = ai.chooseMove(c, c.getAdv());
+            cout<<"Your enemy has chosen column "<<adv_col+1<<endl;
+            if (options.stats){
+                ai.printStats(cout);
+            }
+            win = c.play(adv_col, c.getAdv());
+            cout<<c;
+            if(win == 1){
+                cout<<"Damn! You lost!"<<endl;
+            } else if(win == -2){
+                cout<<"The entire board is filled: it is a draw!"<<endl;
+                break;
+            }
         }
     } while (win == -1 || win == 0);
     return 0;
-}
\ No newline at end of file
+}
+
+int playSinglePlayer(struct SinglePlayerOptions options){
+    OpeningBook book;
+    int ret;
+
+    if (options.engine == ENGINE_MCTS){
+        MCTSPlayer* mcts;
+        if (options.playouts > 0 || options.time_ms > 0){
+            mcts = new MCTSPlayer(options.playouts, options.time_ms, MCTS_DEFAULT_NODES);
+        } else {
+            mcts = new MCTSPlayer(options.difficulty);
+        }
+        mcts->setThreads(options.threads);
+        ret = playGame(*mcts, options);
+        delete mcts;
+    } else {
+        AIPlayer* ai = new AIPlayer(options.difficulty, options.hash_mb);
+        ai->setThreads(options.threads);
+        if (options.book_path[0] != '\0' && book.open(options.book_path)){
+            ai->setBook(&book);
+        }
+        ai->getTable().setStatsEnabled(options.stats);
+        ret = playGame(*ai, options);
+        delete ai;
+    }
+    return ret;
+}
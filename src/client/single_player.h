@@ -10,9 +10,71 @@
 #ifndef SINGLE_PLAYER_H
 #define SINGLE_PLAYER_H
 
+#include "ai_player.h"
+#include "utils/args.h"
+
+/**
+ * Search algorithms of the AI opponent
+ */
+enum AIEngineType {ENGINE_ALPHABETA, ENGINE_MCTS};
+
+/**
+ * Options of a single player game
+ */
+struct SinglePlayerOptions {
+    /** Difficulty of the AI opponent */
+    enum Difficulty difficulty;
+
+    /** Size of the transposition table in MiB */
+    int hash_mb;
+
+    /** Number of search threads */
+    int threads;
+
+    /** Path of the opening book, empty to disable it */
+    char book_path[256];
+
+    /** Print the statistics of every search */
+    bool stats;
+
+    /** Search algorithm of the AI opponent */
+    enum AIEngineType engine;
+
+    /** Playouts per move of the MCTS opponent (0: set by the difficulty) */
+    int playouts;
+
+    /** Time budget per move of the MCTS opponent (0: set by the difficulty) */
+    int time_ms;
+};
+
+/**
+ * Parses the options of a single player game from the arguments of the 
+ * `offline` command.
+ * 
+ * Format: offline [easy|medium|hard|expert] [--hash MB] [--threads N]
+ *                                                  [--book FILE|--no-book] [--stats]
+ *                  [--engine alphabeta|mcts] [--playouts N] [--time MS]
+ *
+ * --playouts and --time only apply to the MCTS engine and replace the limits
+ * of the difficulty level.
+ * 
+ * @param args      the arguments (including `offline`)
+ * @param options   output options
+ * @return true in case of success, false if the arguments are not valid
+ */
+bool parseSinglePlayerOptions(Args& args, struct SinglePlayerOptions* options);
+
+/**
+ * Solves a position and prints its score and best move.
+ *
+ * @param moves     the position as a sequence of moves (e.g. "4453")
+ * @return 0 in case of success, 1 if the position is not valid
+ */
+int solvePosition(const char* moves);
+
 /**
- * Starts a game against a random-playing opponent
+ * Starts a game against an AI opponent
  */
-int playSinglePlayer();
+int playSinglePlayer(struct SinglePlayerOptions options);
 
-#endif // SINGLE_PLAYER_H
\ No newline at end of file
+#endif // SINGLE_PLAYER_H
@@ -0,0 +1,241 @@
+/**
+ * @file solver.cpp
+ *
+ * @brief Implementation of solver.h
+ *
+ * @see solver.h
+ */
+#include "solver.h"
+
+static char other(char player){
+    return player == 'X' ? 'O' : 'X';
+}
+
+Solver::Solver(size_t hash_mb /* = SOLVER_DEFAULT_HASH_MB */)
+        : tt_(hash_mb), nodes_(0) {}
+
+void Solver::prepare(const Connect4Bitboard& board){
+    // keys do not depend on the size of the board: scores of other sizes
+    // must be thrown away
+    if (board.getNumRows() != board_.getNumRows()
+            || board.getNumCols() != board_.getNumCols()){
+        tt_.clear();
+    }
+    board_ = board;
+
+    // center first: e.g. 3 2 4 1 5 0 6 for 7 columns, 2 3 1 4 0 5 for 6
+    int cols = board.getNumCols();
+    for (int i = 0; i < cols; ++i){
+        int offset = (1-2*(i%2))*(i+1)/2;
+        order_[i] = cols%2 == 1 ? cols/2 + offset : cols/2 - 1 - offset;
+    }
+}
+
+bool Solver::canWinNext(char side){
+    return board_.getPlayableCells() & board_.winningCells(board_.getTokens(side));
+}
+
+bitboard_t Solver::nonLosingMoves(char side){
+    bitboard_t possible = board_.getPlayableCells();
+    bitboard_t opponent_win = board_.winningCells(board_.getTokens(other(side)));
+    bitboard_t forced = possible & opponent_win;
+
+    if (forced){
+        // the opponent has two winning moves: cannot block both
+        if (forced & (forced-1)){
+            return 0;
+        }
+        possible = forced;
+    }
+
+    // never play right below a winning cell of the opponent
+    return possible & ~(opponent_win >> 1);
+}
+
+int Solver::negamax(char side, int alpha, int beta){
+    int size = board_.getNumRows()*board_.getNumCols();
+    int moves = board_.getNumMoves();
+
+    nodes_++;
+
+    bitboard_t next = nonLosingMoves(side);
+    if (next == 0){
+        // the opponent wins with its next move
+        return -(size - moves)/2;
+    }
+
+    if (moves >= size-2){
+        return 0;
+    }
+
+    // the opponent cannot win with its next move
+    int min = -(size-2-moves)/2;
+    if (alpha < min){
+        alpha = min;
+        if (alpha >= beta){
+            return alpha;
+        }
+    }
+
+    // side cannot win with its next move
+    int max = (size-1-moves)/2;
+    if (beta > max){
+        beta = max;
+        if (alpha >= beta){
+            return beta;
+        }
+    }
+
+    uint64_t key = board_.getKey(side);
+    TTResult entry;
+    if (tt_.probe(key, &entry)){
+        if (entry.bound == TT_LOWER && alpha < entry.score){
+            alpha = entry.score;
+            if (alpha >= beta){
+                return alpha;
+            }
+        } else if (entry.bound == TT_UPPER && beta > entry.score){
+            beta = entry.score;
+            if (alpha >= beta){
+                return beta;
+            }
+        }
+    }
+
+    // sort the moves by the number of threats they create, center first
+    // among the ones with the same number
+    int cols[64];
+    int threats[64];
+    int n = 0;
+    bitboard_t tokens = board_.getTokens(side);
+    for (int i = 0; i < board_.getNumCols(); ++i){
+        int col = order_[i];
+        bitboard_t move = next & board_.getColumnMask(col);
+        if (move){
+            int t = __builtin_popcountll(board_.winningCells(tokens | move));
+            int j = n++;
+            while (j > 0 && threats[j-1] < t){
+                cols[j] = cols[j-1];
+                threats[j] = threats[j-1];
+                j--;
+            }
+            cols[j] = col;
+            threats[j] = t;
+        }
+    }
+
+    for (int i = 0; i < n; ++i){
+        board_.makeMove(cols[i], side);
+        int score = -negamax(other(side), -beta, -alpha);
+        board_.undo();
+
+        if (score >= beta){
+            tt_.store(key, score, size-moves, cols[i], TT_LOWER);
+            return score;
+        }
+        if (score > alpha){
+            alpha = score;
+        }
+    }
+
+    tt_.store(key, alpha, size-moves, -1, TT_UPPER);
+    return alpha;
+}
+
+int Solver::solveCurrent(char side, bool weak){
+    int size = board_.getNumRows()*board_.getNumCols();
+    int moves = board_.getNumMoves();
+
+    if (canWinNext(side)){
+        return weak ? 1 : (size+1-moves)/2;
+    }
+
+    int min = -(size-moves)/2;
+    int max = (size+1-moves)/2;
+    if (weak){
+        min = -1;
+        max = 1;
+    }
+
+    // binary search of the score with null windows, first checking whether
+    // the position is won or lost
+    while (min < max){
+        int med = min + (max-min)/2;
+        if (med <= 0 && min/2 < med){
+            med = min/2;
+        } else if (med >= 0 && max/2 > med){
+            med = max/2;
+        }
+        int r = negamax(side, med, med+1);
+        if (r <= med){
+            max = r;
+        } else {
+            min = r;
+        }
+    }
+
+    if (weak){
+        // the bounds returned by the search may be beyond [-1, 1]
+        return min > 0 ? 1 : min < 0 ? -1 : 0;
+    }
+    return min;
+}
+
+int Solver::solve(const Connect4Bitboard& board, char side, bool weak /* = false */){
+    prepare(board);
+    return solveCurrent(side, weak);
+}
+
+int Solver::bestMove(const Connect4Bitboard& board, char side, int* score /* = NULL */){
+    int size = board.getNumRows()*board.getNumCols();
+    int best_move = -1;
+
+    prepare(board);
+    int target = solveCurrent(side, false);
+
+    // only checks that each move reaches the score of the position: a single
+    // null window search each, instead of solving every move
+    for (int i = 0; i < board_.getNumCols() && best_move == -1; ++i){
+        int col = order_[i];
+        if (!board_.canPlay(col)){
+            continue;
+        }
+
+        bool best;
+        if (board_.isWinningMove(col, side)){
+            best = (size+1-board_.getNumMoves())/2 >= target;
+        } else {
+            board_.makeMove(col, side);
+            if (board_.isFull()){
+                best = target <= 0;
+            } else if (canWinNext(other(side))){
+                best = -(size+1-board_.getNumMoves())/2 >= target;
+            } else {
+                best = -negamax(other(side), -target, -target+1) >= target;
+            }
+            board_.undo();
+        }
+
+        if (best){
+            best_move = col;
+        }
+    }
+
+    if (score != NULL){
+        *score = target;
+    }
+    return best_move;
+}
+
+bool Solver::playSequence(const char* moves, Connect4Bitboard* board, char* side){
+    *side = 'X';
+    for (const char* c = moves; *c != '\0'; ++c){
+        int col = *c - '1';
+        if (!board->canPlay(col) || board->isWinningMove(col, *side)){
+            return false;
+        }
+        board->makeMove(col, *side);
+        *side = other(*side);
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file solver.h
+ *
+ * @brief Header file for the perfect play solver
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+#include <stdint.h>
+#include "config.h"
+#include "connect4_bitboard.h"
+#include "transposition_table.h"
+
+/**
+ * Computes the exact game-theoretic value of a position.
+ *
+ * The score of a position is positive if the player to move wins, negative
+ * if it loses and 0 in case of draw. Its absolute value is the number of
+ * empty cells the winner still has when the game ends, plus one: e.g. winning
+ * with the last token of the board scores 1 and winning as soon as possible
+ * scores (rows*cols+1)/2 - 3.
+ *
+ * The search is a negamax with alpha-beta pruning run with null windows
+ * inside a binary search on the score. Moves that let the opponent win
+ * immediately are never explored, and the others are sorted by the number of
+ * threats they create. Bounds are stored in a transposition table which is
+ * kept between searches, since scores do not depend on the search.
+ */
+class Solver {
+    /** Board used during the search */
+    Connect4Bitboard board_;
+
+    /** Bounds on the score of the positions already explored */
+    TranspositionTable tt_;
+
+    /** Order in which the columns are explored (center first) */
+    int order_[64];
+
+    /** Nodes visited since the last reset */
+    uint64_t nodes_;
+
+    /**
+     * Null window capable negamax search.
+     *
+     * The player to move must not be able to win with the next move.
+     *
+     * @param side      player to move
+     * @param alpha     lower bound of the window
+     * @param beta      upper bound of the window
+     * @return the score if it is in the window, a bound otherwise
+     */
+    int negamax(char side, int alpha, int beta);
+
+    /**
+     * Solves the position on board_.
+     */
+    int solveCurrent(char side, bool weak);
+
+    /**
+     * Returns the playable cells that do not let the opponent win with the
+     * next move.
+     */
+    bitboard_t nonLosingMoves(char side);
+
+    /**
+     * Returns true if side can win with the next move.
+     */
+    bool canWinNext(char side);
+
+    /**
+     * Copies the board and prepares the move ordering.
+     */
+    void prepare(const Connect4Bitboard& board);
+
+public:
+    /**
+     * @brief Constructs a solver
+     *
+     * @param hash_mb   size of the transposition table in MiB
+     */
+    Solver(size_t hash_mb = SOLVER_DEFAULT_HASH_MB);
+
+    /**
+     * Computes the score of a position.
+     *
+     * @param board     position to solve, the game must not be over
+     * @param side      player to move
+     * @param weak      only compute whether the position is won (1), lost
+     *                  (-1) or drawn (0), which is faster
+     * @return the score of the position for side
+     */
+    int solve(const Connect4Bitboard& board, char side, bool weak = false);
+
+    /**
+     * Computes the best move of a position and its score.
+     *
+     * Among the moves with the best score the most central one is chosen.
+     *
+     * @param board     position to solve, the game must not be over
+     * @param side      player to move
+     * @param score     output score of the position (may be NULL)
+     * @return the best column, -1 if the board is full
+     */
+    int bestMove(const Connect4Bitboard& board, char side, int* score = NULL);
+
+    /** Returns the number of nodes visited since the last reset */
+    uint64_t getNodes() { return nodes_; }
+
+    /** Resets the node counter */
+    void resetNodes() { nodes_ = 0; }
+
+    /** Clears the transposition table */
+    void reset() { tt_.clear(); }
+
+    /**
+     * Builds a position from a sequence of moves.
+     *
+     * Moves are columns numbered from 1, X moves first (e.g. "4453").
+     *
+     * @param moves     sequence of moves
+     * @param board     output board, it must be empty
+     * @param side      output player to move
+     * @return false if the sequence is invalid, contains a full column or a
+     *         move that ends the game
+     */
+    static bool playSequence(const char* moves, Connect4Bitboard* board, char* side);
+};
+
+#endif //SOLVER_H
@@ -0,0 +1,129 @@
+/**
+ * @file transposition_table.cpp
+ *
+ * @brief Implementation of transposition_table.h
+ *
+ * @see transposition_table.h
+ */
+#include <cstdlib>
+#include <cstring>
+#include "transposition_table.h"
+#include "logging.h"
+
+#define SCORE(data)  ((int) (int32_t) (uint32_t) (data))
+#define DEPTH(data)  ((int) (uint8_t) ((data) >> 32))
+#define MOVE(data)   ((int) (int8_t) ((data) >> 40))
+#define BOUND(data)  ((TTBound) (uint8_t) ((data) >> 48))
+#define GEN(data)    ((uint8_t) ((data) >> 56))
+
+/** Entries are accessed concurrently: only atomicity of each word matters */
+#define LOAD(x)      __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define STORE(x, v)  __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define COUNT(x)     __atomic_fetch_add(&(x), 1, __ATOMIC_RELAXED)
+
+uint64_t TranspositionTable::pack(int score, int depth, int move, TTBound bound, uint8_t gen){
+    return (uint64_t) (uint32_t) score
+         | (uint64_t) (uint8_t) depth << 32
+         | (uint64_t) (uint8_t) (int8_t) move << 40
+         | (uint64_t) (uint8_t) bound << 48
+         | (uint64_t) gen << 56;
+}
+
+TranspositionTable::TranspositionTable(size_t size_mb /* = AI_DEFAULT_HASH_MB */)
+        : buckets_(NULL), n_buckets_(0), stats_enabled_(false) {
+    if (!resize(size_mb)){
+        throw "Could not allocate the transposition table";
+    }
+}
+
+TranspositionTable::~TranspositionTable(){
+    free(buckets_);
+}
+
+bool TranspositionTable::resize(size_t size_mb){
+    uint64_t n = ((uint64_t) size_mb << 20) / sizeof(Bucket);
+    if (n == 0){
+        n = 1;
+    }
+    // round down to a power of 2 so that the index is just a mask
+    while (n & (n-1)){
+        n &= n-1;
+    }
+
+    void* mem = NULL;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, n*sizeof(Bucket)) != 0){
+        LOG(LOG_ERR, "Could not allocate a %lu MiB transposition table",
+            (unsigned long) size_mb);
+        return false;
+    }
+
+    free(buckets_);
+    buckets_ = (Bucket*) mem;
+    n_buckets_ = n;
+    clear();
+
+    LOG(LOG_DEBUG, "Transposition table of %lu buckets (%lu bytes)",
+        (unsigned long) n_buckets_, (unsigned long) getSize());
+    return true;
+}
+
+void TranspositionTable::clear(){
+    memset(buckets_, 0, n_buckets_*sizeof(Bucket));
+    generation_ = 0;
+    hits_ = 0;
+    misses_ = 0;
+    collisions_ = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTResult* result){
+    Bucket* b = bucketOf(key);
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i){
+        uint64_t data = LOAD(b->entries[i].data);
+        if ((LOAD(b->entries[i].key) ^ data) == key && BOUND(data) != TT_NONE){
+            result->score = SCORE(data);
+            result->depth = DEPTH(data);
+            result->move = MOVE(data);
+            result->bound = BOUND(data);
+            if (stats_enabled_){
+                COUNT(hits_);
+            }
+            return true;
+        }
+    }
+    if (stats_enabled_){
+        COUNT(misses_);
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, int score, int depth, int move, TTBound bound){
+    Bucket* b = bucketOf(key);
+    Entry* victim = NULL;
+    int victim_value = 0;
+    bool replaced = false;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i){
+        Entry* e = &b->entries[i];
+        uint64_t e_data = LOAD(e->data);
+        if (BOUND(e_data) == TT_NONE || (LOAD(e->key) ^ e_data) == key){
+            victim = e;
+            replaced = false;
+            break;
+        }
+        // replace the shallowest entry, entries of old searches first
+        int value = DEPTH(e_data) + (GEN(e_data) == generation_ ? 256 : 0);
+        if (victim == NULL || value < victim_value){
+            victim = e;
+            victim_value = value;
+            replaced = true;
+        }
+    }
+
+    if (stats_enabled_ && replaced){
+        COUNT(collisions_);
+    }
+
+    uint64_t data = pack(score, depth, move, bound, generation_);
+    STORE(victim->key, key ^ data);
+    STORE(victim->data, data);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file transposition_table.h
+ *
+ * @brief Header file for the transposition table used by the AI search
+ */
+
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+#include <stdint.h>
+#include <cstddef>
+#include "config.h"
+
+/** Size of a cache line, buckets are aligned to it */
+#define CACHE_LINE_SIZE 64
+
+/** Number of entries sharing the same cache line */
+#define TT_BUCKET_SIZE 4
+
+/**
+ * Type of bound stored in an entry.
+ *
+ * TT_EXACT: the score is the exact value of the position.
+ * TT_LOWER: the real value is at least the score (fail high).
+ * TT_UPPER: the real value is at most the score (fail low).
+ */
+enum TTBound {TT_NONE, TT_EXACT, TT_LOWER, TT_UPPER};
+
+/**
+ * Result of a lookup in the transposition table.
+ */
+struct TTResult {
+    int score;
+    int depth;
+    int move;
+    enum TTBound bound;
+};
+
+/**
+ * Fixed-size hash table of search results indexed by position hash.
+ *
+ * The table is an array of buckets as big as a cache line, so a lookup
+ * touches a single line of memory. Each entry stores the full 64-bit key,
+ * the score, its bound, the search depth and the best move. When a bucket is
+ * full the shallowest entry (preferring the ones of older searches) is
+ * replaced.
+ *
+ * The table can be shared by several search threads without locks: the key is
+ * stored xored with the data, so an entry torn by two concurrent stores does
+ * not match any key and is simply treated as a miss.
+ *
+ * Counters of hits, misses and collisions can be enabled at runtime:
+ *  - hit: the position was found;
+ *  - miss: the position was not found;
+ *  - collision: a store replaced a different position.
+ */
+class TranspositionTable {
+    struct Entry {
+        /** key ^ data */
+        uint64_t key;
+        /** score (32 bits), depth (8), move (8), bound (8), generation (8) */
+        uint64_t data;
+    };
+
+    struct Bucket {
+        Entry entries[TT_BUCKET_SIZE];
+    } __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    Bucket* buckets_;
+    uint64_t n_buckets_;
+
+    /** Incremented at every new search, used to age entries */
+    uint8_t generation_;
+
+    bool stats_enabled_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t collisions_;
+
+    static uint64_t pack(int score, int depth, int move, TTBound bound, uint8_t gen);
+
+    Bucket* bucketOf(uint64_t key) { return &buckets_[key & (n_buckets_-1)]; }
+
+    /** Non copyable */
+    TranspositionTable(const TranspositionTable&);
+    TranspositionTable& operator=(const TranspositionTable&);
+public:
+    /**
+     * @brief Allocates a table of (at most) the given size
+     *
+     * @param size_mb   size of the table in MiB, rounded down to a power of 2
+     */
+    TranspositionTable(size_t size_mb = AI_DEFAULT_HASH_MB);
+
+    ~TranspositionTable();
+
+    /**
+     * Reallocates the table with a new size, clearing it.
+     *
+     * @param size_mb   size of the table in MiB, rounded down to a power of 2
+     * @return true in case of success, false if memory could not be allocated
+     */
+    bool resize(size_t size_mb);
+
+    /**
+     * Removes all the entries and resets the counters.
+     */
+    void clear();
+
+    /**
+     * Marks the beginning of a new search, older entries will be replaced
+     * first. It must not be called while a search is running.
+     */
+    void newSearch() { generation_++; }
+
+    /**
+     * Looks up a position.
+     *
+     * @param key       hash of the position
+     * @param result    output entry
+     * @return true if the position was found
+     */
+    bool probe(uint64_t key, TTResult* result);
+
+    /**
+     * Stores the result of the search of a position.
+     *
+     * @param key       hash of the position
+     * @param score     score of the position
+     * @param depth     depth of the search
+     * @param move      best move found (-1 if none)
+     * @param bound     type of bound of the score
+     */
+    void store(uint64_t key, int score, int depth, int move, TTBound bound);
+
+    /** Enables or disables the hit/miss/collision counters */
+    void setStatsEnabled(bool enabled) { stats_enabled_ = enabled; }
+
+    /** Returns the size of the table in bytes */
+    size_t getSize() { return n_buckets_*sizeof(Bucket); }
+
+    uint64_t getHits() { return hits_; }
+    uint64_t getMisses() { return misses_; }
+    uint64_t getCollisions() { return collisions_; }
+};
+
+#endif //TRANSPOSITION_TABLE_H
@@ -0,0 +1,178 @@
+/**
+ * @file win_batch.cpp
+ *
+ * @brief Implementation of win_batch.h
+ *
+ * @see win_batch.h
+ */
+#include "win_batch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WIN_BATCH_X86
+#include <immintrin.h>
+#endif
+
+/** Boards gathered at once by checkWinBatch() */
+#define GATHER_SIZE 256
+
+/**
+ * Checks a single bitboard: shifting by one, height, height-1 and height+1
+ * moves the tokens along a column, a row and the two diagonals.
+ */
+static inline bool hasAlignmentScalar(bitboard_t t, int height){
+    int shifts[] = {1, height, height-1, height+1};
+    bitboard_t any = 0;
+    for (int d = 0; d < 4; ++d){
+        bitboard_t run = t;
+        for (int k = 1; k < N_IN_A_ROW; ++k){
+            run &= t >> (k*shifts[d]);
+        }
+        any |= run;
+    }
+    return any != 0;
+}
+
+static void batchScalar(const bitboard_t* tokens, size_t n, int height, uint8_t* results){
+    for (size_t i = 0; i < n; ++i){
+        results[i] = hasAlignmentScalar(tokens[i], height);
+    }
+}
+
+#ifdef WIN_BATCH_X86
+
+static size_t batchSSE2(const bitboard_t* tokens, size_t n, int height, uint8_t* results){
+    int shifts[] = {1, height, height-1, height+1};
+    __m128i counts[4][N_IN_A_ROW];
+    for (int d = 0; d < 4; ++d){
+        for (int k = 1; k < N_IN_A_ROW; ++k){
+            counts[d][k] = _mm_cvtsi32_si128(k*shifts[d]);
+        }
+    }
+
+    size_t i;
+    for (i = 0; i+2 <= n; i += 2){
+        __m128i t = _mm_loadu_si128((const __m128i*) &tokens[i]);
+        __m128i any = _mm_setzero_si128();
+        for (int d = 0; d < 4; ++d){
+            __m128i run = t;
+            for (int k = 1; k < N_IN_A_ROW; ++k){
+                run = _mm_and_si128(run, _mm_srl_epi64(t, counts[d][k]));
+            }
+            any = _mm_or_si128(any, run);
+        }
+        // SSE2 has no 64 bits comparison: a lane is zero if both halves are
+        __m128i zero = _mm_cmpeq_epi32(any, _mm_setzero_si128());
+        zero = _mm_and_si128(zero, _mm_shuffle_epi32(zero, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(zero));
+        results[i] = !(mask & 1);
+        results[i+1] = !(mask & 2);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t batchAVX2(const bitboard_t* tokens, size_t n, int height, uint8_t* results){
+    int shifts[] = {1, height, height-1, height+1};
+    __m128i counts[4][N_IN_A_ROW];
+    for (int d = 0; d < 4; ++d){
+        for (int k = 1; k < N_IN_A_ROW; ++k){
+            counts[d][k] = _mm_cvtsi32_si128(k*shifts[d]);
+        }
+    }
+
+    size_t i;
+    for (i = 0; i+4 <= n; i += 4){
+        __m256i t = _mm256_loadu_si256((const __m256i*) &tokens[i]);
+        __m256i any = _mm256_setzero_si256();
+        for (int d = 0; d < 4; ++d){
+            __m256i run = t;
+            for (int k = 1; k < N_IN_A_ROW; ++k){
+                run = _mm256_and_si256(run, _mm256_srl_epi64(t, counts[d][k]));
+            }
+            any = _mm256_or_si256(any, run);
+        }
+        __m256i zero = _mm256_cmpeq_epi64(any, _mm256_setzero_si256());
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(zero));
+        results[i] = !(mask & 1);
+        results[i+1] = !(mask & 2);
+        results[i+2] = !(mask & 4);
+        results[i+3] = !(mask & 8);
+    }
+    return i;
+}
+
+#endif //WIN_BATCH_X86
+
+bool winBatchSupported(enum WinBatchImpl impl){
+    switch (impl){
+        case WIN_BATCH_AUTO:
+        case WIN_BATCH_SCALAR:
+            return true;
+#ifdef WIN_BATCH_X86
+        case WIN_BATCH_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case WIN_BATCH_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* winBatchName(enum WinBatchImpl impl){
+    switch (impl){
+        case WIN_BATCH_AUTO:
+            return "auto";
+        case WIN_BATCH_SCALAR:
+            return "scalar";
+        case WIN_BATCH_SSE2:
+            return "sse2";
+        case WIN_BATCH_AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+void hasAlignmentBatch(const bitboard_t* tokens, size_t n, int rows,
+                       uint8_t* results, enum WinBatchImpl impl /* = WIN_BATCH_AUTO */){
+    int height = rows+1;
+    size_t done = 0;
+
+    if (impl == WIN_BATCH_AUTO){
+        static const enum WinBatchImpl best =
+            winBatchSupported(WIN_BATCH_AVX2) ? WIN_BATCH_AVX2
+            : winBatchSupported(WIN_BATCH_SSE2) ? WIN_BATCH_SSE2
+            : WIN_BATCH_SCALAR;
+        impl = best;
+    }
+
+#ifdef WIN_BATCH_X86
+    if (impl == WIN_BATCH_AVX2){
+        done = batchAVX2(tokens, n, height, results);
+    } else if (impl == WIN_BATCH_SSE2){
+        done = batchSSE2(tokens, n, height, results);
+    }
+#endif
+
+    // boards left over by the vectorized loops
+    batchScalar(tokens+done, n-done, height, results+done);
+}
+
+void checkWinBatch(const Connect4Bitboard* boards, size_t n, char player,
+                   uint8_t* results, enum WinBatchImpl impl /* = WIN_BATCH_AUTO */){
+    bitboard_t tokens[GATHER_SIZE];
+
+    if (n == 0){
+        return;
+    }
+
+    int rows = boards[0].getNumRows();
+    for (size_t i = 0; i < n; i += GATHER_SIZE){
+        size_t m = n-i < GATHER_SIZE ? n-i : GATHER_SIZE;
+        for (size_t j = 0; j < m; ++j){
+            tokens[j] = boards[i+j].getTokens(player);
+        }
+        hasAlignmentBatch(tokens, m, rows, results+i, impl);
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * @file win_batch.h
+ *
+ * @brief Header file for the vectorized win detection on many boards
+ */
+
+#ifndef WIN_BATCH_H
+#define WIN_BATCH_H
+#include <stdint.h>
+#include <cstddef>
+#include "config.h"
+#include "connect4_bitboard.h"
+
+/**
+ * Implementations of the batched win check.
+ *
+ * WIN_BATCH_AUTO chooses the fastest one supported by the CPU.
+ */
+enum WinBatchImpl {WIN_BATCH_AUTO, WIN_BATCH_SCALAR, WIN_BATCH_SSE2, WIN_BATCH_AVX2};
+
+/**
+ * Returns true if the given implementation can run on this CPU.
+ */
+bool winBatchSupported(enum WinBatchImpl impl);
+
+/**
+ * Returns the name of the given implementation.
+ */
+const char* winBatchName(enum WinBatchImpl impl);
+
+/**
+ * Checks many bitboards of the same size for an alignment of N_IN_A_ROW
+ * tokens.
+ *
+ * The AVX2 implementation checks 4 boards per instruction and the SSE2 one
+ * 2. The AVX2 code is compiled for that target only, so the executable still
+ * runs on CPUs without it.
+ *
+ * @param tokens    bitboards of the tokens of a player (see Connect4Bitboard
+ *                  for the layout)
+ * @param n         number of bitboards
+ * @param rows      number of rows of the boards
+ * @param results   output: 1 for the bitboards with an alignment, 0 otherwise
+ * @param impl      implementation to use, it must be supported
+ */
+void hasAlignmentBatch(const bitboard_t* tokens, size_t n, int rows,
+                       uint8_t* results, enum WinBatchImpl impl = WIN_BATCH_AUTO);
+
+/**
+ * Checks whether the given player has won on each board.
+ *
+ * All the boards must have the same size.
+ *
+ * @param boards    the boards
+ * @param n         number of boards
+ * @param player    player marker
+ * @param results   output: 1 if the player has won on the board, 0 otherwise
+ * @param impl      implementation to use, it must be supported
+ */
+void checkWinBatch(const Connect4Bitboard* boards, size_t n, char player,
+                   uint8_t* results, enum WinBatchImpl impl = WIN_BATCH_AUTO);
+
+#endif //WIN_BATCH_H
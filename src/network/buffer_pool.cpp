@@ -0,0 +1,57 @@
+/**
+ * @file buffer_pool.cpp
+ *
+ * @brief Implementation of buffer_pool.h
+ *
+ * @see buffer_pool.h
+ */
+
+#include "network/buffer_pool.h"
+
+BufferPool::BufferPool(size_t buffer_size, size_t max_free)
+        : buffer_size(buffer_size), max_free(max_free) {
+    pthread_mutex_init(&mutex, NULL);
+}
+
+BufferPool::~BufferPool(){
+    setBufferSize(0);
+    pthread_mutex_destroy(&mutex);
+}
+
+void BufferPool::setBufferSize(size_t size){
+    pthread_mutex_lock(&mutex);
+    buffer_size = size;
+    for (size_t i = 0; i < free_buffers.size(); i++){
+        delete[] free_buffers[i];
+    }
+    free_buffers.clear();
+    pthread_mutex_unlock(&mutex);
+}
+
+char* BufferPool::get(size_t* size){
+    char* buf = NULL;
+
+    pthread_mutex_lock(&mutex);
+    *size = buffer_size;
+    if (!free_buffers.empty()){
+        buf = free_buffers.back();
+        free_buffers.pop_back();
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (buf == NULL){
+        buf = new char[*size];
+    }
+    return buf;
+}
+
+void BufferPool::put(char* buf, size_t size){
+    pthread_mutex_lock(&mutex);
+    if (size == buffer_size && free_buffers.size() < max_free){
+        free_buffers.push_back(buf);
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    delete[] buf;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file io_uring.cpp
+ *
+ * @brief Implementation of io_uring.h
+ *
+ * The memory layout of the rings and the barriers follow the io_uring(7)
+ * manual page.
+ *
+ * @see io_uring.h
+ */
+
+#include <cstring>
+#include <cstdlib>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "logging.h"
+#include "network/io_uring.h"
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p){
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags){
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                         flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg,
+                                 unsigned nr_args){
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+IoUring::IoUring(unsigned entries, unsigned cq_entries)
+        : sqe_tail(0), to_submit(0) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = cq_entries;
+
+    ring_fd = sys_io_uring_setup(entries, &p);
+    if (ring_fd < 0){
+        LOG_PERROR(LOG_ERR, "Error creating the io_uring: %s");
+        throw "Error creating the io_uring";
+    }
+
+    sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+
+    sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_SQ_RING);
+    cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_CQ_RING);
+    sqes = (struct io_uring_sqe*) mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, ring_fd,
+                                       IORING_OFF_SQES);
+    if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED){
+        LOG_PERROR(LOG_ERR, "Error mapping the io_uring: %s");
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+        if (cq_ptr != MAP_FAILED) munmap(cq_ptr, cq_size);
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+        close(ring_fd);
+        throw "Error mapping the io_uring";
+    }
+
+    sq_head = (unsigned*) ((char*) sq_ptr + p.sq_off.head);
+    sq_tail = (unsigned*) ((char*) sq_ptr + p.sq_off.tail);
+    sq_mask = (unsigned*) ((char*) sq_ptr + p.sq_off.ring_mask);
+    sq_array = (unsigned*) ((char*) sq_ptr + p.sq_off.array);
+    sq_entries = p.sq_entries;
+    sqe_tail = *sq_tail;
+
+    cq_head = (unsigned*) ((char*) cq_ptr + p.cq_off.head);
+    cq_tail = (unsigned*) ((char*) cq_ptr + p.cq_off.tail);
+    cq_mask = (unsigned*) ((char*) cq_ptr + p.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*) ((char*) cq_ptr + p.cq_off.cqes);
+}
+
+IoUring::~IoUring(){
+    munmap(sqes, sqes_size);
+    munmap(cq_ptr, cq_size);
+    munmap(sq_ptr, sq_size);
+    close(ring_fd);
+}
+
+bool IoUring::isSupported(const uint8_t* ops, int n){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = sys_io_uring_setup(2, &p);
+    if (fd < 0){
+        return false;
+    }
+
+    size_t probe_size = sizeof(struct io_uring_probe)
+                        + 256*sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*) calloc(1, probe_size);
+    bool supported = probe != NULL
+        && sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+    for (int i = 0; supported && i < n; ++i){
+        supported = ops[i] <= probe->last_op
+            && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+    close(fd);
+    return supported;
+}
+
+struct io_uring_sqe* IoUring::getSqe(){
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= sq_entries){
+        submit();
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    }
+
+    unsigned index = sqe_tail & *sq_mask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    sq_array[index] = index;
+    sqe_tail++;
+    to_submit++;
+
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void IoUring::prepAccept(int fd, struct sockaddr* addr, socklen_t* addrlen,
+                         uint64_t user_data){
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) addr;
+    sqe->addr2 = (uint64_t) addrlen;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepRecvSelect(int fd, size_t len, uint16_t group, uint64_t user_data){
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->len = len;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepSendmsg(int fd, const struct msghdr* msg, int flags,
+                          uint64_t user_data){
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) msg;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepRead(int fd, void* buf, size_t len, uint64_t user_data){
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) buf;
+    sqe->len = len;
+    sqe->off = (uint64_t) -1; // current position, needed by non-seekable files
+    sqe->user_data = user_data;
+}
+
+void IoUring::prepProvideBuffers(void* addr, size_t len, int n, uint16_t group,
+                                 uint16_t bid, uint64_t user_data){
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = n;
+    sqe->addr = (uint64_t) addr;
+    sqe->len = len;
+    sqe->off = bid;
+    sqe->buf_group = group;
+    sqe->user_data = user_data;
+}
+
+int IoUring::submit(unsigned wait_nr /* = 0 */){
+    // entries must be written before the kernel sees the new tail
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do {
+        ret = sys_io_uring_enter(ring_fd, to_submit, wait_nr, flags);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0){
+        return -errno;
+    }
+    to_submit -= (unsigned) ret < to_submit ? ret : to_submit;
+    return ret;
+}
+
+struct io_uring_cqe* IoUring::peekCqe(){
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)){
+        return NULL;
+    }
+    return &cqes[head & *cq_mask];
+}
+
+void IoUring::advanceCq(){
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -17,6 +17,8 @@
 #include "security/crypto_utils.h"
 #include "utils/buffer_io.h"
 
+msglen_t Message::max_size = MAX_MSG_SIZE;
+
 Message* readMessage(char *buffer, msglen_t len){
     Message *m;
     int ret;
@@ -83,6 +85,7 @@ Message* readMessage(char *buffer, msglen_t len){
 
     if (ret != 0){
         LOG(LOG_ERR, "Error reading message of type %d: %d", buffer[0], ret);
+        delete m;
         return NULL;
     } else{
         return m;
@@ -93,7 +96,7 @@ msglen_t StartGameMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) START_GAME_PEER)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) START_GAME_PEER)) < 0)
         return 0;
     i += ret;
 
@@ -108,11 +111,11 @@ msglen_t MoveMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) MOVE)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) MOVE)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, col)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, col)) < 0)
         return 0;
     i += ret;
 
@@ -134,11 +137,11 @@ msglen_t RegisterMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) REGISTER)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) REGISTER)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, username)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, username)) < 0)
         return 0;
     i += ret;
 
@@ -160,11 +163,11 @@ msglen_t ChallengeMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CHALLENGE)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CHALLENGE)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, username)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, username)) < 0)
         return 0;
     i += ret;
 
@@ -185,7 +188,7 @@ msglen_t GameEndMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) GAME_END)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) GAME_END)) < 0)
         return 0;
     
     i += ret;
@@ -200,19 +203,23 @@ msglen_t UsersListMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) USERS_LIST)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) USERS_LIST)) < 0)
         return 0;
     i += ret;
 
     size_t strsize = min(usernames.size(), 
                          (size_t) ((MAX_USERNAME_LENGTH+1)*MAX_USERS));
     size_t padded_size = (strsize+MAX_USERNAME_LENGTH)/(MAX_USERNAME_LENGTH+1)*(MAX_USERNAME_LENGTH+1);
-    if ((int)padded_size > MAX_MSG_SIZE-i)
+    if ((int)padded_size > max_size-i)
         return 0;
     strncpy(&buffer[i], usernames.c_str(), strsize);
     memset(&buffer[1+strsize], 0, padded_size-strsize+1);
     i += padded_size+1;
 
+    if ((ret = writeUsername(&buffer[i], max_size-i, cursor)) < 0)
+        return 0;
+    i += ret;
+
     return i;
 }
 
@@ -222,7 +229,16 @@ msglen_t UsersListMessage::read(char *buffer, msglen_t len){
         return 1;
     }
 
-    usernames = string(&buffer[1], maxsize);
+    size_t strsize = strnlen(&buffer[1], maxsize);
+    usernames = string(&buffer[1], strsize);
+
+    // the cursor follows the padded list
+    size_t padded_size = (strsize+MAX_USERNAME_LENGTH)/(MAX_USERNAME_LENGTH+1)*(MAX_USERNAME_LENGTH+1);
+    int i = 1+padded_size+1;
+    cursor = "";
+    if (i < len){
+        readUsername(&cursor, &buffer[i], len-i);
+    }
     return 0;
 }
 
@@ -230,11 +246,15 @@ msglen_t UsersListRequestMessage::write(char *buffer){
         int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) USERS_LIST_REQ)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) USERS_LIST_REQ)) < 0)
+        return 0;
+    i += ret;
+
+    if ((ret = writeUInt32(&buffer[i], max_size-i, offset)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt32(&buffer[i], MAX_MSG_SIZE-i, offset)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, cursor)) < 0)
         return 0;
     i += ret;
 
@@ -249,6 +269,11 @@ msglen_t UsersListRequestMessage::read(char *buffer, msglen_t len){
         return 1;
     i += ret;
 
+    cursor = "";
+    if (i < len){
+        readUsername(&cursor, &buffer[i], len-i);
+    }
+
     return 0;
 }
 
@@ -256,11 +281,11 @@ msglen_t ChallengeForwardMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CHALLENGE_FWD)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CHALLENGE_FWD)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, username)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, username)) < 0)
         return 0;
     i += ret;
 
@@ -281,19 +306,19 @@ msglen_t ChallengeResponseMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CHALLENGE_RESP)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CHALLENGE_RESP)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeBool(&buffer[i], MAX_MSG_SIZE-i, response)) < 0)
+    if ((ret = writeBool(&buffer[i], max_size-i, response)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt16(&buffer[i], MAX_MSG_SIZE-i, listen_port)) < 0)
+    if ((ret = writeUInt16(&buffer[i], max_size-i, listen_port)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, username)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, username)) < 0)
         return 0;
     i += ret;
 
@@ -322,11 +347,11 @@ msglen_t GameCancelMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) GAME_CANCEL)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) GAME_CANCEL)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, username)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, username)) < 0)
         return 0;
     i += ret;
 
@@ -347,19 +372,19 @@ msglen_t GameStartMessage::write(char *buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) GAME_START)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) GAME_START)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeSockAddrIn(&buffer[i], MAX_MSG_SIZE-i, addr)) < 0)
+    if ((ret = writeSockAddrIn(&buffer[i], max_size-i, addr)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, username)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, username)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = cert2buf(cert, &buffer[i], MAX_MSG_SIZE - i)) < 0)
+    if ((ret = cert2buf(cert, &buffer[i], max_size-i)) < 0)
         return 0;    
     i += ret;
 
@@ -389,15 +414,15 @@ msglen_t SecureMessage::write(char* buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) SECURE_MESSAGE)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) SECURE_MESSAGE)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeBuf(&buffer[i], MAX_MSG_SIZE-i, ct, ct_size)) < 0)
+    if ((ret = writeBuf(&buffer[i], max_size-i, ct, ct_size)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeBuf(&buffer[i], MAX_MSG_SIZE-i, tag, TAG_SIZE)) < 0)
+    if ((ret = writeBuf(&buffer[i], max_size-i, tag, TAG_SIZE)) < 0)
         return 0;
     i += ret;
 
@@ -405,49 +430,63 @@ msglen_t SecureMessage::write(char* buffer){
 }
 
 msglen_t SecureMessage::read(char* buffer, msglen_t len){
-    ct_size = len-1-TAG_SIZE;
-    ct = (char*) malloc(ct_size);
-    tag = (char*) malloc(TAG_SIZE);
-    if(!ct || !tag){
-        LOG(LOG_WARN, "Malloc failed for message of length %d", len);
-        return -1;
-    }
-
-    int i = 1;
-    int ret;
-
-    if ((ret = readBuf(ct, ct_size, &buffer[i], len-i)) < 0)
+    if (len < 1 + TAG_SIZE)
         return 1;
-    i += ret;
-    
-    if ((ret = readBuf(tag, TAG_SIZE, &buffer[i], len-i)) < 0)
-        return 1;
-    i += ret;
+
+    // no copies: ct and tag are decrypted and verified in place
+    ct_size = len-1-TAG_SIZE;
+    ct = &buffer[1];
+    tag = &buffer[1+ct_size];
     
     return 0;
 }
 
+/**
+ * Reads the cipher suite that follows the ephemeral key of the hello
+ * messages, P-256 if there is none.
+ * 
+ * @returns the number of read bytes, -1 if the suite is not valid
+ */
+static int readSuite(CipherSuite* suite, char* buffer, int len){
+    uint8_t val;
+
+    if (len <= 0){
+        *suite = SUITE_P256;
+        return 0;
+    }
+    if (readUInt8(&val, buffer, len) < 0 || suite_name(val) == NULL){
+        LOG(LOG_WARN, "Unknown cipher suite %d", val);
+        return -1;
+    }
+    *suite = (CipherSuite) val;
+    return 1;
+}
+
 msglen_t ClientHelloMessage::write(char* buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CLIENT_HELLO)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CLIENT_HELLO)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt32(&buffer[i], MAX_MSG_SIZE-i, nonce)) < 0)
+    if ((ret = writeUInt32(&buffer[i], max_size-i, nonce)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, my_id)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, my_id)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, other_id)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, other_id)) < 0)
         return 0;
     i += ret;
     
-    if ((ret = pkey2buf(eph_key, &buffer[i], MAX_MSG_SIZE-i)) < 0)
+    if ((ret = pkey2buf(eph_key, &buffer[i], max_size-i)) < 0)
+        return 0;
+    i += ret;
+
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (uint8_t) suite)) < 0)
         return 0;
     i += ret;
 
@@ -474,6 +513,10 @@ msglen_t ClientHelloMessage::read(char* buffer, msglen_t len){
         return 1;
     i += ret;
 
+    if ((ret = readSuite(&suite, &buffer[i], len-i)) < 0)
+        return 1;
+    i += ret;
+
     return 0;
 }
 
@@ -487,31 +530,35 @@ msglen_t ServerHelloMessage::write(char* buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) SERVER_HELLO)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) SERVER_HELLO)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt32(&buffer[i], MAX_MSG_SIZE-i, nonce)) < 0)
+    if ((ret = writeUInt32(&buffer[i], max_size-i, nonce)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, my_id)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, my_id)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUsername(&buffer[i], MAX_MSG_SIZE-i, other_id)) < 0)
+    if ((ret = writeUsername(&buffer[i], max_size-i, other_id)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt32(&buffer[i], MAX_MSG_SIZE-i, ds_size)) < 0)
+    if ((ret = writeUInt32(&buffer[i], max_size-i, ds_size)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeBuf(&buffer[i], MAX_MSG_SIZE-i, ds, ds_size)) < 0)
+    if ((ret = writeBuf(&buffer[i], max_size-i, ds, ds_size)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = pkey2buf(eph_key, &buffer[i], MAX_MSG_SIZE-i)) < 0)
+    if ((ret = pkey2buf(eph_key, &buffer[i], max_size-i)) < 0)
+        return 0;
+    i += ret;
+
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (uint8_t) suite)) < 0)
         return 0;
     i += ret;
 
@@ -552,6 +599,10 @@ msglen_t ServerHelloMessage::read(char* buffer, msglen_t len){
         return 1;
     i += ret;
 
+    if ((ret = readSuite(&suite, &buffer[i], len-i)) < 0)
+        return 1;
+    i += ret;
+
     return 0;
 }
 
@@ -565,15 +616,15 @@ msglen_t ClientVerifyMessage::write(char* buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CLIENT_VERIFY)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CLIENT_VERIFY)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeUInt32(&buffer[i], MAX_MSG_SIZE-i, ds_size)) < 0)
+    if ((ret = writeUInt32(&buffer[i], max_size-i, ds_size)) < 0)
         return 0;
     i += ret;
 
-    if ((ret = writeBuf(&buffer[i], MAX_MSG_SIZE-i, ds, ds_size)) < 0)
+    if ((ret = writeBuf(&buffer[i], max_size-i, ds, ds_size)) < 0)
         return 0;
     i += ret;
 
@@ -605,7 +656,7 @@ msglen_t CertificateRequestMessage::write(char* buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CERT_REQ)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CERT_REQ)) < 0)
         return 0;
     
     i += ret;
@@ -621,12 +672,12 @@ msglen_t CertificateMessage::write(char* buffer){
     int i = 0;
     int ret;
 
-    if ((ret = writeUInt8(&buffer[i], MAX_MSG_SIZE-i, (char) CERTIFICATE)) < 0)
+    if ((ret = writeUInt8(&buffer[i], max_size-i, (char) CERTIFICATE)) < 0)
         return 0;
     
     i += ret;
 
-    if ((ret = cert2buf(cert, &buffer[i], MAX_MSG_SIZE-1)) < 0)
+    if ((ret = cert2buf(cert, &buffer[i], max_size-i)) < 0)
         return 0;
     i += ret;
 
@@ -7,67 +7,78 @@
  * @see socket_wrapper.h
  */
 
-#include <assert.h>
+#include <errno.h>
+#include <cstring>
 #include "logging.h"
 #include "network/socket_wrapper.h"
 #include "utils/dump_buffer.h"
 #include "network/inet_utils.h"
 
-SocketWrapper::SocketWrapper() {
+BufferPool* SocketWrapper::buffers = new BufferPool(MAX_MSG_SIZE, 
+                                                    RECV_BUFFER_POOL_SIZE);
+BufferPool* SocketWrapper::send_buffers = new BufferPool(
+        sizeof(msglen_t) + MAX_MSG_SIZE, SEND_BUFFER_POOL_SIZE);
+
+void SocketWrapper::setMaxMsgSize(msglen_t size){
+    Message::max_size = size;
+    buffers->setBufferSize(size);
+    send_buffers->setBufferSize(sizeof(msglen_t) + size);
+}
+
+SocketWrapper::SocketWrapper() : buf_idx(0), sender(NULL) {
+    size_t size;
+    buffer_in = buffers->get(&size);
+    buffer_in_size = size;
+
     socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_fd < 0){
         LOG_PERROR(LOG_ERR, "Error creating socket: %s");
         return;    
     }
-    buf_idx = 0;
 }
-Message* SocketWrapper::readPartMsg(){
-    int len;
-    msglen_t msglen = 0;
-
-    if (buf_idx < sizeof(msglen)){ // I first need to read msglen
-        // read available message
-        len = read(socket_fd, buffer_in+buf_idx, sizeof(msglen)-buf_idx);
-        // I will read rest of it in another moment since I do not know
-        // whether other data is available.
-        // TODO: find a way to tell whether socket has other data
-    } else{
-        // read msg length
-        msglen = MSGLEN_NTOH(*((msglen_t*)buffer_in));
-        assert(msglen <= MAX_MSG_SIZE); // must not happen
 
-        // read up to msg length
-        len = read(socket_fd, buffer_in+buf_idx, msglen-buf_idx);
+SocketWrapper::SocketWrapper(int sd) : socket_fd(sd), buf_idx(0), sender(NULL) {
+    size_t size;
+    buffer_in = buffers->get(&size);
+    buffer_in_size = size;
+}
+
+SocketWrapper::~SocketWrapper(){
+    closeSocket();
+    delete sender;
+    buffers->put(buffer_in, buffer_in_size);
+}
+
+msglen_t SocketWrapper::missingBytes(){
+    if (buf_idx < sizeof(msglen_t)){ // I first need to read msglen
+        return sizeof(msglen_t)-buf_idx;
     }
+    // read up to msg length
+    return MSGLEN_NTOH(*((msglen_t*)buffer_in))-buf_idx;
+}
 
-    DUMP_BUFFER_HEX_DEBUG(buffer_in, len);
-    
-    if (len < 0){
-        LOG_PERROR(LOG_ERR, "Error reading from socket: %s");
-        throw "Error reading from socket";
-    } else if (len == 0){
-        throw "Connection lost";
-    } 
+Message* SocketWrapper::appendedBytes(msglen_t len){
+    msglen_t msglen;
+
+    DUMP_BUFFER_HEX_DEBUG(buffer_in+buf_idx, len);
 
-    // buf_idx is also the number of read bytes up to now    
+    // buf_idx is also the number of read bytes up to now
     buf_idx += len;
 
     if (buf_idx < sizeof(msglen)){
-        LOG(LOG_DEBUG, "Too few bytes recevied from socket: %d < %lu", 
-            buf_idx, sizeof(msglen));
         return NULL;
     }
 
     // read msg length
     msglen = MSGLEN_NTOH(*((msglen_t*)buffer_in));
 
-    if (msglen > MAX_MSG_SIZE){
+    if (msglen > buffer_in_size){
         throw("Message is too big");
-    } 
+    } else if (msglen <= sizeof(msglen)){
+        throw("Message is too short");
+    }
 
     if (buf_idx != msglen){
-        LOG(LOG_DEBUG, "Too few bytes received from socket: %d < %d", 
-            buf_idx, msglen);
         return NULL;
     }
 
@@ -76,9 +87,63 @@ Message* SocketWrapper::readPartMsg(){
     // reset buffer
     buf_idx = 0;
 
+    if (m == NULL){
+        LOG(LOG_WARN, "Discarded malformed message of %d bytes", msglen);
+    } else if (m->getType() == SECURE_MESSAGE){
+        // the message points into the buffer: hand it over instead of
+        // copying it
+        size_t size;
+        ((SecureMessage*) m)->adoptBuffer(buffer_in, buffer_in_size, buffers);
+        buffer_in = buffers->get(&size);
+        buffer_in_size = size;
+    }
     return m;
 }
 
+Message* SocketWrapper::readPartMsg(){
+    int len;
+
+    while (1){
+        len = recv(socket_fd, buffer_in+buf_idx, missingBytes(), MSG_DONTWAIT);
+
+        if (len < 0){
+            if (errno == EAGAIN || errno == EWOULDBLOCK){
+                // no more data for now, the rest will be read later
+                return NULL;
+            } else if (errno == EINTR){
+                continue;
+            }
+            LOG_PERROR(LOG_ERR, "Error reading from socket: %s");
+            throw "Error reading from socket";
+        } else if (len == 0){
+            throw "Connection lost";
+        }
+
+        Message *m = appendedBytes(len);
+        if (m != NULL){
+            return m;
+        }
+    }
+}
+
+Message* SocketWrapper::consumeBytes(const char** data, size_t* len){
+    while (*len > 0){
+        msglen_t n = missingBytes();
+        if (n > *len){
+            n = *len;
+        }
+        memcpy(buffer_in+buf_idx, *data, n);
+        *data += n;
+        *len -= n;
+
+        Message *m = appendedBytes(n);
+        if (m != NULL){
+            return m;
+        }
+    }
+    return NULL;
+}
+
 Message* SocketWrapper::receiveAnyMsg(){
     int len;
     msglen_t msglen;
@@ -99,7 +164,7 @@ Message* SocketWrapper::receiveAnyMsg(){
     // read msg payload
     msglen = MSGLEN_NTOH(*((msglen_t*)buffer_in));
 
-    if (msglen > MAX_MSG_SIZE){
+    if (msglen > buffer_in_size){
         throw("Message is too big");
     } 
 
@@ -149,31 +214,51 @@ Message* SocketWrapper::receiveMsg(MessageType type[], int n_types){
 
 int SocketWrapper::sendMsg(Message *msg){
     msglen_t msglen, pktlen;
-    int len;
+    size_t size;
+    char* buffer_out = send_buffers->get(&size);
+    int ret = 0;
 
     msglen = msg->write(buffer_out+sizeof(msglen));
-    if (msglen == 0)
+    if (msglen == 0){
+        send_buffers->put(buffer_out, size);
         return 1;
+    }
     
     pktlen = msglen + sizeof(msglen);
     *((msglen_t*)buffer_out) = MSGLEN_HTON(pktlen);
 
     LOG(LOG_DEBUG, "Sending %s", msg->getName().c_str());
 
-    DUMP_BUFFER_HEX_DEBUG(buffer_out, pktlen);
+    if (sendPacket(buffer_out, pktlen) != 0){
+        LOG(LOG_ERR, "Error sending %s", msg->getName().c_str());
+        ret = 1;
+    } else{
+        LOG(LOG_DEBUG, "Sent message %s", msg->getName().c_str());
+    }
+
+    send_buffers->put(buffer_out, size);
+    return ret;
+}
 
-    len = send(socket_fd, buffer_out, pktlen, 0);
-    if (len != pktlen){
-        LOG(LOG_ERR, "Error sending %s: len (%d) != msglen (%d)", 
-            msg->getName().c_str(),
-            len, 
-            msglen
-        );
-        return 1;
+int SocketWrapper::sendPacket(const char* buf, msglen_t len){
+    int ret;
+
+    DUMP_BUFFER_HEX_DEBUG((char*) buf, len);
+
+    if (sender != NULL){
+        if (sender->send(buf, len) != 0){
+            LOG(LOG_ERR, "Error queueing packet of %d bytes", len);
+            return 1;
+        }
+        return 0;
     }
 
-    LOG(LOG_DEBUG, "Sent message %s", msg->getName().c_str());
-    
+    ret = send(socket_fd, buf, len, 0);
+    if (ret != len){
+        LOG(LOG_ERR, "Error sending packet: len (%d) != pktlen (%d)", 
+            ret, len);
+        return 1;
+    }
     return 0;
 }
 
@@ -209,7 +294,7 @@ int ServerSocketWrapper::bindPort(){
         return ret;
     }
 
-    ret = listen(socket_fd, 10);
+    ret = listen(socket_fd, SOMAXCONN);
     if (ret != 0){
         LOG_PERROR(LOG_ERR, "Error in setting socket to listen mode: %s");
     }
@@ -225,7 +310,7 @@ int ServerSocketWrapper::bindPort(int port){
         return ret;    
     }
 
-    ret = listen(socket_fd, 10);
+    ret = listen(socket_fd, SOMAXCONN);
     if (ret != 0){
         LOG_PERROR(LOG_ERR, "Error in setting socket to listen mode: %s");
     }
@@ -233,6 +318,15 @@ int ServerSocketWrapper::bindPort(int port){
     return ret;
 }
 
+bool ServerSocketWrapper::setReusePort(){
+    int one = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0){
+        LOG_PERROR(LOG_ERR, "Error setting SO_REUSEPORT: %s");
+        return false;
+    }
+    return true;
+}
+
 SocketWrapper* ServerSocketWrapper::acceptClient(){
     socklen_t len = sizeof(other_addr);
     int new_sd = accept(
@@ -241,7 +335,18 @@ SocketWrapper* ServerSocketWrapper::acceptClient(){
         &len
     );
 
-    SocketWrapper *sw = new SocketWrapper(new_sd);
-    sw->setOtherAddr(other_addr);
+    if (new_sd < 0){
+        if (errno != EAGAIN && errno != EWOULDBLOCK){
+            LOG_PERROR(LOG_ERR, "Error accepting connection: %s");
+        }
+        return NULL;
+    }
+
+    return wrapClient(new_sd, other_addr);
+}
+
+SocketWrapper* ServerSocketWrapper::wrapClient(int sd, struct sockaddr_in addr){
+    SocketWrapper *sw = new SocketWrapper(sd);
+    sw->setOtherAddr(addr);
     return sw;
 }
@@ -1,25 +1,39 @@
+#include <pthread.h>
 #include "security/crypto.h"
 #include "logging.h"
 
-int aes_gcm_encrypt(char *plaintext, int plaintext_len,
-                    char *aad, int aad_len,
-                    char *key,
-                    char *iv,
-                    char *ciphertext,
-                    char *tag)
+EVP_CIPHER_CTX* aes_gcm_new_ctx(char *key, int enc)
 {
     EVP_CIPHER_CTX *ctx;
 
-    int len;
-
-    int ciphertext_len;
-
     /* Create and initialise the context */
     if (!(ctx = EVP_CIPHER_CTX_new()))
         handleErrors();
 
-    /* Initialise the encryption operation. */
-    if (1 != EVP_EncryptInit(ctx, EVP_aes_128_gcm(), (unsigned char*) key, (unsigned char*) iv))
+    /* Compute the key schedule once, the IV is set by each operation */
+    if (1 != EVP_CipherInit_ex(ctx, EVP_aes_128_gcm(), NULL,
+                               (unsigned char*) key, NULL, enc))
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        handleErrors();
+    }
+
+    return ctx;
+}
+
+int aes_gcm_encrypt_ctx(EVP_CIPHER_CTX *ctx,
+                        char *plaintext, int plaintext_len,
+                        char *aad, int aad_len,
+                        char *iv,
+                        char *ciphertext,
+                        char *tag)
+{
+    int len;
+
+    int ciphertext_len;
+
+    /* Initialise the encryption operation, keeping the key schedule */
+    if (1 != EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, (unsigned char*) iv))
         handleErrors();
 
     /*
@@ -41,7 +55,7 @@ int aes_gcm_encrypt(char *plaintext, int plaintext_len,
      * Finalise the encryption. Normally ciphertext bytes may be written at
      * this stage, but this does not occur in GCM mode
      */
-    if (1 != EVP_EncryptFinal(ctx, (unsigned char*) ciphertext + len, &len))
+    if (1 != EVP_EncryptFinal_ex(ctx, (unsigned char*) ciphertext + len, &len))
         handleErrors();
     ciphertext_len += len;
 
@@ -49,31 +63,22 @@ int aes_gcm_encrypt(char *plaintext, int plaintext_len,
     if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag))
         handleErrors();
 
-    /* Clean up */
-    EVP_CIPHER_CTX_free(ctx);
-
     return ciphertext_len;
 }
 
-int aes_gcm_decrypt(char *ciphertext, int ciphertext_len,
-                    char *aad, int aad_len,
-                    char *key,
-                    char *iv,
-                    char *plaintext,
-                    char *tag
-                    )
+int aes_gcm_decrypt_ctx(EVP_CIPHER_CTX *ctx,
+                        char *ciphertext, int ciphertext_len,
+                        char *aad, int aad_len,
+                        char *iv,
+                        char *plaintext,
+                        char *tag)
 {
-    EVP_CIPHER_CTX *ctx;
     int len;
     int plaintext_len;
     int ret;
 
-    /* Create and initialise the context */
-    if (!(ctx = EVP_CIPHER_CTX_new()))
-        handleErrors();
-
-    /* Initialise the decryption operation. */
-    if (!EVP_DecryptInit(ctx, EVP_aes_128_gcm(), (unsigned char*) key, (unsigned char*) iv))
+    /* Initialise the decryption operation, keeping the key schedule */
+    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, (unsigned char*) iv))
         handleErrors();
 
     /*
@@ -99,10 +104,7 @@ int aes_gcm_decrypt(char *ciphertext, int ciphertext_len,
      * Finalise the decryption. A positive return value indicates success,
      * anything else is a failure - the plaintext is not trustworthy.
      */
-    ret = EVP_DecryptFinal(ctx, (unsigned char*) plaintext + len, &len);
-
-    /* Clean up */
-    EVP_CIPHER_CTX_free(ctx);
+    ret = EVP_DecryptFinal_ex(ctx, (unsigned char*) plaintext + len, &len);
 
     if (ret > 0)
     {
@@ -117,73 +119,169 @@ int aes_gcm_decrypt(char *ciphertext, int ciphertext_len,
     }
 }
 
-int get_ecdh_key(EVP_PKEY **key)
+int aes_gcm_encrypt(char *plaintext, int plaintext_len,
+                    char *aad, int aad_len,
+                    char *key,
+                    char *iv,
+                    char *ciphertext,
+                    char *tag)
+{
+    EVP_CIPHER_CTX *ctx = aes_gcm_new_ctx(key, 1);
+    int ret;
+
+    try{
+        ret = aes_gcm_encrypt_ctx(ctx, plaintext, plaintext_len, aad, aad_len,
+                                  iv, ciphertext, tag);
+    } catch(const char* msg){
+        EVP_CIPHER_CTX_free(ctx);
+        throw;
+    }
+
+    /* Clean up */
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+int aes_gcm_decrypt(char *ciphertext, int ciphertext_len,
+                    char *aad, int aad_len,
+                    char *key,
+                    char *iv,
+                    char *plaintext,
+                    char *tag)
 {
-    EVP_PKEY *dh_params = NULL;
-    EVP_PKEY_CTX *ctx_params;
+    EVP_CIPHER_CTX *ctx = aes_gcm_new_ctx(key, 0);
     int ret;
 
-    ctx_params = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    try{
+        ret = aes_gcm_decrypt_ctx(ctx, ciphertext, ciphertext_len, aad, aad_len,
+                                  iv, plaintext, tag);
+    } catch(const char* msg){
+        EVP_CIPHER_CTX_free(ctx);
+        throw;
+    }
+
+    /* Clean up */
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+/** Parameters of the prime256v1 curve, created once and then read-only */
+static EVP_PKEY *ecdh_params = NULL;
+static pthread_once_t ecdh_params_once = PTHREAD_ONCE_INIT;
+
+static void create_ecdh_params()
+{
+    EVP_PKEY_CTX *ctx_params = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
     if (!ctx_params)
     {
-        handleErrors();
+        handleErrorsNoException(LOG_ERR);
+        return;
     }
-    ret = EVP_PKEY_paramgen_init(ctx_params);
-    if (!ret)
+    //Using NID_X9_62_prime256v1 curve
+    if (EVP_PKEY_paramgen_init(ctx_params) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx_params, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_paramgen(ctx_params, &ecdh_params) <= 0)
     {
-        handleErrors();
+        handleErrorsNoException(LOG_ERR);
+        ecdh_params = NULL;
     }
-    //Using NID_X9_62_prime256v1 curve
-    ret = EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
-        ctx_params,
-        NID_X9_62_prime256v1);
-    if (!ret)
+    EVP_PKEY_CTX_free(ctx_params);
+}
+
+int get_ecdh_key(EVP_PKEY **key)
+{
+    int ret;
+
+    // the parameters are shared by all keys (and threads)
+    pthread_once(&ecdh_params_once, create_ecdh_params);
+    if (ecdh_params == NULL)
     {
-        handleErrors();
+        throw "OpenSSL Error";
     }
 
-    ret = EVP_PKEY_paramgen(ctx_params, &dh_params);
-    if (!ret)
+    // creating the context for key generation
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(ecdh_params, NULL);
+    if (ctx == NULL)
     {
         handleErrors();
     }
+    // Generating the key
+    ret = EVP_PKEY_keygen_init(ctx);
+    if (ret > 0)
+    {
+        ret = EVP_PKEY_keygen(ctx, key);
+    }
+    EVP_PKEY_CTX_free(ctx);
+
     //check
-    if (dh_params == NULL)
+    if (ret <= 0 || *key == NULL)
     {
         handleErrors();
-        return ret;
     }
+    return ret;
+}
 
-    EVP_PKEY_CTX_free(ctx_params);
+int get_x25519_key(EVP_PKEY **key)
+{
+    int ret;
 
-    // creating the context for key generation
-    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(dh_params, NULL);
+    // X25519 has no parameters to generate
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, NULL);
     if (ctx == NULL)
     {
         handleErrors();
     }
-    // Generating the key
     ret = EVP_PKEY_keygen_init(ctx);
-    if (!ret)
+    if (ret > 0)
     {
-        handleErrors();
+        ret = EVP_PKEY_keygen(ctx, key);
     }
+    EVP_PKEY_CTX_free(ctx);
 
-    ret = EVP_PKEY_keygen(ctx, key);
-    if (!ret)
+    //check
+    if (ret <= 0 || *key == NULL)
     {
         handleErrors();
     }
+    return ret;
+}
 
-    //check
-    if (key == NULL)
+int get_eph_key(CipherSuite suite, EVP_PKEY **key)
+{
+    switch (suite)
     {
-        handleErrors();
-        return ret;
+        case SUITE_X25519:
+            return get_x25519_key(key);
+        case SUITE_P256:
+        default:
+            return get_ecdh_key(key);
     }
+}
 
-    EVP_PKEY_CTX_free(ctx);
-    return ret;
+bool is_suite_key(CipherSuite suite, EVP_PKEY *key)
+{
+    switch (suite)
+    {
+        case SUITE_X25519:
+            return EVP_PKEY_id(key) == EVP_PKEY_X25519;
+        case SUITE_P256:
+            return EVP_PKEY_id(key) == EVP_PKEY_EC;
+        default:
+            return false;
+    }
+}
+
+const char* suite_name(int suite)
+{
+    switch (suite)
+    {
+        case SUITE_X25519:
+            return "X25519";
+        case SUITE_P256:
+            return "P-256";
+        default:
+            return NULL;
+    }
 }
 
 /**
@@ -464,30 +562,36 @@ void hkdf(char *key, size_t key_len,
     free(info);
 }
 
+/**
+ * Returns the digest of the signatures made with the given key, NULL for
+ * Ed25519 which signs the whole message.
+ */
+static const EVP_MD* signature_md(EVP_PKEY *key){
+    return EVP_PKEY_id(key) == EVP_PKEY_ED25519 ? NULL : EVP_sha256();
+}
+
 int dsa_sign(char* msg, int msglen, char** signature,
              EVP_PKEY *prvkey){
-            unsigned int sign_len;
+    size_t sign_len = EVP_PKEY_size(prvkey);
 
     EVP_MD_CTX* ctx = EVP_MD_CTX_new();
     if (ctx == NULL){
         handleErrors();
     }
 
-    *signature = (char*) malloc(EVP_PKEY_size(prvkey));
+    *signature = (char*) malloc(sign_len);
     if (*signature == NULL){
         LOG_PERROR(LOG_ERR, "Malloc failed: %s");
+        EVP_MD_CTX_free(ctx);
         return -1;
     }
 
-    if (EVP_SignInit(ctx, EVP_sha256()) != 1){
-        handleErrors();
-    }
-
-    if (EVP_SignUpdate(ctx, (unsigned char*) msg, msglen) != 1){
-        handleErrors();
-    }
-
-    if (EVP_SignFinal(ctx, (unsigned char*) *signature, &sign_len, prvkey) != 1){
+    if (EVP_DigestSignInit(ctx, NULL, signature_md(prvkey), NULL, prvkey) != 1 ||
+        EVP_DigestSign(ctx, (unsigned char*) *signature, &sign_len, 
+                       (unsigned char*) msg, msglen) != 1){
+        EVP_MD_CTX_free(ctx);
+        free(*signature);
+        *signature = NULL;
         handleErrors();
     }
 
@@ -505,15 +609,14 @@ bool dsa_verify(char* msg, int msglen,
         handleErrors();
     }
 
-    if (EVP_VerifyInit(ctx, EVP_sha256()) != 1){
-        handleErrors();
-    }
-
-    if (EVP_VerifyUpdate(ctx, msg, msglen) != 1){
+    if (EVP_DigestVerifyInit(ctx, NULL, signature_md(pkey), NULL, pkey) != 1){
+        EVP_MD_CTX_free(ctx);
         handleErrors();
     }
 
-    int ret = EVP_VerifyFinal(ctx, (unsigned char*) signature, sign_len, pkey);
+    int ret = EVP_DigestVerify(ctx, (unsigned char*) signature, sign_len,
+                               (unsigned char*) msg, msglen);
+    EVP_MD_CTX_free(ctx);
     if(ret != 1){
         return false;
     }
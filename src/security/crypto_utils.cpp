@@ -21,12 +21,14 @@ int pkey2buf(EVP_PKEY *key, char* buf, int buflen){
 
 
 int buf2pkey(char* buf, int buflen, EVP_PKEY **key){
+    char* start = buf;
     const unsigned char **p = (const unsigned char**) &buf;
     if (d2i_PUBKEY(key, p, buflen) == NULL){
         handleErrors();
         return -1;
     }
-    return 1;
+    // d2i advances buf past the key
+    return buf - start;
 }
 
 int cert2buf(X509 *cert, char* buf, int buflen){
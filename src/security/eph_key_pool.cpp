@@ -0,0 +1,128 @@
+/**
+ * @file eph_key_pool.cpp
+ *
+ * @brief Implementation of eph_key_pool.h
+ *
+ * @see eph_key_pool.h
+ */
+
+#include <ctime>
+#include "logging.h"
+#include "security/crypto.h"
+#include "security/eph_key_pool.h"
+
+EphKeyPool::EphKeyPool(CipherSuite suite)
+        : suite(suite), target(0), low_water(0), hits(0), misses(0), refilled(0),
+          sleeping(false) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+bool EphKeyPool::start(size_t size){
+    if (size > EPH_KEY_POOL_MAX_SIZE){
+        size = EPH_KEY_POOL_MAX_SIZE;
+    }
+    if (size == 0 || target != 0){
+        return false;
+    }
+    target = size;
+    low_water = (size+1)/2;
+
+    if (pthread_create(&thread, NULL, refillThread, this) != 0){
+        LOG_PERROR(LOG_ERR, "Could not start the key pool thread: %s");
+        target = 0;
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+void* EphKeyPool::refillThread(void* arg){
+    ((EphKeyPool*) arg)->refill();
+    return NULL;
+}
+
+void EphKeyPool::refill(){
+    Stats last = getStats();
+    struct timespec next_log;
+    clock_gettime(CLOCK_REALTIME, &next_log);
+    next_log.tv_sec += EPH_KEY_POOL_LOG_INTERVAL;
+
+    while (1){
+        bool failed = false;
+        while (keys.size() < target){
+            EVP_PKEY* key = NULL;
+            try{
+                get_eph_key(suite, &key);
+            } catch(const char* msg){
+                LOG(LOG_ERR, "%s key pool: %s", suite_name(suite), msg);
+                failed = true;
+                break;
+            }
+            if (!keys.push(key)){
+                EVP_PKEY_free(key);
+                break;
+            }
+            __atomic_fetch_add(&refilled, 1, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_lock(&mutex);
+        __atomic_store_n(&sleeping, true, __ATOMIC_SEQ_CST);
+        // pairs with the fence in take(): either we see the taken key or the
+        // consumer sees us sleeping
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        // after an error, retry at the next interval
+        if (failed || keys.size() >= low_water){
+            pthread_cond_timedwait(&cond, &mutex, &next_log);
+        }
+        __atomic_store_n(&sleeping, false, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&mutex);
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec >= next_log.tv_sec){
+            logStats(&last, EPH_KEY_POOL_LOG_INTERVAL);
+            next_log.tv_sec = now.tv_sec + EPH_KEY_POOL_LOG_INTERVAL;
+        }
+    }
+}
+
+void EphKeyPool::take(EVP_PKEY** key){
+    if (!keys.tryPull(key)){
+        __atomic_fetch_add(&misses, 1, __ATOMIC_RELAXED);
+        EVP_PKEY* new_key = NULL;
+        get_eph_key(suite, &new_key);
+        *key = new_key;
+        return;
+    }
+    __atomic_fetch_add(&hits, 1, __ATOMIC_RELAXED);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (keys.size() < low_water && __atomic_load_n(&sleeping, __ATOMIC_SEQ_CST)){
+        pthread_mutex_lock(&mutex);
+        pthread_cond_signal(&cond);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+EphKeyPool::Stats EphKeyPool::getStats(){
+    Stats s;
+    s.hits = __atomic_load_n(&hits, __ATOMIC_RELAXED);
+    s.misses = __atomic_load_n(&misses, __ATOMIC_RELAXED);
+    s.refilled = __atomic_load_n(&refilled, __ATOMIC_RELAXED);
+    s.available = keys.size();
+    return s;
+}
+
+void EphKeyPool::logStats(Stats* last, double elapsed){
+    Stats s = getStats();
+    if (s.hits == last->hits && s.misses == last->misses
+            && s.refilled == last->refilled){
+        return;
+    }
+    LOG(LOG_INFO, "%s key pool: %lu keys, %lu hits, %lu misses, %lu refilled "
+            "(%.1f keys/s)", suite_name(suite), (unsigned long) s.available,
+            (unsigned long) s.hits, (unsigned long) s.misses,
+            (unsigned long) s.refilled, (s.refilled - last->refilled)/elapsed);
+    *last = s;
+}
@@ -1,6 +1,19 @@
 #include "security/secure_socket_wrapper.h"
 #include "security/crypto_utils.h"
 
+EphKeyPool* SecureSocketWrapper::eph_keys[N_SUITES] = {
+    new EphKeyPool(SUITE_P256),
+    new EphKeyPool(SUITE_X25519)
+};
+
+BufferPool* SecureSocketWrapper::packets = new BufferPool(
+        AAD_SIZE + MAX_MSG_SIZE + TAG_SIZE, SEND_BUFFER_POOL_SIZE);
+
+void SecureSocketWrapper::setMaxMsgSize(msglen_t size){
+    SocketWrapper::setMaxMsgSize(size);
+    packets->setBufferSize(SEC_PACKET_BUFFER_SIZE);
+}
+
 SecureSocketWrapper::SecureSocketWrapper(X509* cert, EVP_PKEY* my_priv_key, X509_STORE* store)
 {
     sw = new SocketWrapper();
@@ -30,10 +43,22 @@ void SecureSocketWrapper::init(X509* cert, EVP_PKEY* my_priv_key, X509_STORE* st
     this->my_priv_key = my_priv_key;
     this->store = store;
     other_cert = NULL;
+    send_ctx = NULL;
+    recv_ctx = NULL;
+    suite = PREFERRED_SUITE;
     peer_authenticated = false;
     my_id = usernameFromCert(cert);
 }
 
+bool SecureSocketWrapper::startKeyPool(size_t size){
+    for (int i = 0; i < N_SUITES; i++){
+        if (!eph_keys[i]->start(size)){
+            return false;
+        }
+    }
+    return true;
+}
+
 SecureSocketWrapper::~SecureSocketWrapper(){
     delete sw;
 
@@ -44,6 +69,7 @@ SecureSocketWrapper::~SecureSocketWrapper(){
     if (other_eph_key != NULL){
         EVP_PKEY_free(other_eph_key);
     }
+    freeCipherContexts();
     // TODO free certs too?
 }
 
@@ -67,26 +93,21 @@ Message *SecureSocketWrapper::decryptMsg(SecureMessage *sm)
     LOG(LOG_DEBUG, "TAG");
     DUMP_BUFFER_HEX_DEBUG(sm->getTag(), TAG_SIZE);
 
-    char *buffer_pt = (char*) malloc(pt_len);
+    // the plaintext overwrites the ciphertext
+    char* buffer_pt = sm->getCt();
     char buffer_aad[AAD_SIZE];
 
-    if (!buffer_pt){
-        LOG_PERROR(LOG_ERR, "Malloc failed: %s");
-        return NULL;
-    }
-
     makeAAD(SECURE_MESSAGE, pt_len+TAG_SIZE+AAD_SIZE, buffer_aad);
     DUMP_BUFFER_HEX_DEBUG(buffer_aad, AAD_SIZE);
 
     updateRecvIV();
 
     try{
-        ret = aes_gcm_decrypt(sm->getCt(), pt_len, buffer_aad, AAD_SIZE,
-                                recv_key, recv_iv,
+        ret = aes_gcm_decrypt_ctx(recv_ctx, sm->getCt(), pt_len,
+                                buffer_aad, AAD_SIZE, recv_iv,
                                 buffer_pt, sm->getTag());
     } catch (const char *err_msg){
         LOG(LOG_ERR, "Error: %s", err_msg);
-        free(buffer_pt);
         return NULL;
     }
 
@@ -101,8 +122,6 @@ Message *SecureSocketWrapper::decryptMsg(SecureMessage *sm)
 
     Message *m = readMessage(buffer_pt, pt_len);
 
-    free(buffer_pt);
-
     if (m != NULL){
         LOG(LOG_INFO, "Decrypted message of type %s", m->getName().c_str());
     } else{
@@ -111,60 +130,52 @@ Message *SecureSocketWrapper::decryptMsg(SecureMessage *sm)
     return m;
 }
 
-SecureMessage *SecureSocketWrapper::encryptMsg(Message *m)
+msglen_t SecureSocketWrapper::encryptMsg(Message *m, char *packet)
 {
     if (!peer_authenticated)
-        return NULL;
+        return 0;
     int ret;
 
-    char buffer_pt[MAX_MSG_SIZE];
+    // packet: header (AAD) | plaintext, then ciphertext | tag
+    char* buffer_pt = packet + AAD_SIZE;
     msglen_t buf_len = m->write(buffer_pt);
     
-    if (buf_len > MAX_SEC_MSG_SIZE){
+    if (buf_len == 0 || buf_len > MAX_SEC_MSG_SIZE){
         LOG(LOG_ERR, "Message is too big: %s", m->getName().c_str());
-        return NULL;
+        return 0;
     }
 
-    char* buffer_ct = (char*) malloc(MAX_MSG_SIZE);
-    char* buffer_tag = (char*) malloc(TAG_SIZE);
-    char  buffer_aad[AAD_SIZE];
-
-    if (!buffer_ct || !buffer_tag){
-        LOG_PERROR(LOG_ERR, "Malloc failed: %s");
-        return NULL;
-    }
+    char* buffer_tag = buffer_pt + buf_len;
+    msglen_t pkt_len = AAD_SIZE + buf_len + TAG_SIZE;
 
     LOG(LOG_DEBUG, "Encrypting message of size %d", buf_len);
-    DUMP_BUFFER_HEX_DEBUG(buffer_pt, IV_SIZE);
+    DUMP_BUFFER_HEX_DEBUG(buffer_pt, buf_len);
 
     updateSendIV();
-    makeAAD(SECURE_MESSAGE, buf_len+TAG_SIZE+AAD_SIZE, buffer_aad);
-    DUMP_BUFFER_HEX_DEBUG(buffer_aad, AAD_SIZE);
+    makeAAD(SECURE_MESSAGE, pkt_len, packet);
+    DUMP_BUFFER_HEX_DEBUG(packet, AAD_SIZE);
     try{
-        ret = aes_gcm_encrypt(buffer_pt, buf_len, buffer_aad, AAD_SIZE,
-                              send_key, send_iv,
-                              buffer_ct, buffer_tag);
+        ret = aes_gcm_encrypt_ctx(send_ctx, buffer_pt, buf_len,
+                              packet, AAD_SIZE, send_iv,
+                              buffer_pt, buffer_tag);
     } catch(const char* err_msg){
         LOG(LOG_ERR, "Error: %s", err_msg);
-        free(buffer_ct);
-        free(buffer_tag);
-        return NULL;
+        return 0;
     }
 
-    LOG(LOG_DEBUG, "Message encrypted %d bytes with iv: ", ret);
-    DUMP_BUFFER_HEX_DEBUG(send_iv, IV_SIZE);
-    LOG(LOG_DEBUG, "and tag: ");
-    DUMP_BUFFER_HEX_DEBUG(buffer_tag, TAG_SIZE);
-    LOG(LOG_DEBUG, "SecureMessage of size %d", buf_len + 1 + TAG_SIZE);
-
     if (ret <= 0)
     {
         LOG(LOG_ERR, "Could not encrypt the message");
-        return NULL;
+        return 0;
     }
 
-    SecureMessage *sm = new SecureMessage(buffer_ct, ret, buffer_tag);
-    return sm;
+    LOG(LOG_DEBUG, "Message encrypted %d bytes with iv: ", ret);
+    DUMP_BUFFER_HEX_DEBUG(send_iv, IV_SIZE);
+    LOG(LOG_DEBUG, "and tag: ");
+    DUMP_BUFFER_HEX_DEBUG(buffer_tag, TAG_SIZE);
+    LOG(LOG_DEBUG, "SecureMessage of size %d", pkt_len);
+
+    return pkt_len;
 }
 
 void SecureSocketWrapper::makeAAD(MessageType msg_type, msglen_t len, char* aad){
@@ -233,6 +244,16 @@ int SecureSocketWrapper::handleClientHello(ClientHelloMessage* chm)
 {
     cl_nonce = chm->getNonce();
     other_eph_key = chm->getEphKey();
+
+    // answer with the suite of the client
+    suite = chm->getSuite();
+    if (!is_suite_key(suite, other_eph_key)){
+        LOG(LOG_ERR, "Client sent a key not matching the %s suite", 
+            suite_name(suite));
+        return -1;
+    }
+    LOG(LOG_DEBUG, "Using the %s suite", suite_name(suite));
+
     return sendServerHello();
 }
 
@@ -241,6 +262,11 @@ int SecureSocketWrapper::handleServerHello(ServerHelloMessage* shm)
     sv_nonce = shm->getNonce();
     other_eph_key = shm->getEphKey();
 
+    if (shm->getSuite() != suite || !is_suite_key(suite, other_eph_key)){
+        LOG(LOG_ERR, "Server did not accept the %s suite", suite_name(suite));
+        return -1;
+    }
+
     //Deriving the symmetric key
     generateKeys("client");
 
@@ -281,19 +307,26 @@ int SecureSocketWrapper::sendPlain(Message *msg)
 
 int SecureSocketWrapper::sendMsg(Message *msg)
 {
-    SecureMessage *sm = encryptMsg(msg);
-    if (!sm)
+    size_t size;
+    char* packet = packets->get(&size);
+    int ret = 1;
+
+    msglen_t len = encryptMsg(msg, packet);
+    if (len == 0)
     {
+        packets->put(packet, size);
         return 1;
     }
-    int ret = sw->sendMsg(sm);
-    delete sm;
-    if (ret == 0){
+    LOG(LOG_DEBUG, "Sending %s", msg->getName().c_str());
+    if (sw->sendPacket(packet, len) == 0){
         send_seq_num++;
-        return 0;
+        ret = 0;
     } else{
-        return 1;
+        LOG(LOG_ERR, "Error sending %s", msg->getName().c_str());
     }
+
+    packets->put(packet, size);
+    return ret;
 }
 
 int SecureSocketWrapper::sendCertRequest(){
@@ -303,15 +336,15 @@ int SecureSocketWrapper::sendCertRequest(){
 
 int SecureSocketWrapper::sendClientHello(){
     cl_nonce = get_rand();
-    get_ecdh_key(&my_eph_key);
+    eph_keys[suite]->take(&my_eph_key);
 
-    ClientHelloMessage chm(my_eph_key, cl_nonce, my_id, other_id);
+    ClientHelloMessage chm(my_eph_key, cl_nonce, my_id, other_id, suite);
     return sw->sendMsg(&chm);
 }
 
 int SecureSocketWrapper::sendServerHello(){
     sv_nonce = get_rand();
-    get_ecdh_key(&my_eph_key);
+    eph_keys[suite]->take(&my_eph_key);
 
     //Deriving the symmetric key
     generateKeys("server");
@@ -319,7 +352,8 @@ int SecureSocketWrapper::sendServerHello(){
     char *ds = NULL;
     int ret = makeSignature("server", &ds);
     if (ret > 0){
-        ServerHelloMessage shm(my_eph_key, sv_nonce, my_id, other_id, ds, ret); 
+        ServerHelloMessage shm(my_eph_key, sv_nonce, my_id, other_id, ds, ret,
+                               suite); 
         return sw->sendMsg(&shm);
     } else {
         return ret;
@@ -338,10 +372,6 @@ int SecureSocketWrapper::sendClientVerify(){
 }
 
 void SecureSocketWrapper::generateKeys(const char* role){
-    char *shared_secret = NULL;
-
-    int size = dhke(my_eph_key, other_eph_key, &shared_secret);
-
     const char* other_role;
     if (strcmp(role, "client") == 0){
         other_role = "server";
@@ -349,7 +379,12 @@ void SecureSocketWrapper::generateKeys(const char* role){
         other_role = "client";
     } else{
         LOG(LOG_ERR, "Wrong role %s", role);
+        return;
     }
+
+    char *shared_secret = NULL;
+
+    int size = dhke(my_eph_key, other_eph_key, &shared_secret);
     char my_key_str[11] = "key_";
     char other_key_str[11] = "key_";
     char my_iv_str[11] = "iv__";
@@ -382,6 +417,22 @@ void SecureSocketWrapper::generateKeys(const char* role){
     LOG(LOG_DEBUG, "Generated keys END --------");
 
     free(shared_secret);
+
+    // the key schedule is computed once for the whole connection
+    freeCipherContexts();
+    send_ctx = aes_gcm_new_ctx(send_key, 1);
+    recv_ctx = aes_gcm_new_ctx(recv_key, 0);
+}
+
+void SecureSocketWrapper::freeCipherContexts(){
+    if (send_ctx != NULL){
+        EVP_CIPHER_CTX_free(send_ctx);
+        send_ctx = NULL;
+    }
+    if (recv_ctx != NULL){
+        EVP_CIPHER_CTX_free(recv_ctx);
+        recv_ctx = NULL;
+    }
 }
 
 int SecureSocketWrapper::buildMsgToSign(const char* role, char* msg){
@@ -440,6 +491,11 @@ int SecureSocketWrapper::buildMsgToSign(const char* role, char* msg){
     }
     i += size;
 
+    // P-256 handshakes are signed as by the peers that predate the suites
+    if (suite != SUITE_P256){
+        msg[i++] = (char) suite;
+    }
+
     return i;
 }
 
@@ -494,6 +550,22 @@ int SecureSocketWrapper::handshakeClient(){
     }
     LOG(LOG_INFO, "Client Hello sent");
     ServerHelloMessage *shm = dynamic_cast<ServerHelloMessage*>(receiveMsg(SERVER_HELLO));
+    if (suite != SUITE_P256 && (shm == NULL || shm->getSuite() != suite)){
+        LOG(LOG_WARN, "Peer did not accept the %s suite, retrying with %s",
+            suite_name(suite), suite_name(SUITE_P256));
+        if (shm != NULL){
+            EVP_PKEY_free(shm->getEphKey());
+            delete shm;
+        }
+        EVP_PKEY_free(my_eph_key);
+        my_eph_key = NULL;
+        if (reconnect() != 0){
+            LOG(LOG_ERR, "Could not reconnect to the peer");
+            return 1;
+        }
+        suite = SUITE_P256;
+        return handshakeClient();
+    }
     if (shm == NULL || handleServerHello(shm) != 0){
         LOG(LOG_ERR, "Error handling ServerHello!");
         return 1;
@@ -572,6 +644,15 @@ int ClientSecureSocketWrapper::connectServer(SecureHost host)
     return csw->connectServer(host);
 }
 
+int ClientSecureSocketWrapper::reconnect()
+{
+    Host host(*csw->getOtherAddr());
+    delete csw;
+    csw = new ClientSocketWrapper();
+    sw = csw;
+    return csw->connectServer(host);
+}
+
 ServerSecureSocketWrapper::ServerSecureSocketWrapper(X509* cert, EVP_PKEY* my_priv_key, X509_STORE* store){
     ssw = new ServerSocketWrapper();
     sw = ssw;
@@ -580,12 +661,23 @@ ServerSecureSocketWrapper::ServerSecureSocketWrapper(X509* cert, EVP_PKEY* my_pr
 
 SecureSocketWrapper *ServerSecureSocketWrapper::acceptClient()
 {
-    return new SecureSocketWrapper(my_cert, my_priv_key, store, ssw->acceptClient());
+    SocketWrapper* client_sw = ssw->acceptClient();
+    if (client_sw == NULL)
+        return NULL;
+    return new SecureSocketWrapper(my_cert, my_priv_key, store, client_sw);
+}
+
+SecureSocketWrapper *ServerSecureSocketWrapper::wrapClient(int sd, struct sockaddr_in addr)
+{
+    return new SecureSocketWrapper(my_cert, my_priv_key, store, ssw->wrapClient(sd, addr));
 }
 
 SecureSocketWrapper *ServerSecureSocketWrapper::acceptClient(X509* other_cert)
 {
-    SecureSocketWrapper* sec_sw = new SecureSocketWrapper(my_cert, my_priv_key, store, ssw->acceptClient());
+    SocketWrapper* client_sw = ssw->acceptClient();
+    if (client_sw == NULL)
+        return NULL;
+    SecureSocketWrapper* sec_sw = new SecureSocketWrapper(my_cert, my_priv_key, store, client_sw);
     if (sec_sw->setOtherCert(other_cert))
         return sec_sw;
     else{
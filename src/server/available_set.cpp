@@ -0,0 +1,66 @@
+/**
+ * @file available_set.cpp
+ *
+ * @brief Implementation of available_set.h
+ *
+ * @see available_set.h
+ */
+
+#include <sstream>
+
+#include "available_set.h"
+#include "user.h"
+
+AvailableSet::AvailableSet(){
+    pthread_rwlock_init(&lock, NULL);
+}
+
+void AvailableSet::add(const string& username, User* u){
+    pthread_rwlock_wrlock(&lock);
+    users.insert(make_pair(username, u));
+    pthread_rwlock_unlock(&lock);
+}
+
+void AvailableSet::remove(const string& username, User* u){
+    pthread_rwlock_wrlock(&lock);
+    tree_t::iterator it = users.find(username);
+    if (it != users.end() && it->second == u){
+        users.erase(it);
+    }
+    pthread_rwlock_unlock(&lock);
+}
+
+string AvailableSet::list(const string& cursor, size_t offset, size_t max,
+                          string* next){
+    ostringstream os;
+    size_t n = 0;
+
+    pthread_rwlock_rdlock(&lock);
+    tree_t::iterator it = cursor.empty() ? users.find_by_order(offset)
+                                         : users.upper_bound(cursor);
+    string last;
+    for (; n < max && it != users.end(); ++it){
+        // a user can be disconnected by its event loop without its lock, it
+        // is removed from here shortly after
+        if (it->second->getState() != AVAILABLE){
+            continue;
+        }
+        if (n > 0){
+            os << ",";
+        }
+        os << it->first;
+        last = it->first;
+        n++;
+    }
+    *next = it != users.end() ? last : "";
+    pthread_rwlock_unlock(&lock);
+
+    return os.str();
+}
+
+size_t AvailableSet::size(){
+    pthread_rwlock_rdlock(&lock);
+    size_t n = users.size();
+    pthread_rwlock_unlock(&lock);
+    return n;
+}
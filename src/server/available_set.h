@@ -0,0 +1,72 @@
+/**
+ * @file available_set.h
+ *
+ * @brief Definition of the AvailableSet class
+ */
+
+#ifndef AVAILABLE_SET_H
+#define AVAILABLE_SET_H
+
+#include <pthread.h>
+#include <string>
+#include <functional>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+
+using namespace std;
+
+/** Prevent cross references between headers */
+class User;
+
+/**
+ * Index of the users in the AVAILABLE state, sorted by username.
+ *
+ * It is kept up to date by User::setState(), so that listing a page of
+ * available users does not scan the other users. The tree keeps the size of
+ * its subtrees, so both seeking a cursor (the last username of the previous
+ * page) and seeking an offset are O(log n) and a page is O(page size).
+ *
+ * Protected by a read-write lock: listings run in parallel.
+ */
+class AvailableSet{
+private:
+    typedef __gnu_pbds::tree<string, User*, less<string>, __gnu_pbds::rb_tree_tag,
+                             __gnu_pbds::tree_order_statistics_node_update> tree_t;
+
+    tree_t users;
+    pthread_rwlock_t lock;
+
+    /** Non copyable */
+    AvailableSet(const AvailableSet&);
+    AvailableSet& operator=(const AvailableSet&);
+public:
+    AvailableSet();
+
+    /**
+     * Adds a user under the given username.
+     */
+    void add(const string& username, User* u);
+
+    /**
+     * Removes a user, if the username belongs to it.
+     */
+    void remove(const string& username, User* u);
+
+    /**
+     * Returns a comma separated list of up to max users.
+     *
+     * @param cursor    the list starts after it, if not empty
+     * @param offset    the list starts at this position if there is no cursor
+     * @param max       maximum number of users
+     * @param next      set to the cursor of the next page, empty if there are
+     *                  no more users
+     */
+    string list(const string& cursor, size_t offset, size_t max, string* next);
+
+    /**
+     * Returns the number of available users.
+     */
+    size_t size();
+};
+
+#endif // AVAILABLE_SET_H
@@ -0,0 +1,275 @@
+/**
+ * @file epoll_loop.cpp
+ *
+ * @brief Implementation of epoll_loop.h
+ *
+ * @see epoll_loop.h
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "logging.h"
+#include "epoll_loop.h"
+
+/** Events watched on every connection */
+#define CONN_EVENTS (EPOLLIN | EPOLLRDHUP | EPOLLET)
+
+static bool setNonBlocking(int fd){
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+EpollLoop::Connection::Connection(EpollLoop* loop, User* user)
+        : loop(loop), user(user), fd(user->getSocketWrapper()->getDescriptor()),
+          out(loop->outbound_high_water), closed(false), writable_watched(false),
+          corked(false) {
+    pthread_mutex_init(&mutex, NULL);
+}
+
+EpollLoop::Connection::~Connection(){
+    pthread_mutex_destroy(&mutex);
+}
+
+int EpollLoop::Connection::send(const char* buf, size_t len){
+    int ret = 0;
+
+    pthread_mutex_lock(&mutex);
+    if (closed){
+        ret = 1;
+    } else if (!out.push(buf, len)){
+        // the client is not reading, drop it
+        LOG(LOG_WARN, "Outbound queue of fd %d is full (%lu bytes), disconnecting",
+            fd, (unsigned long) out.size());
+        shutdown(fd, SHUT_RDWR);
+        ret = 1;
+    } else if (!kick()){
+        ret = 1;
+    }
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+void EpollLoop::Connection::cork(){
+    pthread_mutex_lock(&mutex);
+    corked = true;
+    pthread_mutex_unlock(&mutex);
+}
+
+void EpollLoop::Connection::uncork(){
+    pthread_mutex_lock(&mutex);
+    corked = false;
+    if (!closed && !kick()){
+        user->setState(DISCONNECTED);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+bool EpollLoop::Connection::kick(){
+    if (corked || writable_watched || out.empty()){
+        return true;
+    }
+    // try to write it right away
+    if (!flush()){
+        return false;
+    }
+    if (!out.empty()){
+        watch(true);
+    }
+    return true;
+}
+
+bool EpollLoop::Connection::flush(){
+    struct iovec iov[MAX_WRITE_IOV];
+    struct msghdr msg;
+
+    while (!out.empty()){
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = out.fillIov(iov, MAX_WRITE_IOV);
+
+        ssize_t len = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (len < 0){
+            if (errno == EAGAIN || errno == EWOULDBLOCK){
+                // the rest is written on EPOLLOUT
+                return true;
+            } else if (errno == EINTR){
+                continue;
+            }
+            LOG_PERROR(LOG_WARN, "Error writing to socket: %s");
+            out.clear();
+            return false;
+        }
+        out.consume(len);
+    }
+    return true;
+}
+
+void EpollLoop::Connection::watch(bool writable){
+    writable_watched = writable;
+
+    struct epoll_event ev;
+    ev.events = CONN_EVENTS | (writable ? EPOLLOUT : 0);
+    ev.data.ptr = this;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0){
+        LOG_PERROR(LOG_WARN, "Error modifying fd in epoll: %s");
+    }
+}
+
+EpollLoop::EpollLoop(ServerSecureSocketWrapper& server_sw, UserList& user_list,
+                     message_handler_t on_message, size_t outbound_high_water)
+        : server_sw(server_sw), user_list(user_list), on_message(on_message),
+          outbound_high_water(outbound_high_water) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0){
+        LOG_PERROR(LOG_ERR, "Error creating the epoll instance: %s");
+        throw "Error creating the epoll instance";
+    }
+
+    // all pending connections are accepted at every wakeup
+    int listen_fd = server_sw.getDescriptor();
+    if (!setNonBlocking(listen_fd)){
+        LOG_PERROR(LOG_ERR, "Error setting the socket non-blocking: %s");
+        close(epoll_fd);
+        throw "Error setting the socket non-blocking";
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = NULL; // NULL identifies the listening socket
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0){
+        LOG_PERROR(LOG_ERR, "Error watching the listening socket: %s");
+        close(epoll_fd);
+        throw "Error watching the listening socket";
+    }
+}
+
+EpollLoop::~EpollLoop(){
+    close(epoll_fd);
+}
+
+void EpollLoop::unwatch(Connection* c){
+    // no more writes from the workers after this
+    pthread_mutex_lock(&c->mutex);
+    c->closed = true;
+    c->out.clear();
+    pthread_mutex_unlock(&c->mutex);
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL) < 0){
+        LOG_PERROR(LOG_WARN, "Error removing fd from epoll: %s");
+    }
+    LOG(LOG_DEBUG, "Cleared fd %d", c->fd);
+    user_list.yield(c->user);
+}
+
+void EpollLoop::acceptClients(){
+    SecureSocketWrapper* sw;
+    while ((sw = server_sw.acceptClient()) != NULL){
+        int fd = sw->getDescriptor();
+        LOG(LOG_INFO, "New connection from %s",
+            sw->getConnectedHost().toString().c_str());
+
+        if (!setNonBlocking(fd)){
+            LOG_PERROR(LOG_ERR, "Error setting the socket non-blocking: %s");
+            delete sw;
+            continue;
+        }
+
+        User *u = new User(sw);
+        if (!user_list.add(u)){
+            LOG(LOG_WARN, "Too many users, connection refused");
+            delete u;
+            continue;
+        }
+        // reference of the event loop
+        user_list.get(fd);
+
+        Connection* c = new Connection(this, u);
+        sw->setSender(c);
+
+        struct epoll_event ev;
+        ev.events = CONN_EVENTS;
+        ev.data.ptr = c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0){
+            LOG_PERROR(LOG_ERR, "Error adding fd to epoll: %s");
+            u->setState(DISCONNECTED);
+            user_list.yield(u);
+        }
+    }
+}
+
+void EpollLoop::readFrom(Connection* c){
+    User* u = c->user;
+    LOG(LOG_INFO, "Available message from %s (%s)",
+        u->getUsername().c_str(),
+        u->getSocketWrapper()->getConnectedHost().toString().c_str());
+    try{
+        // edge-triggered: the socket must be drained
+        Message* m;
+        while ((m = u->getSocketWrapper()->readPartMsg()) != NULL){
+            on_message(c->user, m);
+        }
+    } catch(const char* msg){
+        LOG(LOG_WARN, "Client %s disconnected: %s",
+            u->getSocketWrapper()->getConnectedHost().toString().c_str(), msg);
+        u->setState(DISCONNECTED);
+    }
+}
+
+void EpollLoop::writeTo(Connection* c){
+    pthread_mutex_lock(&c->mutex);
+    if (!c->closed){
+        if (!c->flush()){
+            c->user->setState(DISCONNECTED);
+        } else if (c->out.empty()){
+            c->watch(false);
+        }
+    }
+    pthread_mutex_unlock(&c->mutex);
+}
+
+void EpollLoop::run(){
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+
+    LOG(LOG_INFO, "Polling open sockets");
+
+    while (1){
+        /* Block until input arrives on one or more active sockets. */
+        int n_events = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, -1);
+        if (n_events < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            LOG_PERROR(LOG_FATAL, "Error in epoll_wait: %s");
+            throw "Error in epoll_wait";
+        }
+
+        /* Service only the sockets that are ready. */
+        for (int k = 0; k < n_events; ++k){
+            Connection* c = (Connection*) events[k].data.ptr;
+            if (c == NULL){
+                acceptClients();
+                continue;
+            }
+
+            if (c->user->getState() == DISCONNECTED){
+                LOG(LOG_DEBUG, "Event from disconnected user with countRefs = %d",
+                    c->user->countRefs());
+                unwatch(c);
+                continue;
+            }
+            if (events[k].events & EPOLLOUT){
+                writeTo(c);
+            }
+            if (events[k].events & ~EPOLLOUT){
+                readFrom(c);
+            }
+            if (c->user->getState() == DISCONNECTED){
+                unwatch(c);
+            }
+        }
+    }
+}
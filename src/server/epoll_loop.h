@@ -0,0 +1,153 @@
+/**
+ * @file epoll_loop.h
+ *
+ * @brief Definition of the epoll event loop of the server
+ */
+
+#ifndef EPOLL_LOOP_H
+#define EPOLL_LOOP_H
+
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "config.h"
+#include "network/socket_wrapper.h"
+#include "security/secure_socket_wrapper.h"
+#include "user.h"
+#include "user_list.h"
+#include "outbound_queue.h"
+#include "event_loop.h"
+
+/**
+ * Event loop of the server based on edge-triggered epoll.
+ *
+ * The per-fd data of epoll points directly to the connection, so each wakeup
+ * only costs as much as the number of ready sockets.
+ *
+ * Sockets are non-blocking: workers write their messages directly if the
+ * socket has room, otherwise the rest is queued on the connection and
+ * written by the loop when the socket becomes writable (EPOLLOUT). A slow
+ * client never blocks a worker (and the users it has locked). A worker
+ * handling a batch of messages of a user corks its connection, so that all
+ * the replies are written with a single sendmsg.
+ *
+ * The loop holds a reference to every connected user until it stops watching
+ * its socket.
+ */
+class EpollLoop{
+private:
+    /**
+     * State of a connection, it is the sender of its socket wrapper.
+     *
+     * The outbound queue is protected by mutex, since workers write while
+     * the loop drains it.
+     */
+    class Connection : public MessageSender{
+    public:
+        EpollLoop* loop;
+        User* user;
+        int fd;
+        pthread_mutex_t mutex;
+
+        /** Bytes that could not be written yet */
+        OutboundQueue out;
+
+        /** The loop stopped watching the socket */
+        bool closed;
+
+        /** The loop waits for EPOLLOUT to write the queue */
+        bool writable_watched;
+
+        /** Writes are held back until uncork() */
+        bool corked;
+
+        Connection(EpollLoop* loop, User* user);
+        ~Connection();
+
+        int send(const char* buf, size_t len);
+        void cork();
+        void uncork();
+
+        /**
+         * Writes the queue unless it is corked or the loop is already
+         * waiting for the socket to become writable.
+         *
+         * The mutex must be held.
+         *
+         * @returns false in case of error
+         */
+        bool kick();
+
+        /**
+         * Writes as much of the queue as the socket takes.
+         *
+         * The mutex must be held.
+         *
+         * @returns false in case of error
+         */
+        bool flush();
+
+        /**
+         * Sets the events the loop waits for, EPOLLOUT is only watched
+         * while the queue is not empty.
+         */
+        void watch(bool writable);
+    };
+
+    int epoll_fd;
+    ServerSecureSocketWrapper& server_sw;
+    UserList& user_list;
+    message_handler_t on_message;
+
+    /** High-water mark of the outbound queues of the connections (bytes) */
+    size_t outbound_high_water;
+
+    /**
+     * Accepts all the pending connections and starts watching them.
+     */
+    void acceptClients();
+
+    /**
+     * Reads all the available messages of a connection.
+     */
+    void readFrom(Connection* c);
+
+    /**
+     * Writes the queued bytes of a connection.
+     */
+    void writeTo(Connection* c);
+
+    /**
+     * Stops watching the socket of a disconnected user and releases the
+     * reference held by the loop.
+     *
+     * c must not be used afterwards.
+     */
+    void unwatch(Connection* c);
+
+    /** Non copyable */
+    EpollLoop(const EpollLoop&);
+    EpollLoop& operator=(const EpollLoop&);
+
+public:
+    /**
+     * Creates the loop. Throws in case of error.
+     *
+     * @param server_sw     the listening socket, it is made non-blocking
+     * @param user_list     the list the new users are added to
+     * @param on_message    called with every received message
+     * @param outbound_high_water   maximum number of bytes queued on a
+     *                              connection, slower clients are dropped
+     */
+    EpollLoop(ServerSecureSocketWrapper& server_sw, UserList& user_list,
+              message_handler_t on_message, size_t outbound_high_water);
+
+    ~EpollLoop();
+
+    /**
+     * Runs the loop. Never returns.
+     */
+    void run();
+};
+
+#endif // EPOLL_LOOP_H
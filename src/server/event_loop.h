@@ -0,0 +1,24 @@
+/**
+ * @file event_loop.h
+ *
+ * @brief Definitions shared by the event loops of the server
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "network/messages.h"
+
+class User;
+
+/**
+ * Function called by the event loops for every received message
+ *
+ * The caller holds a reference to the user for the duration of the call.
+ *
+ * @param user  the sender
+ * @param msg   the message, to be deleted by the callee
+ */
+typedef void (*message_handler_t)(User* user, Message* msg);
+
+#endif // EVENT_LOOP_H
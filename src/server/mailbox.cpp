@@ -0,0 +1,49 @@
+/**
+ * @file mailbox.cpp
+ *
+ * @brief Implementation of mailbox.h
+ *
+ * @see mailbox.h
+ */
+
+#include "mailbox.h"
+
+Mailbox::Mailbox() : runnable(false) {
+    pthread_mutex_init(&mutex, NULL);
+}
+
+Mailbox::~Mailbox(){
+    for (size_t i = 0; i < messages.size(); ++i){
+        delete messages[i];
+    }
+    pthread_mutex_destroy(&mutex);
+}
+
+bool Mailbox::post(Message* m, size_t max_messages, bool* scheduled){
+    bool success;
+    pthread_mutex_lock(&mutex);
+    if ((success = messages.size() < max_messages)){
+        messages.push_back(m);
+        *scheduled = !runnable;
+        runnable = true;
+    } else {
+        *scheduled = false;
+    }
+    pthread_mutex_unlock(&mutex);
+    return success;
+}
+
+size_t Mailbox::take(Message** out, size_t max){
+    size_t n = 0;
+    pthread_mutex_lock(&mutex);
+    if (messages.empty()){
+        runnable = false;
+    } else {
+        while (n < max && !messages.empty()){
+            out[n++] = messages.front();
+            messages.pop_front();
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return n;
+}
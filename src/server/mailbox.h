@@ -0,0 +1,70 @@
+/**
+ * @file mailbox.h
+ *
+ * @brief Definition of the Mailbox class
+ */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <deque>
+#include <pthread.h>
+
+#include "network/messages.h"
+
+/**
+ * Messages of a user waiting to be handled, in arrival order.
+ *
+ * A mailbox is either idle or runnable: it becomes runnable when a message is
+ * posted to an idle mailbox (the poster must then schedule it) and goes back
+ * idle when the worker running it takes from it and finds it empty. Since
+ * only one worker at a time runs a runnable mailbox, the messages of a user
+ * are handled one at a time and in order.
+ */
+class Mailbox{
+private:
+    std::deque<Message*> messages;
+    pthread_mutex_t mutex;
+    bool runnable;
+
+    /** Non copyable */
+    Mailbox(const Mailbox&);
+    Mailbox& operator=(const Mailbox&);
+public:
+    /**
+     * Initializes an empty, idle mailbox.
+     */
+    Mailbox();
+
+    /**
+     * Deletes the messages that have not been handled.
+     */
+    ~Mailbox();
+
+    /**
+     * Adds a message at the end of the mailbox.
+     *
+     * @param m             the message
+     * @param max_messages  maximum number of waiting messages
+     * @param scheduled     set to true if the mailbox was idle and must be
+     *                      scheduled by the caller
+     * @returns false if the mailbox is full, in which case the message is not
+     *          added
+     */
+    bool post(Message* m, size_t max_messages, bool* scheduled);
+
+    /**
+     * Takes up to max messages from the front of the mailbox with a single
+     * lock. If there is none, the mailbox becomes idle.
+     *
+     * Must only be called by the worker running the mailbox.
+     *
+     * @param out   where the messages are stored, in order
+     * @param max   maximum number of messages to take
+     * @returns the number of messages taken, 0 if the mailbox is empty (and
+     *          now idle)
+     */
+    size_t take(Message** out, size_t max);
+};
+
+#endif // MAILBOX_H
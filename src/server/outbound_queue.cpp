@@ -0,0 +1,72 @@
+/**
+ * @file outbound_queue.cpp
+ *
+ * @brief Implementation of outbound_queue.h
+ *
+ * @see outbound_queue.h
+ */
+
+#include "outbound_queue.h"
+
+bool OutboundQueue::push(const char* buf, size_t len){
+    if (bytes + len > high_water_mark){
+        return false;
+    }
+    packets.push_back(std::string(buf, len));
+    bytes += len;
+    return true;
+}
+
+int OutboundQueue::fillIov(struct iovec* iov, int max_iov){
+    int n = 0;
+    for (std::deque<std::string>::iterator it = packets.begin();
+            it != packets.end() && n < max_iov; ++it, ++n){
+        size_t skip = n == 0 ? offset : 0;
+        iov[n].iov_base = (void*) (it->data() + skip);
+        iov[n].iov_len = it->size() - skip;
+    }
+    return n;
+}
+
+void OutboundQueue::consume(size_t n){
+    bytes -= n;
+    while (n > 0){
+        size_t left = packets.front().size() - offset;
+        if (n < left){
+            offset += n;
+            return;
+        }
+        n -= left;
+        packets.pop_front();
+        offset = 0;
+    }
+}
+
+int OutboundQueue::lendIov(struct iovec* iov, int max_iov){
+    int n = fillIov(iov, max_iov);
+    lent = n > 0;
+    return n;
+}
+
+void OutboundQueue::sent(size_t n){
+    lent = false;
+    if (closed){
+        clear();
+    } else {
+        consume(n);
+    }
+}
+
+void OutboundQueue::close(){
+    if (lent){
+        closed = true;
+    } else {
+        clear();
+    }
+}
+
+void OutboundQueue::clear(){
+    packets.clear();
+    offset = 0;
+    bytes = 0;
+}
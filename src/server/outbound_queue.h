@@ -0,0 +1,107 @@
+/**
+ * @file outbound_queue.h
+ *
+ * @brief Definition of the queue of the outgoing bytes of a connection
+ */
+
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <deque>
+#include <string>
+#include <sys/uio.h>
+
+/**
+ * Packets waiting to be written to a non-blocking socket.
+ *
+ * Packets are written in order, the first one possibly partially. The queue
+ * is not thread safe: it is protected by the mutex of its connection.
+ *
+ * Writes can be synchronous (fillIov() and consume()) or asynchronous
+ * (lendIov() and sent()): in the latter case the kernel reads the packets
+ * after lendIov() returns, so they are kept until sent() even if the queue is
+ * closed meanwhile.
+ */
+class OutboundQueue{
+private:
+    std::deque<std::string> packets;
+
+    /** Bytes of the first packet already written */
+    size_t offset;
+
+    /** Bytes still to be written */
+    size_t bytes;
+
+    /** Maximum number of queued bytes */
+    size_t high_water_mark;
+
+    /** The packets described by lendIov() are used by a send in flight */
+    bool lent;
+
+    /** close() has been called while a send was in flight */
+    bool closed;
+
+public:
+    /**
+     * @param high_water_mark   maximum number of queued bytes
+     */
+    OutboundQueue(size_t high_water_mark)
+            : offset(0), bytes(0), high_water_mark(high_water_mark),
+              lent(false), closed(false) {}
+
+    /**
+     * Copies a packet at the end of the queue.
+     *
+     * @returns false if the packet would make the queue exceed the high-water
+     *          mark, in which case it is not queued
+     */
+    bool push(const char* buf, size_t len);
+
+    /**
+     * Describes the bytes to be written, in order.
+     *
+     * @param iov       the array to fill
+     * @param max_iov   the size of the array
+     * @returns the number of filled entries
+     */
+    int fillIov(struct iovec* iov, int max_iov);
+
+    /**
+     * Removes the first n bytes, after they have been written.
+     */
+    void consume(size_t n);
+
+    /**
+     * Same of fillIov() for an asynchronous send: the described packets are
+     * not freed until sent() is called.
+     */
+    int lendIov(struct iovec* iov, int max_iov);
+
+    /**
+     * Completes the send started by lendIov().
+     *
+     * @param n     written bytes, 0 if the send failed. If the queue has been
+     *              closed meanwhile, all the bytes are dropped instead.
+     */
+    void sent(size_t n);
+
+    /**
+     * Drops all the queued bytes, or defers it to sent() if a send is in
+     * flight.
+     */
+    void close();
+
+    /**
+     * Drops all the queued bytes.
+     */
+    void clear();
+
+    /** A send started by lendIov() has not completed yet */
+    bool isSending(){return lent;}
+
+    bool empty(){return bytes == 0;}
+
+    size_t size(){return bytes;}
+};
+
+#endif // OUTBOUND_QUEUE_H
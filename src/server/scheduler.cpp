@@ -0,0 +1,163 @@
+/**
+ * @file scheduler.cpp
+ *
+ * @brief Implementation of scheduler.h
+ *
+ * @see scheduler.h
+ */
+
+#include "logging.h"
+#include "scheduler.h"
+
+Scheduler::Scheduler(UserList& user_list, message_handler_t handler)
+        : workers(NULL), n_workers(0), mailbox_size(0), user_list(user_list),
+          handler(handler), next_worker(0), n_runnable(0), n_idle(0) {
+    pthread_mutex_init(&idle_mutex, NULL);
+    pthread_cond_init(&idle_cond, NULL);
+}
+
+int Scheduler::start(int n, size_t mailbox_size){
+    this->mailbox_size = mailbox_size;
+
+    workers = new Worker[n];
+    for (int i = 0; i < n; i++){
+        workers[i].scheduler = this;
+        workers[i].id = i;
+        workers[i].rng = 2463534242u + i;
+        pthread_mutex_init(&workers[i].mutex, NULL);
+    }
+
+    for (int i = 0; i < n; i++){
+        // workers are visible to the others before they start stealing
+        n_workers = i+1;
+        if (pthread_create(&workers[i].thread, NULL, workerThread, &workers[i]) != 0){
+            LOG(LOG_ERR, "Could not start worker %d", i);
+            n_workers = i;
+            break;
+        }
+    }
+    return n_workers;
+}
+
+void Scheduler::dispatch(User* u, Message* m){
+    bool scheduled;
+    if (!u->getMailbox()->post(m, mailbox_size, &scheduled)){
+        LOG(LOG_WARN, "Mailbox of user %s is full, disconnecting",
+            u->getUsername().c_str());
+        delete m;
+        u->setState(DISCONNECTED);
+        return;
+    }
+
+    if (scheduled){
+        // reference of the queue
+        user_list.acquire(u);
+        unsigned i = __atomic_fetch_add(&next_worker, 1, __ATOMIC_RELAXED);
+        schedule(u, &workers[i % n_workers]);
+    }
+}
+
+void Scheduler::schedule(User* u, Worker* w){
+    pthread_mutex_lock(&w->mutex);
+    w->queue.push_back(u);
+    pthread_mutex_unlock(&w->mutex);
+
+    __atomic_fetch_add(&n_runnable, 1, __ATOMIC_RELAXED);
+
+    // pairs with the fence of the idle workers: either the worker sees the
+    // mailbox or we see the worker, so the lock is only taken when a worker
+    // may be sleeping
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&n_idle, __ATOMIC_RELAXED) > 0){
+        pthread_mutex_lock(&idle_mutex);
+        pthread_cond_signal(&idle_cond);
+        pthread_mutex_unlock(&idle_mutex);
+    }
+}
+
+User* Scheduler::next(Worker* w){
+    User* u = NULL;
+
+    pthread_mutex_lock(&w->mutex);
+    if (!w->queue.empty()){
+        u = w->queue.front();
+        w->queue.pop_front();
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    // steal from a random victim, then from the following ones
+    if (u == NULL && n_workers > 1){
+        w->rng ^= w->rng << 13;
+        w->rng ^= w->rng >> 17;
+        w->rng ^= w->rng << 5;
+        int first = w->rng % n_workers;
+        for (int k = 0; k < n_workers && u == NULL; k++){
+            Worker* victim = &workers[(first + k) % n_workers];
+            if (victim == w){
+                continue;
+            }
+            pthread_mutex_lock(&victim->mutex);
+            if (!victim->queue.empty()){
+                u = victim->queue.back();
+                victim->queue.pop_back();
+            }
+            pthread_mutex_unlock(&victim->mutex);
+        }
+    }
+
+    if (u != NULL){
+        __atomic_fetch_sub(&n_runnable, 1, __ATOMIC_RELAXED);
+    }
+    return u;
+}
+
+void Scheduler::run(Worker* w, User* u){
+    Message* batch[MAILBOX_BATCH];
+    SecureSocketWrapper* sw = u->getSocketWrapper();
+    int handled = 0;
+
+    while (handled < MAILBOX_BATCH){
+        size_t n = u->getMailbox()->take(batch, MAILBOX_BATCH - handled);
+        if (n == 0){
+            // the mailbox is idle: whoever posts next schedules it again
+            user_list.yield(u);
+            return;
+        }
+
+        // the replies to the batch are written together
+        sw->cork();
+        for (size_t i = 0; i < n; i++){
+            handler(u, batch[i]);
+        }
+        sw->uncork();
+        handled += n;
+    }
+
+    // still runnable, give the others a chance
+    schedule(u, w);
+}
+
+void* Scheduler::workerThread(void* arg){
+    Worker* w = (Worker*) arg;
+    Scheduler* s = w->scheduler;
+
+    while (1){
+        User* u = s->next(w);
+        if (u != NULL){
+            s->run(w, u);
+            continue;
+        }
+
+        // n_runnable is checked with the lock held, so a signal sent after
+        // the fence cannot be lost
+        pthread_mutex_lock(&s->idle_mutex);
+        __atomic_fetch_add(&s->n_idle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&s->n_runnable, __ATOMIC_RELAXED) == 0){
+            pthread_cond_wait(&s->idle_cond, &s->idle_mutex);
+        }
+        __atomic_fetch_sub(&s->n_idle, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&s->idle_mutex);
+    }
+    return NULL;
+}
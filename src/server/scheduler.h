@@ -0,0 +1,130 @@
+/**
+ * @file scheduler.h
+ *
+ * @brief Definition of the scheduler of the worker threads
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <deque>
+#include <pthread.h>
+
+#include "config.h"
+#include "user.h"
+#include "user_list.h"
+#include "event_loop.h"
+
+/**
+ * Runs the mailboxes of the users on a pool of worker threads.
+ *
+ * Received messages are posted to the mailbox of their user and a mailbox
+ * that becomes runnable is queued to one of the workers. A worker handles the
+ * messages of a mailbox one after the other, so the messages of a user are
+ * never handled concurrently nor out of order and workers seldom contend on
+ * the lock of a user. After MAILBOX_BATCH messages the mailbox is queued
+ * again, so that a chatty user cannot starve the others.
+ *
+ * The waiting messages of a mailbox are taken as a batch with a single lock
+ * and the connection of the user is corked while they are handled, so that
+ * the replies are written together.
+ *
+ * Each worker has its own queue of runnable mailboxes: it takes from the
+ * front of its own queue and, when it is empty, steals from the back of the
+ * queue of another worker, so that all the workers are busy even when the
+ * load is uneven.
+ *
+ * A queued mailbox holds a reference to its user.
+ */
+class Scheduler{
+private:
+    struct Worker{
+        Scheduler* scheduler;
+        int id;
+        pthread_t thread;
+
+        /** Runnable users */
+        std::deque<User*> queue;
+        pthread_mutex_t mutex;
+
+        /** State of the xorshift generator choosing the victims */
+        uint32_t rng;
+    };
+
+    Worker* workers;
+    int n_workers;
+
+    /** Maximum number of messages waiting in a mailbox */
+    size_t mailbox_size;
+
+    UserList& user_list;
+    message_handler_t handler;
+
+    /** Next worker to queue a mailbox to */
+    unsigned next_worker;
+
+    /** Number of queued mailboxes, updated atomically */
+    size_t n_runnable;
+
+    /**
+     * Idle workers sleep on idle_cond. n_idle is updated atomically, so that
+     * schedule() only takes the lock when a worker is sleeping.
+     */
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t idle_cond;
+    int n_idle;
+
+    /**
+     * Queues a runnable mailbox to a worker and wakes up an idle worker.
+     */
+    void schedule(User* u, Worker* w);
+
+    /**
+     * Takes a runnable mailbox from the queue of w or, if it is empty, from
+     * the queue of another worker.
+     *
+     * @returns the user or NULL if there is none
+     */
+    User* next(Worker* w);
+
+    /**
+     * Handles up to MAILBOX_BATCH messages of u, in batches.
+     */
+    void run(Worker* w, User* u);
+
+    /**
+     * Entry point of the workers.
+     */
+    static void* workerThread(void* arg);
+
+    /** Non copyable */
+    Scheduler(const Scheduler&);
+    Scheduler& operator=(const Scheduler&);
+
+public:
+    /**
+     * @param user_list     the list of the users, used for references
+     * @param handler       called for every message
+     */
+    Scheduler(UserList& user_list, message_handler_t handler);
+
+    /**
+     * Starts the workers.
+     *
+     * @param n_workers     number of workers
+     * @param mailbox_size  maximum number of messages waiting in the mailbox
+     *                      of a user
+     * @returns the number of started workers
+     */
+    int start(int n_workers, size_t mailbox_size);
+
+    /**
+     * Posts a message to the mailbox of a user.
+     *
+     * The caller must hold a reference to the user. Users whose mailbox is
+     * full are disconnected.
+     */
+    void dispatch(User* u, Message* m);
+};
+
+#endif // SCHEDULER_H
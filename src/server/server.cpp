@@ -4,13 +4,18 @@
  * 
  * @brief Implementation of a 4-in-a-row online server
  * 
- * The select implementation was inspired by
- * https://www.gnu.org/software/libc/manual/html_node/Server-Example.html
+ * Sockets are watched with an edge-triggered epoll instance whose per-fd data
+ * points directly to the User, so each wakeup only costs as much as the number
+ * of ready sockets and the number of clients is not limited by FD_SETSIZE.
+ *
+ * Received messages are posted to the mailbox of their sender and handled by
+ * the workers in order, one mailbox at a time (see scheduler.h).
  *
  * @date 2020-05-23
  */
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <pthread.h>
 #include <map>
@@ -24,6 +29,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <sys/resource.h>
 
 #include "logging.h"
 #include "config.h"
@@ -32,21 +38,36 @@
 
 #include "user.h"
 #include "user_list.h"
-#include "utils/message_queue.h"
+#include "uring_loop.h"
+#include "epoll_loop.h"
+#include "scheduler.h"
+#include "server_config.h"
 
 #include "security/crypto_utils.h"
 
 using namespace std;
 
-typedef pair<int,Message*> msgqueue_t;
 typedef map<string,X509*> cert_map_t;
 
 static UserList user_list;
-static MessageQueue<msgqueue_t,MAX_QUEUE_LENGTH> message_queue;
-static pthread_t threads[N_THREADS];
 static cert_map_t cert_map;
 static X509* cert;
 
+/**
+ * An event loop thread with its own listening socket
+ */
+struct Reactor{
+    int id;
+    pthread_t thread;
+    ServerSecureSocketWrapper* server_sw;
+    bool use_uring;
+    size_t outbound_high_water;
+};
+
+/** The reactors, allocated at startup */
+static Reactor* reactors;
+static int n_reactors;
+
 void logUnexpectedMessage(User* u, Message* m){
     LOG(LOG_WARN, "User %s (state %d) was not expecting a message of type %d", 
         u->getUsername().c_str(), (int)u->getState(), (int)m->getType());
@@ -153,12 +174,14 @@ bool handleGameEndMessage(User* u, GameEndMessage* msg){
 }
 
 bool handleUsersListRequestMessage(User* u, UsersListRequestMessage* msg){
-    UsersListMessage ul_msg(user_list.listAvailableFromTo(msg->getOffset()));
+    string next;
+    string users = user_list.listAvailable(msg->getCursor(), msg->getOffset(), &next);
+    UsersListMessage ul_msg(users, next);
     return u->getSocketWrapper()->sendMsg(&ul_msg) == 0;
 }
 
 bool handleChallengeResponseMessage(User* u, ChallengeResponseMessage* msg){
-    bool res;
+    bool res = true;
     User *opponent = user_list.get(u->getOpponent());
     if (opponent == NULL || opponent == u){
         // opponent disconnected or invalid opponent -> cancel
@@ -392,25 +415,27 @@ bool handleMessage(User* user, Message* raw_msg){
     return res;
 }
 
-void* worker(void *args){
-    while (1){
-        msgqueue_t p = message_queue.pullWait();
-        User* u = user_list.get(p.first);
-        if (u != NULL){
-            if (!handleMessage(u, p.second)){
-                // Connection error -> assume disconnected
-                u->setState(DISCONNECTED);
-            }
-            user_list.yield(u);
-        }
+/**
+ * Handles a message taken from the mailbox of a user by a worker.
+ */
+void worker(User* u, Message* m){
+    if (u->getState() == DISCONNECTED){
+        delete m;
+        return;
+    }
+    if (!handleMessage(u, m)){
+        // Connection error -> assume disconnected
+        u->setState(DISCONNECTED);
     }
-        
 }
 
-void init_threads(){
-    for (int i=0; i < N_THREADS; i++){
-        pthread_create(&threads[i], NULL, worker, NULL);
-    }
+static Scheduler scheduler(user_list, worker);
+
+/**
+ * Posts a message received by an event loop to the mailbox of its sender.
+ */
+void queueMessage(User* u, Message* m){
+    scheduler.dispatch(u, m);
 }
 
 bool checkCertsInCertMap(X509_STORE* store, cert_map_t cert_map){
@@ -428,13 +453,62 @@ bool checkCertsInCertMap(X509_STORE* store, cert_map_t cert_map){
 
 }
 
+/**
+ * Raises the limit of open files to the maximum allowed, so that the number of
+ * clients is not capped by the default soft limit (usually 1024).
+ */
+bool raiseFileLimit(){
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0){
+        return false;
+    }
+    rl.rlim_cur = rl.rlim_max;
+    return setrlimit(RLIMIT_NOFILE, &rl) == 0;
+}
+
+/**
+ * Entry point of the reactor threads.
+ */
+void* reactor(void *args){
+    Reactor* r = (Reactor*) args;
+
+    if (r->use_uring){
+        try{
+            UringLoop loop(*r->server_sw, user_list, queueMessage,
+                           r->outbound_high_water);
+            LOG(LOG_INFO, "Reactor %d is using the io_uring backend", r->id);
+            loop.run();
+        } catch(const char* msg){
+            LOG(LOG_FATAL, "Reactor %d: %s", r->id, msg);
+            exit(1);
+        }
+    }
+
+    try{
+        EpollLoop loop(*r->server_sw, user_list, queueMessage,
+                       r->outbound_high_water);
+        loop.run();
+    } catch(const char* msg){
+        LOG(LOG_FATAL, "Reactor %d: %s", r->id, msg);
+        exit(1);
+    }
+    return NULL;
+}
+
 int main(int argc, char** argv){
-    fd_set active_fd_set, read_fd_set;
+    ServerConfig config;
 
-    if (argc < 7){
-        cout<<"Usage: "<<argv[0]<<" port cert.pem key.pem cacert.pem crl.pem"<<endl;
+    if (argc < 7 || !config.parseArgs(argc-7, argv+7)){
+        cout<<"Usage: "<<argv[0]<<" port cert.pem key.pem cacert.pem crl.pem certs_dir"
+            <<" [--config FILE] [--epoll|--io-uring] [--workers N] [--max-users N]"
+            <<" [--max-queue-length N] [--max-msg-size BYTES]"
+            <<" [--eph-key-pool N] [--reactors N] [--outbound-high-water BYTES]"<<endl;
         exit(1);
     }
+    bool use_uring = config.use_uring;
+
+    user_list.setMaxUsers(config.max_users);
+    SecureSocketWrapper::setMaxMsgSize(config.max_msg_size);
 
     int port = atoi(argv[1]);
     cert = load_cert_file(argv[2]);
@@ -455,102 +529,58 @@ int main(int argc, char** argv){
 
     LOG(LOG_INFO, "Loaded certificates from %s", argv[6]);
 
-    ServerSecureSocketWrapper server_sw(cert, key, store);
+    n_reactors = config.reactors;
+    reactors = new Reactor[n_reactors];
+    for (int i = 0; i < n_reactors; i++){
+        reactors[i].id = i;
+        reactors[i].server_sw = new ServerSecureSocketWrapper(cert, key, store);
+        if (!reactors[i].server_sw->setReusePort()
+                || reactors[i].server_sw->bindPort(port) != 0){
+            LOG(LOG_FATAL, "Error binding to port %d", port);
+            exit(1);
+        }
+    }
+
+    LOG(LOG_INFO, "Binded %d sockets to port %d", n_reactors, port);
 
-    int ret = server_sw.bindPort(port);
-    if (ret != 0){
-        LOG(LOG_FATAL, "Error binding to port %d", port);
+    int n_workers = scheduler.start(config.workers, config.max_queue_length);
+    if (n_workers == 0){
+        LOG(LOG_FATAL, "Could not start the workers");
         exit(1);
     }
 
-    LOG(LOG_INFO, "Binded to port %d", port);
-
-    init_threads();
-
-    LOG(LOG_INFO, "Started %d worker threads", N_THREADS);
-
-    /* Initialize the set of active sockets. */
-    FD_ZERO(&active_fd_set);
-    FD_SET(server_sw.getDescriptor(), &active_fd_set);
-
-    LOG(LOG_INFO, "Polling open sockets");
-
-    while (1){
-        /* Block until input arrives on one or more active sockets. */
-        read_fd_set = active_fd_set;
-        if (select(FD_SETSIZE, &read_fd_set, NULL, NULL, NULL) < 0) {
-            if (errno == EBADF){ // clean closed sockets
-                LOG(LOG_DEBUG, "Bad file descriptor");
-                for (int i = 0; i < FD_SETSIZE; ++i){
-                    if (FD_ISSET(i, &active_fd_set)){
-                        if (i != server_sw.getDescriptor() 
-                                && !user_list.exists(i)
-                            ){
-                            // user was disconnected but I still need to clear it
-                            LOG(LOG_DEBUG, "Cleared fd %d", i);
-                            FD_CLR(i, &active_fd_set);
-                        }
-                    }
-                }
-                continue;
-            }
+    LOG(LOG_INFO, "Started %d worker threads", n_workers);
 
-            LOG_PERROR(LOG_FATAL, "Error in select: %s");
-            exit(1);
+    if (config.eph_key_pool > 0){
+        if (SecureSocketWrapper::startKeyPool(config.eph_key_pool)){
+            LOG(LOG_INFO, "Keeping %d ephemeral keys ready", config.eph_key_pool);
+        } else{
+            LOG(LOG_WARN, "Could not start the ephemeral key pool");
         }
+    }
 
-        /* Service all the sockets with input pending. */
-        for (int i = 0; i < FD_SETSIZE; ++i){
-            if (FD_ISSET(i, &read_fd_set)){
-                if (i == server_sw.getDescriptor()) {
-                    /* Connection request on original socket. */
-                    SecureSocketWrapper* sw = server_sw.acceptClient();
-
-                    LOG(LOG_INFO, "New connection from %s", 
-                        sw->getConnectedHost().toString().c_str());
+    if (!raiseFileLimit()){
+        LOG(LOG_WARN, "Could not raise the limit of open files");
+    }
 
-                    FD_SET(sw->getDescriptor(), &active_fd_set);
+    if (use_uring && !UringLoop::isSupported()){
+        LOG(LOG_INFO, "io_uring is not supported, falling back to epoll");
+        use_uring = false;
+    }
 
-                    User *u = new User(sw);
-                    user_list.add(u);
-                } else {
-                    User *u = user_list.get(i);
-                    if (u->getState() == DISCONNECTED){
-                        LOG(LOG_DEBUG, "Received message from disconnected user with countRefs = %d", u->countRefs());
-                        user_list.yield(u);
-                        FD_CLR(i, &active_fd_set); // ignore him
-                        continue;
-                    }
-                    const char* u_addr_str = u->getSocketWrapper()
-                            ->getConnectedHost().toString().c_str();
-                    LOG(LOG_INFO, "Available message from %s (%s)",
-                        u->getUsername().c_str(), u_addr_str);
-                    try{
-                        Message* m = u->getSocketWrapper()->readPartMsg();
-                        if (m != NULL)
-                            message_queue.pushSignal(msgqueue_t(i, m));
-                    } catch(const char* msg){
-                        LOG(LOG_WARN, "Client %s disconnected: %s", 
-                            u_addr_str, msg);
-                        u->setState(DISCONNECTED);
-                    }
-                    user_list.yield(u);
-                    if (!user_list.exists(i)){
-                        // user was disconnected -> clear it
-                        FD_CLR(i, &active_fd_set);
-                    }
-                }
-            } else if (FD_ISSET(i, &active_fd_set)){
-                if (i != server_sw.getDescriptor() 
-                                && !user_list.exists(i)
-                ){
-                    LOG(LOG_DEBUG, "Cleared fd %d", i);
-                    // user was disconnected but I still need to clear it
-                    FD_CLR(i, &active_fd_set);
-                }
-            }
+    for (int i = 0; i < n_reactors; i++){
+        reactors[i].use_uring = use_uring;
+        reactors[i].outbound_high_water = config.outbound_high_water;
+        if (pthread_create(&reactors[i].thread, NULL, reactor, &reactors[i]) != 0){
+            LOG(LOG_FATAL, "Could not start reactor %d", i);
+            exit(1);
         }
     }
-}
 
+    LOG(LOG_INFO, "Started %d reactors", n_reactors);
 
+    for (int i = 0; i < n_reactors; i++){
+        pthread_join(reactors[i].thread, NULL);
+    }
+    return 0;
+}
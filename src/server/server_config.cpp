@@ -0,0 +1,155 @@
+/**
+ * @file server_config.cpp
+ *
+ * @brief Implementation of server_config.h
+ *
+ * @see server_config.h
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <fstream>
+#include <unistd.h>
+
+#include "logging.h"
+#include "server_config.h"
+
+using namespace std;
+
+/**
+ * Parses a positive integer in [min, max].
+ */
+static bool parseInt(const string& value, int min, int max, int* out){
+    char* end;
+    errno = 0;
+    long n = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno != 0 || n < min || n > max){
+        return false;
+    }
+    *out = (int) n;
+    return true;
+}
+
+/**
+ * Removes leading and trailing whitespace.
+ */
+static string trim(const string& s){
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == string::npos){
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+ServerConfig::ServerConfig()
+        : max_users(MAX_USERS), max_queue_length(MAX_QUEUE_LENGTH),
+          max_msg_size(MAX_MSG_SIZE), use_uring(true),
+          eph_key_pool(EPH_KEY_POOL_SIZE), reactors(N_REACTORS),
+          outbound_high_water(MAX_OUTBOUND_BYTES) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = cpus > 0 ? (int) cpus : 1;
+}
+
+bool ServerConfig::set(const string& key, const string& value){
+    bool valid;
+
+    if (key == "max_users"){
+        valid = parseInt(value, 1, INT_MAX, &max_users);
+    } else if (key == "max_queue_length"){
+        valid = parseInt(value, 1, INT_MAX, &max_queue_length);
+    } else if (key == "workers"){
+        valid = parseInt(value, 1, 1024, &workers);
+    } else if (key == "max_msg_size"){
+        valid = parseInt(value, MIN_MSG_SIZE, MAX_MSG_SIZE_LIMIT, &max_msg_size);
+    } else if (key == "reactors"){
+        valid = parseInt(value, 1, MAX_REACTORS, &reactors);
+    } else if (key == "outbound_high_water"){
+        valid = parseInt(value, MIN_MSG_SIZE, INT_MAX, &outbound_high_water);
+    } else if (key == "eph_key_pool"){
+        valid = parseInt(value, 0, EPH_KEY_POOL_MAX_SIZE, &eph_key_pool);
+    } else if (key == "backend"){
+        valid = value == "epoll" || value == "io_uring";
+        if (valid){
+            use_uring = value == "io_uring";
+        }
+    } else{
+        LOG(LOG_ERR, "Unknown setting: %s", key.c_str());
+        return false;
+    }
+
+    if (!valid){
+        LOG(LOG_ERR, "Invalid value for %s: %s", key.c_str(), value.c_str());
+    }
+    return valid;
+}
+
+bool ServerConfig::loadFile(const char* path){
+    ifstream file(path);
+    if (!file.is_open()){
+        LOG(LOG_ERR, "Could not open config file %s", path);
+        return false;
+    }
+
+    string line;
+    int n = 0;
+    while (getline(file, line)){
+        n++;
+        size_t comment = line.find('#');
+        if (comment != string::npos){
+            line.erase(comment);
+        }
+        line = trim(line);
+        if (line.empty()){
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == string::npos){
+            LOG(LOG_ERR, "%s:%d: expected key = value", path, n);
+            return false;
+        }
+        if (!set(trim(line.substr(0, eq)), trim(line.substr(eq+1)))){
+            LOG(LOG_ERR, "%s:%d: invalid setting", path, n);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ServerConfig::parseArgs(int argc, char** argv){
+    // the file first, so that the other options override it
+    for (int i = 0; i < argc; i++){
+        if (strcmp(argv[i], "--config") == 0){
+            if (i+1 >= argc || !loadFile(argv[i+1])){
+                return false;
+            }
+        }
+    }
+
+    for (int i = 0; i < argc; i++){
+        if (strcmp(argv[i], "--epoll") == 0){
+            use_uring = false;
+        } else if (strcmp(argv[i], "--io-uring") == 0){
+            use_uring = true;
+        } else if (strcmp(argv[i], "--config") == 0){
+            i++;
+        } else if (strncmp(argv[i], "--", 2) == 0 && i+1 < argc){
+            string key(argv[i]+2);
+            for (size_t k = 0; k < key.size(); k++){
+                if (key[k] == '-'){
+                    key[k] = '_';
+                }
+            }
+            if (!set(key, argv[++i])){
+                return false;
+            }
+        } else{
+            LOG(LOG_ERR, "Invalid option: %s", argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
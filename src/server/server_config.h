@@ -0,0 +1,95 @@
+/**
+ * @file server_config.h
+ *
+ * @brief Definition of the ServerConfig class
+ */
+
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <string>
+
+#include "config.h"
+
+/**
+ * Runtime settings of the server.
+ *
+ * Settings start from their defaults, are then read from the config file (if
+ * any) and finally from the command line options, so that the options take
+ * precedence over the file.
+ *
+ * The config file has a "key = value" setting per line, '#' starts a comment:
+ *
+ *     # worker threads, defaults to the number of online CPUs
+ *     workers = 8
+ *     max_users = 100000
+ *     max_queue_length = 1000
+ *     max_msg_size = 4096
+ *     # event loop threads, each with its own listening socket
+ *     reactors = 4
+ *     # clients with more queued outgoing bytes are disconnected
+ *     outbound_high_water = 262144
+ *     backend = io_uring
+ *     # ephemeral keys generated in advance for the handshakes, 0 disables
+ *     eph_key_pool = 64
+ *
+ * Every key can also be given as an option, with dashes instead of
+ * underscores (e.g. --max-users 100000).
+ */
+class ServerConfig{
+public:
+    /** Maximum number of connected users */
+    int max_users;
+
+    /** Maximum number of messages waiting in the mailbox of a user */
+    int max_queue_length;
+
+    /** Number of worker threads */
+    int workers;
+
+    /** Maximum size of a message, at most MAX_MSG_SIZE_LIMIT */
+    int max_msg_size;
+
+    /** Whether the io_uring backend is used (if supported) instead of epoll */
+    bool use_uring;
+
+    /** Number of ephemeral keys generated in advance, 0 to disable */
+    int eph_key_pool;
+
+    /** Number of event loop threads, at most MAX_REACTORS */
+    int reactors;
+
+    /** Maximum number of bytes queued on a connection */
+    int outbound_high_water;
+
+    /**
+     * Initializes the defaults.
+     */
+    ServerConfig();
+
+    /**
+     * Sets a setting from its textual value.
+     *
+     * @returns false if the key is unknown or the value is not valid
+     */
+    bool set(const std::string& key, const std::string& value);
+
+    /**
+     * Reads the settings from a config file.
+     *
+     * @returns false if the file cannot be read or contains invalid settings
+     */
+    bool loadFile(const char* path);
+
+    /**
+     * Reads the settings from the command line options, loading the config
+     * file given with --config first.
+     *
+     * Options: --config FILE, --epoll, --io-uring and --<key> VALUE.
+     *
+     * @returns false in case of invalid options
+     */
+    bool parseArgs(int argc, char** argv);
+};
+
+#endif // SERVER_CONFIG_H
@@ -0,0 +1,368 @@
+/**
+ * @file uring_loop.cpp
+ *
+ * @brief Implementation of uring_loop.h
+ *
+ * The operation of a completion is encoded in the low bits of its user data,
+ * the rest is the pointer to the connection (NULL for the listening socket
+ * and the wakeup eventfd).
+ *
+ * @see uring_loop.h
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "logging.h"
+#include "uring_loop.h"
+
+#define OP_ACCEPT   0
+#define OP_RECV     1
+#define OP_SEND     2
+#define OP_WAKE     3
+#define OP_PROVIDE  4
+#define OP_MASK     7
+
+/** Group of the receive buffers */
+#define BUFFER_GROUP 0
+
+static uint64_t makeUserData(void* ptr, int op){
+    return (uint64_t) ptr | op;
+}
+
+UringLoop::Connection::Connection(UringLoop* loop, User* user)
+        : loop(loop), user(user), fd(user->getSocketWrapper()->getDescriptor()),
+          out(loop->outbound_high_water), recv_armed(false), queued(false),
+          closed(false), corked(false) {
+    pthread_mutex_init(&mutex, NULL);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+}
+
+UringLoop::Connection::~Connection(){
+    pthread_mutex_destroy(&mutex);
+}
+
+int UringLoop::Connection::send(const char* buf, size_t len){
+    bool wake;
+
+    pthread_mutex_lock(&mutex);
+    if (closed){
+        pthread_mutex_unlock(&mutex);
+        return 1;
+    }
+    if (!out.push(buf, len)){
+        // the client is not reading, drop it
+        LOG(LOG_WARN, "Outbound queue of fd %d is full (%lu bytes), disconnecting",
+            fd, (unsigned long) out.size());
+        pthread_mutex_unlock(&mutex);
+        shutdown(fd, SHUT_RDWR);
+        return 1;
+    }
+    wake = !queued && !corked;
+    if (wake){
+        queued = true;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (wake){
+        loop->schedule(this);
+    }
+    return 0;
+}
+
+void UringLoop::Connection::cork(){
+    pthread_mutex_lock(&mutex);
+    corked = true;
+    pthread_mutex_unlock(&mutex);
+}
+
+void UringLoop::Connection::uncork(){
+    bool wake;
+
+    pthread_mutex_lock(&mutex);
+    corked = false;
+    wake = !closed && !queued && !out.empty();
+    if (wake){
+        queued = true;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (wake){
+        loop->schedule(this);
+    }
+}
+
+UringLoop::UringLoop(ServerSecureSocketWrapper& server_sw, UserList& user_list,
+                     message_handler_t on_message, size_t outbound_high_water)
+        : ring(URING_ENTRIES, URING_CQ_ENTRIES), server_sw(server_sw),
+          user_list(user_list), on_message(on_message),
+          outbound_high_water(outbound_high_water) {
+    buffers = (char*) malloc((size_t) URING_N_BUFFERS*URING_BUFFER_SIZE);
+    if (buffers == NULL){
+        throw "Could not allocate the receive buffers";
+    }
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd < 0){
+        LOG_PERROR(LOG_ERR, "Error creating the eventfd: %s");
+        free(buffers);
+        throw "Error creating the eventfd";
+    }
+
+    pthread_mutex_init(&pending_mutex, NULL);
+}
+
+UringLoop::~UringLoop(){
+    pthread_mutex_destroy(&pending_mutex);
+    close(wake_fd);
+    free(buffers);
+}
+
+bool UringLoop::isSupported(){
+    const uint8_t ops[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+                           IORING_OP_READ, IORING_OP_PROVIDE_BUFFERS};
+    return IoUring::isSupported(ops, sizeof(ops)/sizeof(ops[0]));
+}
+
+void UringLoop::armAccept(){
+    accept_addrlen = sizeof(accept_addr);
+    ring.prepAccept(server_sw.getDescriptor(), (struct sockaddr*) &accept_addr,
+                    &accept_addrlen, makeUserData(NULL, OP_ACCEPT));
+}
+
+void UringLoop::armRecv(Connection* c){
+    c->recv_armed = true;
+    ring.prepRecvSelect(c->fd, URING_BUFFER_SIZE, BUFFER_GROUP,
+                        makeUserData(c, OP_RECV));
+}
+
+void UringLoop::armWake(){
+    ring.prepRead(wake_fd, &wake_buf, sizeof(wake_buf), makeUserData(NULL, OP_WAKE));
+}
+
+void UringLoop::provideBuffer(uint16_t bid){
+    ring.prepProvideBuffers(buffers + (size_t) bid*URING_BUFFER_SIZE,
+                            URING_BUFFER_SIZE, 1, BUFFER_GROUP, bid,
+                            makeUserData(NULL, OP_PROVIDE));
+}
+
+void UringLoop::schedule(Connection* c){
+    bool was_empty;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&pending_mutex);
+    was_empty = pending.empty();
+    pending.push_back(c);
+    pthread_mutex_unlock(&pending_mutex);
+
+    // the loop drains the whole list at every wakeup
+    if (was_empty && write(wake_fd, &one, sizeof(one)) != sizeof(one)){
+        LOG_PERROR(LOG_ERR, "Error waking up the event loop: %s");
+    }
+}
+
+void UringLoop::flush(Connection* c){
+    if (c->out.isSending() || c->closed || c->out.empty()){
+        return;
+    }
+
+    // the packets are kept by the queue until the send completes
+    int n = c->out.lendIov(c->iov, MAX_WRITE_IOV);
+    c->msg.msg_iovlen = n;
+    ring.prepSendmsg(c->fd, &c->msg, MSG_NOSIGNAL, makeUserData(c, OP_SEND));
+}
+
+void UringLoop::closeConnection(Connection* c){
+    pthread_mutex_lock(&c->mutex);
+    c->closed = true;
+    // the packets of a send in flight are dropped when it completes
+    c->out.close();
+    pthread_mutex_unlock(&c->mutex);
+
+    // wakes up the receive in flight
+    c->user->setState(DISCONNECTED);
+}
+
+void UringLoop::releaseIfDone(Connection* c){
+    pthread_mutex_lock(&c->mutex);
+    bool done = c->closed && !c->recv_armed && !c->out.isSending()
+                && !c->queued;
+    pthread_mutex_unlock(&c->mutex);
+
+    if (done){
+        LOG(LOG_DEBUG, "Cleared fd %d", c->fd);
+        user_list.yield(c->user);
+    }
+}
+
+void UringLoop::handleAccept(int res){
+    armAccept();
+
+    if (res < 0){
+        errno = -res;
+        LOG_PERROR(LOG_ERR, "Error accepting connection: %s");
+        return;
+    }
+
+    SecureSocketWrapper* sw = server_sw.wrapClient(res, accept_addr);
+    LOG(LOG_INFO, "New connection from %s",
+        sw->getConnectedHost().toString().c_str());
+
+    User* u = new User(sw);
+    if (!user_list.add(u)){
+        LOG(LOG_WARN, "Too many users, connection refused");
+        delete u;
+        return;
+    }
+    // reference of the event loop
+    user_list.get(res);
+
+    Connection* c = new Connection(this, u);
+    sw->setSender(c);
+    armRecv(c);
+}
+
+void UringLoop::handleRecv(Connection* c, int res, unsigned flags){
+    c->recv_armed = false;
+
+    if (res == -ENOBUFS){
+        // all the buffers are being parsed, they are given back right after
+        LOG(LOG_DEBUG, "No receive buffer available for fd %d", c->fd);
+        if (!c->closed){
+            armRecv(c);
+        }
+        return;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER){
+        uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        const char* data = buffers + (size_t) bid*URING_BUFFER_SIZE;
+        size_t len = res > 0 ? res : 0;
+
+        if (len > 0 && !c->closed && c->user->getState() != DISCONNECTED){
+            LOG(LOG_INFO, "Available message from %s (%s)",
+                c->user->getUsername().c_str(),
+                c->user->getSocketWrapper()->getConnectedHost().toString().c_str());
+            try{
+                Message* m;
+                while ((m = c->user->getSocketWrapper()->consumeBytes(&data, &len)) != NULL){
+                    on_message(c->user, m);
+                }
+            } catch(const char* msg){
+                LOG(LOG_WARN, "Client %s disconnected: %s",
+                    c->user->getSocketWrapper()->getConnectedHost().toString().c_str(),
+                    msg);
+                closeConnection(c);
+            }
+        }
+        provideBuffer(bid);
+    }
+
+    if (res <= 0 || c->user->getState() == DISCONNECTED){
+        if (res < 0){
+            errno = -res;
+            LOG_PERROR(LOG_WARN, "Error reading from socket: %s");
+        } else if (res == 0){
+            LOG(LOG_WARN, "Client %s disconnected: Connection lost",
+                c->user->getSocketWrapper()->getConnectedHost().toString().c_str());
+        }
+        if (!c->closed){
+            closeConnection(c);
+        }
+    } else if (!c->closed){
+        armRecv(c);
+    }
+    releaseIfDone(c);
+}
+
+void UringLoop::handleSend(Connection* c, int res){
+    pthread_mutex_lock(&c->mutex);
+    // drops the packets if the connection has been closed meanwhile
+    c->out.sent(res > 0 ? res : 0);
+    if (res < 0){
+        pthread_mutex_unlock(&c->mutex);
+        if (!c->closed){
+            errno = -res;
+            LOG_PERROR(LOG_WARN, "Error sending to socket: %s");
+            closeConnection(c);
+        }
+        releaseIfDone(c);
+        return;
+    }
+
+    // a partial send continues from where it stopped
+    flush(c);
+    pthread_mutex_unlock(&c->mutex);
+
+    releaseIfDone(c);
+}
+
+void UringLoop::handleWake(int res){
+    std::vector<Connection*> to_flush;
+
+    armWake();
+
+    pthread_mutex_lock(&pending_mutex);
+    to_flush.swap(pending);
+    pthread_mutex_unlock(&pending_mutex);
+
+    for (size_t i = 0; i < to_flush.size(); ++i){
+        Connection* c = to_flush[i];
+        pthread_mutex_lock(&c->mutex);
+        c->queued = false;
+        flush(c);
+        pthread_mutex_unlock(&c->mutex);
+        releaseIfDone(c);
+    }
+}
+
+void UringLoop::run(){
+    ring.prepProvideBuffers(buffers, URING_BUFFER_SIZE, URING_N_BUFFERS,
+                            BUFFER_GROUP, 0, makeUserData(NULL, OP_PROVIDE));
+    armAccept();
+    armWake();
+
+    while (1){
+        // submits everything prepared in the last round and waits
+        int ret = ring.submit(1);
+        if (ret < 0 && ret != -EBUSY){
+            errno = -ret;
+            LOG_PERROR(LOG_FATAL, "Error submitting to the io_uring: %s");
+            throw "Error submitting to the io_uring";
+        }
+
+        struct io_uring_cqe* cqe;
+        while ((cqe = ring.peekCqe()) != NULL){
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            ring.advanceCq();
+
+            Connection* c = (Connection*) (user_data & ~(uint64_t) OP_MASK);
+            switch (user_data & OP_MASK){
+                case OP_ACCEPT:
+                    handleAccept(res);
+                    break;
+                case OP_RECV:
+                    handleRecv(c, res, flags);
+                    break;
+                case OP_SEND:
+                    handleSend(c, res);
+                    break;
+                case OP_WAKE:
+                    handleWake(res);
+                    break;
+                case OP_PROVIDE:
+                    if (res < 0){
+                        errno = -res;
+                        LOG_PERROR(LOG_ERR, "Error providing receive buffers: %s");
+                    }
+                    break;
+            }
+        }
+    }
+}
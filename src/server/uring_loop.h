@@ -0,0 +1,174 @@
+/**
+ * @file uring_loop.h
+ *
+ * @brief Definition of the io_uring event loop of the server
+ */
+
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#include <vector>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "network/io_uring.h"
+#include "network/socket_wrapper.h"
+#include "security/secure_socket_wrapper.h"
+#include "user.h"
+#include "user_list.h"
+#include "outbound_queue.h"
+#include "event_loop.h"
+
+/**
+ * Event loop of the server based on io_uring.
+ *
+ * The loop keeps an accept and a receive per connection always in flight.
+ * Receives use buffers provided to the kernel once at startup, so no buffer
+ * is reserved for idle connections. Outgoing messages of the workers are
+ * queued on the connection and the loop sends all the queued messages of a
+ * connection with a single sendmsg, submitting the operations of all the
+ * connections with a single system call. A worker handling a batch of
+ * messages of a user corks its connection, so that the loop is woken up once
+ * per batch.
+ *
+ * The loop holds a reference to every connected user until all the operations
+ * on its socket are completed.
+ */
+class UringLoop{
+private:
+    /**
+     * State of a connection, it is the sender of its socket wrapper so that
+     * the messages sent by the workers are queued here.
+     *
+     * The fields are protected by mutex, since workers queue messages while
+     * the loop sends them.
+     */
+    class Connection : public MessageSender{
+    public:
+        UringLoop* loop;
+        User* user;
+        int fd;
+        pthread_mutex_t mutex;
+
+        /**
+         * Packets waiting to be sent, they also tell whether a sendmsg is in
+         * flight
+         */
+        OutboundQueue out;
+
+        /** Arguments of the sendmsg in flight */
+        struct iovec iov[MAX_WRITE_IOV];
+        struct msghdr msg;
+
+        /** A receive is in flight */
+        bool recv_armed;
+
+        /** The connection is in the pending list of the loop */
+        bool queued;
+
+        /** The connection is closed, no more operations are submitted */
+        bool closed;
+
+        /** The loop is not told about new messages until uncork() */
+        bool corked;
+
+        Connection(UringLoop* loop, User* user);
+        ~Connection();
+
+        int send(const char* buf, size_t len);
+        void cork();
+        void uncork();
+    };
+
+    IoUring ring;
+    ServerSecureSocketWrapper& server_sw;
+    UserList& user_list;
+    message_handler_t on_message;
+
+    /** High-water mark of the outbound queues of the connections (bytes) */
+    size_t outbound_high_water;
+
+    /** Address of the connection being accepted */
+    struct sockaddr_in accept_addr;
+    socklen_t accept_addrlen;
+
+    /** Receive buffers provided to the kernel */
+    char* buffers;
+
+    /** eventfd used by the workers to wake up the loop */
+    int wake_fd;
+    uint64_t wake_buf;
+
+    /** Connections with messages to send, filled by the workers */
+    std::vector<Connection*> pending;
+    pthread_mutex_t pending_mutex;
+
+    void armAccept();
+    void armRecv(Connection* c);
+    void armWake();
+    void provideBuffer(uint16_t bid);
+
+    /**
+     * Called by the workers to make the loop send the queued messages of c.
+     */
+    void schedule(Connection* c);
+
+    /**
+     * Sends the queued messages of c, if no send is already in flight.
+     *
+     * The mutex of c must be held.
+     */
+    void flush(Connection* c);
+
+    /**
+     * Shuts the connection down. Operations still in flight complete with
+     * an error.
+     */
+    void closeConnection(Connection* c);
+
+    /**
+     * Yields the reference of the loop to the user if the connection is
+     * closed and no operation is in flight.
+     *
+     * c must not be used afterwards.
+     */
+    void releaseIfDone(Connection* c);
+
+    void handleAccept(int res);
+    void handleRecv(Connection* c, int res, unsigned flags);
+    void handleSend(Connection* c, int res);
+    void handleWake(int res);
+
+    /** Non copyable */
+    UringLoop(const UringLoop&);
+    UringLoop& operator=(const UringLoop&);
+
+public:
+    /**
+     * Creates the loop. Throws if io_uring is not available.
+     *
+     * @param server_sw     the listening socket
+     * @param user_list     the list the new users are added to
+     * @param on_message    called with every received message
+     * @param outbound_high_water   maximum number of bytes queued on a
+     *                              connection, slower clients are dropped
+     */
+    UringLoop(ServerSecureSocketWrapper& server_sw, UserList& user_list,
+              message_handler_t on_message, size_t outbound_high_water);
+
+    ~UringLoop();
+
+    /**
+     * Checks whether the kernel supports all the needed io_uring operations.
+     */
+    static bool isSupported();
+
+    /**
+     * Runs the loop. Never returns.
+     */
+    void run();
+};
+
+#endif // URING_LOOP_H
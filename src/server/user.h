@@ -15,10 +15,13 @@
 #include <ctime>
 #include <pthread.h>
 #include <map>
+#include <sys/socket.h>
 
 #include "logging.h"
 #include "security/secure_socket_wrapper.h"
 #include "network/host.h"
+#include "mailbox.h"
+#include "available_set.h"
 
 /** Prevent cross references between headers */
 class UserList;
@@ -52,10 +55,19 @@ private:
     string opponent_username;
     pthread_mutex_t mutex;
 
+    /** Received messages waiting to be handled */
+    Mailbox mailbox;
+
+    /**
+     * Index of the available users, set by the UserList once the user is
+     * registered under its username
+     */
+    AvailableSet* available_set;
+
     /** 
      * Number of references to this user instance
      * 
-     * NB: this is updated ONLY by the UserList with its mutex
+     * NB: this is updated atomically and ONLY by the UserList
      */
     unsigned int references;
 
@@ -64,14 +76,18 @@ private:
      * 
      * Used by UserList.
      */
-    void increaseRefs(){references++;}
+    void increaseRefs(){__atomic_fetch_add(&references, 1, __ATOMIC_RELAXED);}
 
     /**
      * Decreases the reference count
      * 
      * Used by UserList.
+     * 
+     * @returns the new reference count
      */
-    void decreaseRefs(){references--;}
+    unsigned int decreaseRefs(){
+        return __atomic_sub_fetch(&references, 1, __ATOMIC_ACQ_REL);
+    }
 public:
     /** 
      * Contructor 
@@ -82,7 +98,7 @@ public:
     User(SecureSocketWrapper *sw) 
             : sw(sw), state(JUST_CONNECTED), 
                 username(""), opponent_username(""), 
-                references(0) {
+                available_set(NULL), references(0) {
         pthread_mutex_init(&mutex, NULL);
     }
 
@@ -121,6 +137,11 @@ public:
      */
     SecureSocketWrapper* getSocketWrapper(){return sw;}
 
+    /**
+     * Returns the mailbox of the received messages
+     */
+    Mailbox* getMailbox(){return &mailbox;}
+
     /**
      * Returns the current state of the user 
      */
@@ -128,11 +149,28 @@ public:
 
     /**
      * Sets the current state of the user
+     * 
+     * When the user is DISCONNECTED its socket is shut down, so that the
+     * event loop is woken up and stops watching it.
+     * 
+     * Registered users entering or leaving the AVAILABLE state are added to
+     * or removed from the index of the available users.
      */
     void setState(UserState state){
         LOG(LOG_DEBUG, "User %s (%d) is now in state %d", 
                 username.c_str(), sw->getDescriptor(), (int)state); 
+        UserState old_state = this->state;
         this->state=state;
+        if (available_set != NULL && old_state != state){
+            if (state == AVAILABLE){
+                available_set->add(username, this);
+            } else if (old_state == AVAILABLE){
+                available_set->remove(username, this);
+            }
+        }
+        if (state == DISCONNECTED){
+            shutdown(sw->getDescriptor(), SHUT_RDWR);
+        }
     }
 
     /**
@@ -148,7 +186,7 @@ public:
     /**
      * Returns the reference count
      */
-    int countRefs(){return references;}
+    int countRefs(){return __atomic_load_n(&references, __ATOMIC_ACQUIRE);}
 };
 
 #endif // USER_H
\ No newline at end of file
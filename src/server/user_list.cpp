@@ -7,137 +7,209 @@
  * @date 2020-05-23
  */
 
-#include <sstream>
 #include <string>
-#include <vector>
-#include <iterator>
-#include <iostream>
+#include <cstdlib>
 #include "user_list.h"
 #include "config.h"
 
 using namespace std;
 
-typedef map<string,User*>::iterator Iterator;
+typedef unordered_map<string,User*>::iterator Iterator;
 
-UserList::UserList(){
-    pthread_mutex_init(&mutex, NULL);
+UserList::UserList() : n_users(0), max_users(MAX_USERS) {
+    for (int i = 0; i < USER_LIST_SHARDS; i++){
+        pthread_rwlock_init(&shards[i].lock, NULL);
+    }
+    for (int i = 0; i < USER_LIST_FD_LOCKS; i++){
+        pthread_mutex_init(&fd_locks[i], NULL);
+    }
+    memset(fd_chunks, 0, sizeof(fd_chunks));
+}
+
+UserList::Shard* UserList::shardOf(const string& username){
+    return &shards[hash<string>()(username) % USER_LIST_SHARDS];
+}
+
+User** UserList::fdSlot(int fd, bool alloc){
+    if (fd < 0 || fd >= USER_LIST_FD_CHUNKS*USER_LIST_FD_CHUNK){
+        return NULL;
+    }
+
+    User*** chunk = &fd_chunks[fd / USER_LIST_FD_CHUNK];
+    User** slots = __atomic_load_n(chunk, __ATOMIC_ACQUIRE);
+    if (slots == NULL && alloc){
+        User** new_slots = (User**) calloc(USER_LIST_FD_CHUNK, sizeof(User*));
+        if (new_slots == NULL){
+            return NULL;
+        }
+        // the loser of a race frees its chunk
+        if (__atomic_compare_exchange_n(chunk, &slots, new_slots, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            slots = new_slots;
+        } else{
+            free(new_slots);
+        }
+    }
+    return slots == NULL ? NULL : &slots[fd % USER_LIST_FD_CHUNK];
 }
 
 bool UserList::add(User *u){
-    bool success;
-    pthread_mutex_lock(&mutex);
-    if ((success = user_map_by_fd.size() < MAX_USERS)){
-        user_map_by_fd.insert(
-            pair<int,User*>(u->getSocketWrapper()->getDescriptor(), u)
-        );
-        if (!u->getUsername().empty()){
-            user_map_by_username.insert(
-                pair<string,User*>(u->getUsername(), u)
-            );
+    int fd = u->getSocketWrapper()->getDescriptor();
+    pthread_mutex_t* fd_lock = fdLockOf(fd);
+    bool success = true;
+
+    pthread_mutex_lock(fd_lock);
+    User** slot = fdSlot(fd, true);
+    if (slot == NULL){
+        success = false;
+    } else if (*slot != u){
+        if (__atomic_add_fetch(&n_users, 1, __ATOMIC_RELAXED) > max_users){
+            __atomic_fetch_sub(&n_users, 1, __ATOMIC_RELAXED);
+            success = false;
+        } else{
+            *slot = u;
+        }
+    }
+
+    if (success && !u->getUsername().empty()){
+        Shard* shard = shardOf(u->getUsername());
+        pthread_rwlock_wrlock(&shard->lock);
+        bool inserted = shard->users.insert(
+            pair<string,User*>(u->getUsername(), u)).second;
+        pthread_rwlock_unlock(&shard->lock);
+
+        // from now on setState() keeps the user in the index
+        if (inserted && u->available_set == NULL){
+            u->available_set = &available;
+            if (u->getState() == AVAILABLE){
+                available.add(u->getUsername(), u);
+            }
         }
     }
-    pthread_mutex_unlock(&mutex);
+    pthread_mutex_unlock(fd_lock);
 
     return success;
 }
 
 User* UserList::get(string username){
     User* u = NULL;
-    pthread_mutex_lock(&mutex);
-    if (user_map_by_username.find(username) != user_map_by_username.end()){
-        u = user_map_by_username.at(username);
+    Shard* shard = shardOf(username);
+
+    pthread_rwlock_rdlock(&shard->lock);
+    Iterator it = shard->users.find(username);
+    if (it != shard->users.end()){
+        u = it->second;
         u->increaseRefs();
         LOG(LOG_DEBUG, "Thread %ld got reference to user %d",
             pthread_self(), u->getSocketWrapper()->getDescriptor()
         );
     }
-    pthread_mutex_unlock(&mutex);
+    pthread_rwlock_unlock(&shard->lock);
     return u;
 }
 
 User* UserList::get(int fd){
     User* u = NULL;
-    pthread_mutex_lock(&mutex);
-    if (user_map_by_fd.find(fd) != user_map_by_fd.end()){
-        u = user_map_by_fd.at(fd);
+    pthread_mutex_t* fd_lock = fdLockOf(fd);
+
+    pthread_mutex_lock(fd_lock);
+    User** slot = fdSlot(fd, false);
+    if (slot != NULL && *slot != NULL){
+        u = *slot;
         u->increaseRefs();
         LOG(LOG_DEBUG, "Thread %ld got reference to user %d",
-          pthread_self(), u->getSocketWrapper()->getDescriptor()
+          pthread_self(), fd
         );
     }
-    pthread_mutex_unlock(&mutex);
+    pthread_mutex_unlock(fd_lock);
     return u;
 }
 
+void UserList::acquire(User* u){
+    u->increaseRefs();
+}
+
 bool UserList::exists(string username){
     bool res;
-    pthread_mutex_lock(&mutex);
-    res = user_map_by_username.find(username) != user_map_by_username.end();
-    pthread_mutex_unlock(&mutex);
+    Shard* shard = shardOf(username);
+
+    pthread_rwlock_rdlock(&shard->lock);
+    res = shard->users.find(username) != shard->users.end();
+    pthread_rwlock_unlock(&shard->lock);
     return res;
 }
 
 bool UserList::exists(int fd){
     bool res;
-    pthread_mutex_lock(&mutex);
-    res = user_map_by_fd.find(fd) != user_map_by_fd.end();
-    pthread_mutex_unlock(&mutex);
+    pthread_mutex_t* fd_lock = fdLockOf(fd);
+
+    pthread_mutex_lock(fd_lock);
+    User** slot = fdSlot(fd, false);
+    res = slot != NULL && *slot != NULL;
+    pthread_mutex_unlock(fd_lock);
     return res;
 }
 
 void UserList::yield(User* u){
-    pthread_mutex_lock(&mutex);
-    u->decreaseRefs();
-    LOG(LOG_DEBUG, "Thread %ld yielded user %d (refcount: %d)",
-        pthread_self(), u->getSocketWrapper()->getDescriptor(), u->countRefs()
+    // u may be deleted by another thread as soon as the reference is dropped
+    int fd = u->getSocketWrapper()->getDescriptor();
+
+    unsigned int refs = u->decreaseRefs();
+    LOG(LOG_DEBUG, "Thread %ld yielded user %d (refcount: %u)",
+        pthread_self(), fd, refs
     );
-    if (u->countRefs() == 0 && u->getState() == DISCONNECTED){
-        if (user_map_by_username.find(u->getUsername()) 
-                != user_map_by_username.end()
-        ){
-            user_map_by_username.erase(u->getUsername());
-        }
-        if (user_map_by_fd.find(u->getSocketWrapper()->getDescriptor()) 
-                != user_map_by_fd.end()
-        ){
-            user_map_by_fd.erase(u->getSocketWrapper()->getDescriptor());
-        }
-        delete u;
+    if (refs == 0){
+        dispose(u, fd);
     }
-    pthread_mutex_unlock(&mutex);
 }
 
-string UserList::listAvailableFromTo(int from){
-    ostringstream os;
-    int n = 0;
-
-    pthread_mutex_lock(&mutex);
-    for (Iterator it = user_map_by_username.begin(); 
-        n < from+MAX_USERS_IN_MESSAGE && it != user_map_by_username.end();
-        ++it
-    ){
-        if (it->second->getState() == AVAILABLE){
-            if (n < from)
-                continue;
-
-            os << it->first;
-            if (n < from+MAX_USERS_IN_MESSAGE-1)
-                os << ",";
-            
-            n++;
+void UserList::dispose(User* u, int fd){
+    pthread_mutex_t* fd_lock = fdLockOf(fd);
+
+    pthread_mutex_lock(fd_lock);
+    User** slot = fdSlot(fd, false);
+
+    // u is valid as long as it is in the index and its lock is held, if it is
+    // not there anymore another thread has already deleted it
+    if (slot == NULL || *slot != u || u->countRefs() != 0
+            || u->getState() != DISCONNECTED){
+        pthread_mutex_unlock(fd_lock);
+        return;
+    }
+
+    // the username can be read safely: nobody holds a reference
+    string username = u->getUsername();
+    Shard* shard = NULL;
+    if (!username.empty()){
+        shard = shardOf(username);
+        pthread_rwlock_wrlock(&shard->lock);
+        // a reference may have been taken by username in the meantime
+        if (u->countRefs() != 0){
+            pthread_rwlock_unlock(&shard->lock);
+            pthread_mutex_unlock(fd_lock);
+            return;
         }
-        
+        Iterator it = shard->users.find(username);
+        // the username may belong to another user (e.g. failed registration)
+        if (it != shard->users.end() && it->second == u){
+            shard->users.erase(it);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+
+        available.remove(username, u);
     }
-    pthread_mutex_unlock(&mutex);
-    os << '\0';
 
-    return os.str();
+    *slot = NULL;
+    __atomic_fetch_sub(&n_users, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(fd_lock);
+
+    delete u;
+}
+
+string UserList::listAvailable(const string& cursor, int from, string* next){
+    return available.list(cursor, from < 0 ? 0 : from, MAX_USERS_IN_MESSAGE, next);
 }
 
 int UserList::size(){
-    int sz;
-    pthread_mutex_lock(&mutex);
-    sz = user_map_by_fd.size();
-    pthread_mutex_unlock(&mutex);
-    return sz;
-}
\ No newline at end of file
+    return (int) __atomic_load_n(&n_users, __ATOMIC_RELAXED);
+}
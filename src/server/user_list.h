@@ -11,35 +11,92 @@
 #define USER_LIST_H
 
 #include <pthread.h>
-#include <map>
 #include <cstring>
-#include <list>
+#include <string>
+#include <unordered_map>
 
 #include "config.h"
 #include "user.h"
+#include "available_set.h"
 
 using namespace std;
 
+/** Number of shards of the username index */
+#define USER_LIST_SHARDS 64
+
+/** Number of locks of the file descriptor index */
+#define USER_LIST_FD_LOCKS 64
+
+/** The file descriptor index is allocated in chunks of this many slots */
+#define USER_LIST_FD_CHUNK 4096
+
+/** Maximum number of chunks of the file descriptor index */
+#define USER_LIST_FD_CHUNKS 256
+
 /**
  * Class that manages the users.
  * 
- * 1) keeps track of connected users through two hash maps (one by username) and
- *    one by file descriptor of the socket the user is connected to.
+ * 1) keeps track of connected users through two indexes: one by username
+ *    and one by file descriptor of the socket the user is connected to.
  * 2) updates reference count of the users in order to safely delete 
  *    disconnected users only once no thread holds a reference to it.
  * 3) disposes of disconnected users that are no longer referenced by any   
  *    thread.
  * 
- * Every method in this class is protected against concurrent modifications by
- * a mutex.
+ * There is no global lock. The username index is a hash map split in
+ * USER_LIST_SHARDS shards, each with its own read-write lock, so lookups of
+ * different users do not contend and lookups of the same shard run in
+ * parallel. The file descriptor index is a flat array indexed by descriptor
+ * (allocated in chunks as descriptors grow) whose slots are protected by
+ * USER_LIST_FD_LOCKS striped mutexes.
  * 
- * The maximum number of users is defined by MAX_USERS.
+ * References are counted atomically: a new reference is only taken through
+ * an index, under the lock of the index, while a user is deleted only after
+ * it has been removed from both indexes with both locks held and its count
+ * has been found to be zero, so no reference can be taken to a deleted user.
+ * 
+ * The maximum number of users defaults to MAX_USERS.
  */
 class UserList{
 private:
-    map<string,User*> user_map_by_username;
-    map<int,User*> user_map_by_fd;
-    pthread_mutex_t mutex;
+    struct Shard{
+        pthread_rwlock_t lock;
+        unordered_map<string,User*> users;
+    };
+
+    Shard shards[USER_LIST_SHARDS];
+    pthread_mutex_t fd_locks[USER_LIST_FD_LOCKS];
+
+    /** Chunks of the file descriptor index, allocated on demand */
+    User** fd_chunks[USER_LIST_FD_CHUNKS];
+
+    /** Registered users in the AVAILABLE state */
+    AvailableSet available;
+
+    /** Number of users in the file descriptor index */
+    size_t n_users;
+    size_t max_users;
+
+    Shard* shardOf(const string& username);
+    pthread_mutex_t* fdLockOf(int fd){return &fd_locks[fd % USER_LIST_FD_LOCKS];}
+
+    /**
+     * Returns the slot of fd in the file descriptor index, allocating its
+     * chunk if alloc is true.
+     * 
+     * @returns the slot or NULL if fd is out of range or its chunk is not
+     *          allocated
+     */
+    User** fdSlot(int fd, bool alloc);
+
+    /**
+     * Deletes u if it is disconnected and no longer referenced.
+     */
+    void dispose(User* u, int fd);
+
+    /** Non copyable */
+    UserList(const UserList&);
+    UserList& operator=(const UserList&);
 public:
     /**
      * Initializes an empty list.
@@ -47,9 +104,16 @@ public:
     UserList();
 
     /**
-     * Inserts a new user to the internal hash maps.
+     * Sets the maximum number of users, to be called before adding any.
+     */
+    void setMaxUsers(size_t max_users){this->max_users = max_users;}
+
+    /**
+     * Inserts a new user to the indexes.
      * 
      * The user may not have a username but must have a file descriptor.
+     * Adding again a user that is already in the list adds its username
+     * (e.g. after registration). A username already taken is not replaced.
      * 
      * Calling this function does not increase the reference count of user since
      * it's assumed that either the reference is already held or that the user
@@ -82,6 +146,14 @@ public:
      */
     User* get(int fd);
 
+    /**
+     * Takes another reference to a user the caller already holds a
+     * reference to.
+     * 
+     * @param u the user
+     */
+    void acquire(User *u);
+
     /**
      * Checks whether there is a user matching the given username.
      * 
@@ -112,13 +184,18 @@ public:
     void yield(User *u);
 
     /**
-     * Returns a comma separated list of users in the AVAILABLE state, starting
-     * from the given offset.
+     * Returns a comma separated list of at most MAX_USERS_IN_MESSAGE users in
+     * the AVAILABLE state, sorted by username.
      * 
-     * @param from the offset
+     * @param cursor    the list starts after the cursor returned by the
+     *                  previous call, if not empty
+     * @param from      the offset the list starts from if there is no cursor
+     * @param next      set to the cursor of the next page, empty if there
+     *                  are no more users
      * @return the comma separated list of users as a string
+     * @see AvailableSet::list()
      */
-    string listAvailableFromTo(int from);
+    string listAvailable(const string& cursor, int from, string* next);
 
     /**
      * Returns the number of all users in the list.
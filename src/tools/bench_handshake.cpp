@@ -0,0 +1,256 @@
+/**
+ * @file bench_handshake.cpp
+ *
+ * @brief Benchmark of the ServerHello of the server
+ *
+ * Repeats the work the server does to answer a ClientHello: it generates the
+ * ephemeral ECDH key, derives the shared secret with the key of the client,
+ * derives the session keys and signs the handshake, with 1 to max_threads
+ * threads (doubling at every step).
+ *
+ * Each step is run three times: generating the curve parameters for every key,
+ * as get_ecdh_key() used to do, with the parameters shared by get_ecdh_key()
+ * and with the X25519 suite.
+ *
+ * The handshake is signed with a P-256 key (an Ed25519 key for the X25519
+ * suite), unless a PEM private key is given (e.g. certs/server_key.pem).
+ *
+ * Usage: bench_handshake [--handshakes N] [--max-threads T] [--key FILE]
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <pthread.h>
+#include "logging.h"
+#include "security/crypto.h"
+#include "security/crypto_utils.h"
+
+using namespace std;
+
+/**
+ * Returns the current time of the monotonic clock in seconds
+ */
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/**
+ * Generates an ECDH key generating the curve parameters first, like
+ * get_ecdh_key() did before caching them.
+ */
+static void get_ecdh_key_paramgen(EVP_PKEY **key){
+    EVP_PKEY *params = NULL;
+    EVP_PKEY_CTX *ctx_params = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    if (!ctx_params ||
+        EVP_PKEY_paramgen_init(ctx_params) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx_params, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_paramgen(ctx_params, &params) <= 0){
+        handleErrors();
+    }
+    EVP_PKEY_CTX_free(ctx_params);
+
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(params, NULL);
+    if (!ctx || EVP_PKEY_keygen_init(ctx) <= 0 || EVP_PKEY_keygen(ctx, key) <= 0){
+        handleErrors();
+    }
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(params);
+}
+
+/**
+ * Generates an Ed25519 key
+ */
+static void get_ed25519_key(EVP_PKEY **key){
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL);
+    if (!ctx || EVP_PKEY_keygen_init(ctx) <= 0 || EVP_PKEY_keygen(ctx, key) <= 0){
+        handleErrors();
+    }
+    EVP_PKEY_CTX_free(ctx);
+}
+
+/**
+ * Shared state of a run
+ */
+struct Run{
+    long handshakes_per_thread;
+    bool paramgen;
+    CipherSuite suite;
+
+    /** Ephemeral key of the client */
+    EVP_PKEY* client_key;
+
+    /** Key signing the handshake */
+    EVP_PKEY* sign_key;
+
+    /** Number of failed handshakes */
+    long errors;
+};
+
+/**
+ * Does the work of a ServerHello
+ *
+ * @returns true in case of success
+ */
+static bool serverHello(Run* r){
+    EVP_PKEY* eph_key = NULL;
+    char* secret = NULL;
+    char* ds = NULL;
+    char key[KEY_SIZE];
+    char iv[IV_SIZE];
+    char msg[2*sizeof(nonce_t) + 2*KEY_BIO_MAX_SIZE];
+    bool ok = true;
+
+    try{
+        nonce_t sv_nonce = get_rand();
+        nonce_t cl_nonce = get_rand();
+
+        if (r->paramgen){
+            get_ecdh_key_paramgen(&eph_key);
+        } else{
+            get_eph_key(r->suite, &eph_key);
+        }
+
+        // session keys
+        int size = dhke(eph_key, r->client_key, &secret);
+        hkdf(secret, size, sv_nonce, cl_nonce, (char*) "key_server", key, KEY_SIZE);
+        hkdf(secret, size, sv_nonce, cl_nonce, (char*) "key_client", key, KEY_SIZE);
+        hkdf(secret, size, sv_nonce, cl_nonce, (char*) "iv_server", iv, IV_SIZE);
+        hkdf(secret, size, sv_nonce, cl_nonce, (char*) "iv_client", iv, IV_SIZE);
+
+        // signature of the nonces and of the ephemeral keys
+        int i = 0;
+        memcpy(&msg[i], &cl_nonce, sizeof(cl_nonce));
+        i += sizeof(cl_nonce);
+        memcpy(&msg[i], &sv_nonce, sizeof(sv_nonce));
+        i += sizeof(sv_nonce);
+        i += pkey2buf(r->client_key, &msg[i], KEY_BIO_MAX_SIZE);
+        i += pkey2buf(eph_key, &msg[i], KEY_BIO_MAX_SIZE);
+        ok = dsa_sign(msg, i, &ds, r->sign_key) > 0;
+    } catch(const char* err){
+        LOG(LOG_ERR, "%s", err);
+        ok = false;
+    }
+
+    if (eph_key != NULL){
+        EVP_PKEY_free(eph_key);
+    }
+    free(secret);
+    free(ds);
+    return ok;
+}
+
+static void* worker(void* arg){
+    Run* r = (Run*) arg;
+    long errors = 0;
+    for (long i = 0; i < r->handshakes_per_thread; ++i){
+        if (!serverHello(r)){
+            errors++;
+        }
+    }
+    __atomic_fetch_add(&r->errors, errors, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/**
+ * Runs n_threads threads doing ServerHellos.
+ *
+ * @returns the throughput in handshakes per second, < 0 in case of errors
+ */
+static double bench(int n_threads, long handshakes, bool paramgen,
+                    CipherSuite suite, EVP_PKEY* client_key, EVP_PKEY* sign_key){
+    Run r;
+    r.handshakes_per_thread = handshakes/n_threads;
+    r.paramgen = paramgen;
+    r.suite = suite;
+    r.client_key = client_key;
+    r.sign_key = sign_key;
+    r.errors = 0;
+
+    vector<pthread_t> threads(n_threads);
+
+    double start = now();
+    for (int t = 0; t < n_threads; ++t){
+        pthread_create(&threads[t], NULL, worker, &r);
+    }
+    for (int t = 0; t < n_threads; ++t){
+        pthread_join(threads[t], NULL);
+    }
+    double elapsed = now() - start;
+
+    if (r.errors != 0){
+        LOG(LOG_ERR, "%ld handshakes failed", r.errors);
+        return -1;
+    }
+    return r.handshakes_per_thread*n_threads/elapsed;
+}
+
+int main(int argc, char** argv){
+    long handshakes = 2000;
+    int max_threads = 8;
+    const char* key_file = NULL;
+
+    for (int i = 1; i+1 < argc; i += 2){
+        if (strcmp(argv[i], "--handshakes") == 0){
+            handshakes = atol(argv[i+1]);
+        } else if (strcmp(argv[i], "--max-threads") == 0){
+            max_threads = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "--key") == 0){
+            key_file = argv[i+1];
+        } else {
+            cout<<"Usage: "<<argv[0]<<" [--handshakes N] [--max-threads T] [--key FILE]"<<endl;
+            return 1;
+        }
+    }
+
+    if (handshakes <= 0 || max_threads <= 0){
+        cout<<"Invalid arguments"<<endl;
+        return 1;
+    }
+
+    EVP_PKEY* client_key = NULL;
+    EVP_PKEY* sign_key = NULL;
+    EVP_PKEY* x_client_key = NULL;
+    EVP_PKEY* x_sign_key = NULL;
+    try{
+        get_ecdh_key(&client_key);
+        get_x25519_key(&x_client_key);
+        if (key_file != NULL){
+            sign_key = load_key_file(key_file, NULL);
+            x_sign_key = load_key_file(key_file, NULL);
+        } else{
+            get_ecdh_key(&sign_key);
+            get_ed25519_key(&x_sign_key);
+        }
+    } catch(const char* msg){
+        LOG(LOG_ERR, "%s", msg);
+        return 1;
+    }
+    if (sign_key == NULL || x_sign_key == NULL){
+        LOG(LOG_ERR, "Could not read the key from %s", key_file);
+        return 1;
+    }
+
+    cout<<"threads\tparamgen (ServerHello/s)\tcached (ServerHello/s)\tspeedup"
+        <<"\tx25519 (ServerHello/s)\tspeedup"<<endl;
+    for (int n = 1; n <= max_threads; n *= 2){
+        double paramgen = bench(n, handshakes, true, SUITE_P256, client_key, sign_key);
+        double cached = bench(n, handshakes, false, SUITE_P256, client_key, sign_key);
+        double x25519 = bench(n, handshakes, false, SUITE_X25519, x_client_key, x_sign_key);
+        if (paramgen < 0 || cached < 0 || x25519 < 0){
+            return 1;
+        }
+        cout<<n<<"\t"<<paramgen<<"\t\t\t"<<cached<<"\t\t\t"<<cached/paramgen
+            <<"\t"<<x25519<<"\t\t\t"<<x25519/cached<<endl;
+    }
+
+    EVP_PKEY_free(client_key);
+    EVP_PKEY_free(sign_key);
+    EVP_PKEY_free(x_client_key);
+    EVP_PKEY_free(x_sign_key);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file bench_queue.cpp
+ *
+ * @brief Benchmark of the message queue of the server
+ *
+ * Moves the same number of items through the lock-free MessageQueue and the
+ * mutex based MutexMessageQueue with 1 to max_threads producers and as many
+ * consumers (doubling at every step), as the event loops and the workers of
+ * the server do, and prints the throughput of both.
+ *
+ * Usage: bench_queue [--items N] [--max-threads T]
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <utility>
+#include <vector>
+#include <sched.h>
+#include <pthread.h>
+#include "config.h"
+#include "logging.h"
+#include "utils/message_queue.h"
+#include "utils/mutex_message_queue.h"
+
+using namespace std;
+
+/** Same item as the queue of the server */
+typedef pair<int,void*> item_t;
+
+/** Sent to the consumers to make them exit */
+#define STOP_ITEM -1
+
+/**
+ * Returns the current time of the monotonic clock in seconds
+ */
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/**
+ * Shared state of a run
+ */
+template <class Q>
+struct Run{
+    Q* queue;
+    long items_per_producer;
+
+    /** Sum of the received items, to check that nothing is lost */
+    long sum;
+};
+
+template <class Q>
+static void* producer(void* arg){
+    Run<Q>* r = (Run<Q>*) arg;
+    for (long i = 0; i < r->items_per_producer; ++i){
+        // like the server, do not wait if the queue is full
+        while (!r->queue->pushSignal(item_t(1, NULL))){
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+template <class Q>
+static void* consumer(void* arg){
+    Run<Q>* r = (Run<Q>*) arg;
+    long sum = 0;
+    while (1){
+        item_t e = r->queue->pullWait();
+        if (e.first == STOP_ITEM){
+            break;
+        }
+        sum += e.first;
+    }
+    __atomic_fetch_add(&r->sum, sum, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/**
+ * Runs n_threads producers and n_threads consumers.
+ *
+ * @returns the throughput in items per second, < 0 if items were lost
+ */
+template <class Q>
+static double bench(int n_threads, long items){
+    Q* queue = new Q();
+    Run<Q> r;
+    r.queue = queue;
+    r.items_per_producer = items/n_threads;
+    r.sum = 0;
+
+    vector<pthread_t> producers(n_threads), consumers(n_threads);
+
+    double start = now();
+    for (int t = 0; t < n_threads; ++t){
+        pthread_create(&consumers[t], NULL, consumer<Q>, &r);
+        pthread_create(&producers[t], NULL, producer<Q>, &r);
+    }
+    for (int t = 0; t < n_threads; ++t){
+        pthread_join(producers[t], NULL);
+    }
+    for (int t = 0; t < n_threads; ++t){
+        while (!queue->pushSignal(item_t(STOP_ITEM, NULL))){
+            sched_yield();
+        }
+    }
+    for (int t = 0; t < n_threads; ++t){
+        pthread_join(consumers[t], NULL);
+    }
+    double elapsed = now() - start;
+
+    delete queue;
+
+    long total = r.items_per_producer*n_threads;
+    if (r.sum != total){
+        LOG(LOG_ERR, "Received %ld items out of %ld", r.sum, total);
+        return -1;
+    }
+    return total/elapsed;
+}
+
+int main(int argc, char** argv){
+    long items = 1000000;
+    int max_threads = 32;
+
+    for (int i = 1; i+1 < argc; i += 2){
+        if (strcmp(argv[i], "--items") == 0){
+            items = atol(argv[i+1]);
+        } else if (strcmp(argv[i], "--max-threads") == 0){
+            max_threads = atoi(argv[i+1]);
+        } else {
+            cout<<"Usage: "<<argv[0]<<" [--items N] [--max-threads T]"<<endl;
+            return 1;
+        }
+    }
+
+    if (items <= 0 || max_threads <= 0){
+        cout<<"Invalid arguments"<<endl;
+        return 1;
+    }
+
+    cout<<"threads\tlock-free (M items/s)\tmutex (M items/s)"<<endl;
+    for (int n = 1; n <= max_threads; n *= 2){
+        double lock_free = bench< MessageQueue<item_t,MAX_QUEUE_LENGTH> >(n, items);
+        double mutex = bench< MutexMessageQueue<item_t,MAX_QUEUE_LENGTH> >(n, items);
+        if (lock_free < 0 || mutex < 0){
+            return 1;
+        }
+        cout<<n<<"\t"<<lock_free/1e6<<"\t\t\t"<<mutex/1e6<<endl;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file bench_win.cpp
+ *
+ * @brief Benchmark of the batched win check
+ *
+ * Fills many boards with random games and measures how many boards per
+ * second each implementation of hasAlignmentBatch() checks, compared with
+ * calling Connect4Bitboard::hasAlignment() on each board.
+ *
+ * Usage: bench_win [--boards N] [--rounds R] [--rows R] [--cols C]
+ */
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "config.h"
+#include "logging.h"
+#include "../client/connect4_bitboard.h"
+#include "../client/win_batch.h"
+
+using namespace std;
+
+/**
+ * Returns the current time of the monotonic clock in seconds
+ */
+static double now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/**
+ * Plays a random number of random moves, the game may be over.
+ */
+static void randomBoard(Connect4Bitboard* board){
+    char player = 'X';
+    int n_moves = rand() % (board->getNumRows()*board->getNumCols());
+    for (int i = 0; i < n_moves; ++i){
+        int col = rand() % board->getNumCols();
+        if (board->canPlay(col)){
+            board->makeMove(col, player);
+            player = player == 'X' ? 'O' : 'X';
+        }
+    }
+}
+
+static void printResult(const char* name, size_t n, int rounds, double elapsed,
+                        size_t wins){
+    cout<<name<<": "<<n*rounds/elapsed/1e6<<" M boards/s ("<<wins<<" wins)"<<endl;
+}
+
+int main(int argc, char** argv){
+    size_t n = 1 << 16;
+    int rounds = 200;
+    int rows = 6, cols = 7;
+
+    for (int i = 1; i+1 < argc; i += 2){
+        if (strcmp(argv[i], "--boards") == 0){
+            n = atol(argv[i+1]);
+        } else if (strcmp(argv[i], "--rounds") == 0){
+            rounds = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "--rows") == 0){
+            rows = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "--cols") == 0){
+            cols = atoi(argv[i+1]);
+        } else {
+            cout<<"Usage: "<<argv[0]<<" [--boards N] [--rounds R] [--rows R] [--cols C]"<<endl;
+            return 1;
+        }
+    }
+
+    if (n == 0 || rounds <= 0){
+        cout<<"Invalid arguments"<<endl;
+        return 1;
+    }
+
+    try{
+        vector<Connect4Bitboard> boards(n, Connect4Bitboard(rows, cols));
+        vector<bitboard_t> tokens(n);
+        vector<uint8_t> expected(n), results(n);
+
+        srand(42);
+        for (size_t i = 0; i < n; ++i){
+            randomBoard(&boards[i]);
+            tokens[i] = boards[i].getTokens('X');
+        }
+
+        // one board at a time
+        size_t wins = 0;
+        double start = now();
+        for (int r = 0; r < rounds; ++r){
+            for (size_t i = 0; i < n; ++i){
+                expected[i] = boards[i].hasAlignment(tokens[i]);
+            }
+        }
+        double elapsed = now() - start;
+        for (size_t i = 0; i < n; ++i){
+            wins += expected[i];
+        }
+        printResult("hasAlignment", n, rounds, elapsed, wins);
+
+        enum WinBatchImpl impls[] = {WIN_BATCH_SCALAR, WIN_BATCH_SSE2, WIN_BATCH_AVX2};
+        for (unsigned int k = 0; k < sizeof(impls)/sizeof(impls[0]); ++k){
+            if (!winBatchSupported(impls[k])){
+                cout<<winBatchName(impls[k])<<": not supported"<<endl;
+                continue;
+            }
+
+            start = now();
+            for (int r = 0; r < rounds; ++r){
+                hasAlignmentBatch(&tokens[0], n, rows, &results[0], impls[k]);
+            }
+            elapsed = now() - start;
+
+            if (memcmp(&results[0], &expected[0], n) != 0){
+                LOG(LOG_ERR, "%s results differ from the scalar ones",
+                    winBatchName(impls[k]));
+                return 1;
+            }
+            printResult(winBatchName(impls[k]), n, rounds, elapsed, wins);
+        }
+
+        // includes gathering the tokens from the boards
+        start = now();
+        for (int r = 0; r < rounds; ++r){
+            checkWinBatch(&boards[0], n, 'X', &results[0]);
+        }
+        elapsed = now() - start;
+        printResult("checkWinBatch", n, rounds, elapsed, wins);
+    } catch(const char* msg){
+        LOG(LOG_FATAL, "%s", msg);
+        return 1;
+    }
+
+    return 0;
+}
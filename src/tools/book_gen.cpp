@@ -0,0 +1,201 @@
+/**
+ * @file book_gen.cpp
+ *
+ * @brief Offline generator of the opening book of the AI
+ *
+ * The book contains, for every position with less than `plies` tokens that can
+ * be reached against the AI, the move the AI plays: at the AI turns only the
+ * chosen move is followed, at the opponent turns all the moves are. This is
+ * done once with the AI playing X and once with the AI playing O.
+ *
+ * Moves are chosen by the AI search, or by the perfect solver with --solve
+ * (much slower in the first plies).
+ *
+ * Usage: book_gen output.book [--plies N] [--time MS] [--depth D] [--solve]
+ *                             [--rows R] [--cols C] [--threads T] [--hash MB]
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+#include "config.h"
+#include "logging.h"
+#include "../client/connect4_bitboard.h"
+#include "../client/ai_player.h"
+#include "../client/opening_book.h"
+#include "../client/solver.h"
+
+using namespace std;
+
+/** Default number of plies covered by the book */
+#define DEFAULT_PLIES 8
+
+/** Default search time per position (ms) */
+#define DEFAULT_TIME_MS 2000
+
+struct Generator {
+    AIPlayer* ai;
+    /** Used instead of the AI if not NULL */
+    Solver* solver;
+    int plies;
+    /** Moves of the AI, by position key */
+    map<uint64_t, BookEntry> entries;
+    /** Positions already expanded in the current pass */
+    set<uint64_t> visited;
+};
+
+static char other(char player){
+    return player == 'X' ? 'O' : 'X';
+}
+
+/**
+ * Visits the positions reachable from the current one.
+ *
+ * @param gen       generator state
+ * @param board     current position
+ * @param side      player to move
+ * @param ai_side   player controlled by the AI
+ */
+static void expand(Generator& gen, Connect4Bitboard& board, char side, char ai_side){
+    if (board.getNumMoves() > gen.plies || board.isFull()){
+        return;
+    }
+
+    uint64_t key = board.getKey(side);
+    if (!gen.visited.insert(key).second){
+        return;
+    }
+
+    if (side == ai_side){
+        map<uint64_t, BookEntry>::iterator it = gen.entries.find(key);
+        if (it == gen.entries.end()){
+            BookEntry entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.key = key;
+            if (gen.solver != NULL){
+                int score;
+                entry.move = gen.solver->bestMove(board, side, &score);
+                entry.score = score;
+                entry.depth = board.getNumRows()*board.getNumCols() - board.getNumMoves();
+            } else {
+                entry.move = gen.ai->chooseMove(board, side);
+                entry.score = gen.ai->getLastScore();
+                entry.depth = gen.ai->getLastDepth();
+            }
+            it = gen.entries.insert(make_pair(key, entry)).first;
+
+            if (gen.entries.size() % 100 == 0){
+                cout<<gen.entries.size()<<" positions searched"<<endl;
+            }
+        }
+
+        int col = it->second.move;
+        if (!board.isWinningMove(col, side)){
+            board.makeMove(col, side);
+            expand(gen, board, other(side), ai_side);
+            board.undo();
+        }
+    } else {
+        for (int col = 0; col < board.getNumCols(); ++col){
+            if (board.canPlay(col) && !board.isWinningMove(col, side)){
+                board.makeMove(col, side);
+                expand(gen, board, other(side), ai_side);
+                board.undo();
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    int plies = DEFAULT_PLIES;
+    int time_ms = DEFAULT_TIME_MS;
+    int depth = 64;
+    int rows = 6, cols = 7;
+    int threads = 1;
+    int hash_mb = AI_DEFAULT_HASH_MB;
+    bool solve = false;
+
+    if (argc < 2){
+        cout<<"Usage: "<<argv[0]<<" output.book [--plies N] [--time MS] [--depth D] [--solve]"
+            <<" [--rows R] [--cols C] [--threads T] [--hash MB]"<<endl;
+        return 1;
+    }
+
+    for (int i = 2; i < argc; ++i){
+        if (strcmp(argv[i], "--solve") == 0){
+            solve = true;
+            continue;
+        } else if (i+1 == argc){
+            cout<<"Missing value of "<<argv[i]<<endl;
+            return 1;
+        }
+
+        int value = atoi(argv[++i]);
+        if (strcmp(argv[i-1], "--plies") == 0){
+            plies = value;
+        } else if (strcmp(argv[i-1], "--time") == 0){
+            time_ms = value;
+        } else if (strcmp(argv[i-1], "--depth") == 0){
+            depth = value;
+        } else if (strcmp(argv[i-1], "--rows") == 0){
+            rows = value;
+        } else if (strcmp(argv[i-1], "--cols") == 0){
+            cols = value;
+        } else if (strcmp(argv[i-1], "--threads") == 0){
+            threads = value;
+        } else if (strcmp(argv[i-1], "--hash") == 0){
+            hash_mb = value;
+        } else {
+            cout<<"Unknown option: "<<argv[i-1]<<endl;
+            return 1;
+        }
+    }
+
+    if (plies < 0 || plies > 255 || depth <= 0 || hash_mb <= 0){
+        cout<<"Invalid arguments"<<endl;
+        return 1;
+    }
+
+    try{
+        Connect4Bitboard board(rows, cols);
+        AIPlayer ai(depth, time_ms, hash_mb);
+        if (!ai.setThreads(threads)){
+            cout<<"Invalid number of threads"<<endl;
+            return 1;
+        }
+
+        // the book tells the moves of the first plies of the game, that is
+        // the moves played in positions with less than plies tokens
+        Solver* solver = solve ? new Solver(hash_mb) : NULL;
+
+        Generator gen;
+        gen.ai = &ai;
+        gen.solver = solver;
+        gen.plies = plies-1;
+        expand(gen, board, 'X', 'X');
+        gen.visited.clear();
+        expand(gen, board, 'X', 'O');
+
+        delete solver;
+
+        vector<BookEntry> entries;
+        entries.reserve(gen.entries.size());
+        for (map<uint64_t, BookEntry>::iterator it = gen.entries.begin();
+                it != gen.entries.end(); ++it){
+            entries.push_back(it->second);
+        }
+
+        if (!OpeningBook::write(argv[1], rows, cols, plies, entries)){
+            return 1;
+        }
+        cout<<"Wrote "<<entries.size()<<" positions to "<<argv[1]<<endl;
+    } catch(const char* msg){
+        LOG(LOG_FATAL, "%s", msg);
+        return 1;
+    }
+
+    return 0;
+}
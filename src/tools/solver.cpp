@@ -0,0 +1,189 @@
+/**
+ * @file solver.cpp
+ *
+ * @brief Command line interface of the perfect play solver
+ *
+ * In batch mode positions are read from stdin, one per line, as sequences of
+ * moves (columns numbered from 1, e.g. "4453"); anything after the sequence
+ * is ignored. For each position a line with the sequence and its score (and
+ * its best column with --best) is written to stdout, or "invalid" if the
+ * sequence is not valid.
+ *
+ * In benchmark mode each file is a test set made of lines with a sequence
+ * and its expected score, like the ones of the Pons benchmark
+ * (e.g. Test_L3_R1). The statistics of each set are written to stdout.
+ *
+ * Usage: solver [--weak] [--best] [--hash MB] [--rows R] [--cols C]
+ *               [--bench FILE...]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "config.h"
+#include "logging.h"
+#include "../client/connect4_bitboard.h"
+#include "../client/solver.h"
+
+using namespace std;
+
+/**
+ * Returns the current time of the monotonic clock in microseconds
+ */
+static int64_t nowUs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/**
+ * Solves the positions read from stdin.
+ */
+static int batch(Solver& solver, int rows, int cols, bool weak, bool best){
+    string line;
+    while (getline(cin, line)){
+        istringstream is(line);
+        string moves;
+        if (!(is >> moves)){
+            continue;
+        }
+
+        Connect4Bitboard board(rows, cols);
+        char side;
+        if (!Solver::playSequence(moves.c_str(), &board, &side)){
+            cout<<moves<<" invalid"<<endl;
+            continue;
+        }
+
+        if (best){
+            int score;
+            int col = solver.bestMove(board, side, &score);
+            if (weak){
+                score = score > 0 ? 1 : score < 0 ? -1 : 0;
+            }
+            cout<<moves<<" "<<score<<" "<<col+1<<endl;
+        } else {
+            cout<<moves<<" "<<solver.solve(board, side, weak)<<endl;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Solves all the positions of a test set and prints the statistics.
+ *
+ * @return false if the file could not be read or a score is wrong
+ */
+static bool bench(Solver& solver, const char* path, int rows, int cols, bool weak){
+    ifstream in(path);
+    if (!in){
+        cout<<path<<": could not open file"<<endl;
+        return false;
+    }
+
+    uint64_t positions = 0, wrong = 0, invalid = 0, nodes = 0;
+    int64_t elapsed_us = 0;
+    string line;
+
+    while (getline(in, line)){
+        istringstream is(line);
+        string moves;
+        int expected;
+        if (!(is >> moves >> expected)){
+            continue;
+        }
+
+        Connect4Bitboard board(rows, cols);
+        char side;
+        if (!Solver::playSequence(moves.c_str(), &board, &side)){
+            invalid++;
+            continue;
+        }
+        if (weak){
+            expected = expected > 0 ? 1 : expected < 0 ? -1 : 0;
+        }
+
+        // every position is solved from scratch
+        solver.reset();
+        solver.resetNodes();
+        int64_t start = nowUs();
+        int score = solver.solve(board, side, weak);
+        elapsed_us += nowUs() - start;
+        nodes += solver.getNodes();
+        positions++;
+
+        if (score != expected){
+            wrong++;
+            LOG(LOG_ERR, "%s: got %d, expected %d", moves.c_str(), score, expected);
+        }
+    }
+
+    double seconds = elapsed_us/1e6;
+    cout<<path<<": "<<positions<<" positions, "<<wrong<<" wrong, "
+        <<invalid<<" invalid"<<endl;
+    if (positions > 0){
+        cout<<"  mean time "<<elapsed_us/(double) positions<<" us, mean nodes "
+            <<nodes/(double) positions<<endl;
+        cout<<"  "<<(seconds > 0 ? positions/seconds : 0)<<" positions/s, "
+            <<(seconds > 0 ? nodes/seconds : 0)<<" nodes/s"<<endl;
+    }
+
+    return wrong == 0 && invalid == 0;
+}
+
+int main(int argc, char** argv){
+    bool weak = false, best = false, bench_mode = false;
+    int hash_mb = SOLVER_DEFAULT_HASH_MB;
+    int rows = 6, cols = 7;
+    int i;
+
+    for (i = 1; i < argc; ++i){
+        if (strcmp(argv[i], "--weak") == 0){
+            weak = true;
+        } else if (strcmp(argv[i], "--best") == 0){
+            best = true;
+        } else if (strcmp(argv[i], "--hash") == 0 && i+1 < argc){
+            hash_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rows") == 0 && i+1 < argc){
+            rows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cols") == 0 && i+1 < argc){
+            cols = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench") == 0){
+            bench_mode = true;
+            i++;
+            break;
+        } else {
+            cout<<"Usage: "<<argv[0]<<" [--weak] [--best] [--hash MB] [--rows R]"
+                <<" [--cols C] [--bench FILE...]"<<endl;
+            return 1;
+        }
+    }
+
+    if (hash_mb <= 0){
+        cout<<"Invalid table size"<<endl;
+        return 1;
+    }
+
+    try{
+        // checks the size of the board
+        Connect4Bitboard board(rows, cols);
+        Solver solver(hash_mb);
+
+        if (!bench_mode){
+            return batch(solver, rows, cols, weak, best);
+        }
+
+        bool ok = true;
+        for (; i < argc; ++i){
+            ok = bench(solver, argv[i], rows, cols, weak) && ok;
+        }
+        return ok ? 0 : 1;
+    } catch(const char* msg){
+        LOG(LOG_FATAL, "%s", msg);
+        return 1;
+    }
+}
@@ -0,0 +1,516 @@
+/**
+ * @file tournament.cpp
+ *
+ * @brief Headless tournament between AI configurations
+ *
+ * Every pair of engines plays the given number of games, switching colors at
+ * every game. Both games of a color swap start from the same random opening,
+ * so that deterministic engines do not play the same game over and over.
+ *
+ * Games are played in-process on a pool of threads, each thread with its own
+ * instance of every engine. At the end the win/draw/loss table of every pair
+ * and the time spent per move by every engine are printed.
+ *
+ * Engines are given as `type[:option,...]`, where type is `alphabeta` or
+ * `mcts` and the options are a difficulty level (easy, medium, hard, expert)
+ * or one of depth=N, time=MS, playouts=N, hash=MB, nodes=N.
+ * E.g.: `alphabeta:hard`, `alphabeta:depth=6`, `mcts:playouts=5000`.
+ *
+ * Boards that do not fit in a bitboard (e.g. 8x9) can only be played by
+ * mcts engines.
+ *
+ * Usage: tournament [--games N] [--threads T] [--openings K] [--rows R]
+ *                   [--cols C] [--seed S] [--out FILE] ENGINE ENGINE...
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#include "config.h"
+#include "logging.h"
+#include "../client/connect4.h"
+#include "../client/connect4_bitboard.h"
+#include "../client/ai_engine.h"
+#include "../client/ai_player.h"
+#include "../client/mcts_player.h"
+#include "../client/single_player.h"
+
+using namespace std;
+
+/** Default number of games per pair of engines */
+#define DEFAULT_GAMES 20
+
+/** Default number of random moves at the beginning of every game */
+#define DEFAULT_OPENINGS 2
+
+/** Depth used when only the time budget of alphabeta is given */
+#define UNLIMITED_DEPTH 64
+
+/**
+ * Configuration of an engine
+ */
+struct EngineConfig {
+    /** As given on the command line */
+    const char* name;
+
+    enum AIEngineType type;
+    Difficulty difficulty;
+
+    /** Custom limits, 0 if not given */
+    int depth;
+    int time_ms;
+    int playouts;
+
+    int hash_mb;
+    int nodes;
+};
+
+/**
+ * A game to be played
+ */
+struct Game {
+    /** Engines playing X and O */
+    int x, o;
+
+    /** Seed of the random opening */
+    uint64_t seed;
+
+    /** 1 if X won, -1 if O won, 0 for a draw */
+    int result;
+};
+
+/**
+ * Time spent by an engine
+ */
+struct MoveStats {
+    uint64_t moves;
+    double total_ms;
+    double max_ms;
+};
+
+struct Tournament;
+
+/**
+ * State of a thread
+ */
+struct Worker {
+    Tournament* t;
+    pthread_t thread;
+
+    /** Own instance of every engine */
+    vector<AIEngine*> engines;
+
+    /** Time spent by every engine */
+    vector<MoveStats> stats;
+};
+
+struct Tournament {
+    vector<EngineConfig> configs;
+    vector<Game> games;
+    int rows, cols;
+    int openings;
+
+    /** Index of the next game to be played, shared by the workers */
+    size_t next_game;
+};
+
+/**
+ * Returns the current time of the monotonic clock in milliseconds
+ */
+static double nowMs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000.0 + ts.tv_nsec/1e6;
+}
+
+static char other(char player){
+    return player == 'X' ? 'O' : 'X';
+}
+
+/**
+ * splitmix64 generator
+ */
+static uint64_t nextRandom(uint64_t* state){
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Parses an engine description.
+ *
+ * @return false if it is not valid
+ */
+static bool parseEngine(const char* spec, EngineConfig* config){
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)){
+        return false;
+    }
+    strcpy(buf, spec);
+
+    config->name = spec;
+    config->difficulty = HARD;
+    config->depth = 0;
+    config->time_ms = 0;
+    config->playouts = 0;
+    config->hash_mb = AI_DEFAULT_HASH_MB;
+    config->nodes = MCTS_DEFAULT_NODES;
+
+    char* options = strchr(buf, ':');
+    if (options != NULL){
+        *options++ = '\0';
+    }
+
+    if (strcmp(buf, "alphabeta") == 0){
+        config->type = ENGINE_ALPHABETA;
+    } else if (strcmp(buf, "mcts") == 0){
+        config->type = ENGINE_MCTS;
+    } else {
+        return false;
+    }
+
+    char* saveptr;
+    for (char* opt = options != NULL ? strtok_r(options, ",", &saveptr) : NULL;
+            opt != NULL; opt = strtok_r(NULL, ",", &saveptr)){
+        char* value = strchr(opt, '=');
+        if (value == NULL){
+            if (!parseDifficulty(opt, &config->difficulty)){
+                return false;
+            }
+            continue;
+        }
+
+        *value++ = '\0';
+        int n = atoi(value);
+        if (n <= 0){
+            return false;
+        }
+        if (strcmp(opt, "depth") == 0 && config->type == ENGINE_ALPHABETA){
+            config->depth = n;
+        } else if (strcmp(opt, "time") == 0){
+            config->time_ms = n;
+        } else if (strcmp(opt, "playouts") == 0 && config->type == ENGINE_MCTS){
+            config->playouts = n;
+        } else if (strcmp(opt, "hash") == 0 && config->type == ENGINE_ALPHABETA){
+            config->hash_mb = n;
+        } else if (strcmp(opt, "nodes") == 0 && config->type == ENGINE_MCTS){
+            config->nodes = n;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Creates an engine, throws if it cannot be allocated
+ */
+static AIEngine* createEngine(const EngineConfig& config){
+    if (config.type == ENGINE_MCTS){
+        if (config.playouts > 0 || config.time_ms > 0){
+            return new MCTSPlayer(config.playouts, config.time_ms, config.nodes);
+        }
+        return new MCTSPlayer(config.difficulty, config.nodes);
+    }
+
+    if (config.depth > 0 || config.time_ms > 0){
+        return new AIPlayer(config.depth > 0 ? config.depth : UNLIMITED_DEPTH,
+                            config.time_ms, config.hash_mb);
+    }
+    return new AIPlayer(config.difficulty, config.hash_mb);
+}
+
+/**
+ * Plays a game.
+ *
+ * @return 1 if X won, -1 if O won, 0 for a draw
+ */
+static int playGame(Worker& w, const Game& game){
+    Tournament& t = *w.t;
+    Connect4 board(t.rows, t.cols);
+    uint64_t rng = game.seed;
+    char side = 'X';
+    vector<int> playable(t.cols);
+
+    // random opening, never ending the game
+    for (int i = 0; i < t.openings && !board.isFull(); ++i){
+        int n = 0;
+        for (int col = 0; col < t.cols; ++col){
+            if (board.canPlay(col) && !board.isWinningMove(col, side)){
+                playable[n++] = col;
+            }
+        }
+        if (n == 0){
+            break;
+        }
+        board.makeMove(playable[nextRandom(&rng) % n], side);
+        side = other(side);
+    }
+
+    w.engines[game.x]->newGame();
+    w.engines[game.o]->newGame();
+
+    while (!board.isFull()){
+        int e = side == 'X' ? game.x : game.o;
+
+        double start = nowMs();
+        int col = w.engines[e]->chooseMove(board, side);
+        double elapsed = nowMs() - start;
+
+        MoveStats& stats = w.stats[e];
+        stats.moves++;
+        stats.total_ms += elapsed;
+        if (elapsed > stats.max_ms){
+            stats.max_ms = elapsed;
+        }
+
+        // an illegal move loses the game
+        if (!board.canPlay(col)){
+            LOG(LOG_ERR, "%s played the illegal column %d",
+                t.configs[e].name, col);
+            return side == 'X' ? -1 : 1;
+        }
+        if (board.isWinningMove(col, side)){
+            return side == 'X' ? 1 : -1;
+        }
+        board.makeMove(col, side);
+        side = other(side);
+    }
+    return 0;
+}
+
+static void* workerThread(void* arg){
+    Worker* w = (Worker*) arg;
+    Tournament* t = w->t;
+
+    while (1){
+        size_t i = __atomic_fetch_add(&t->next_game, 1, __ATOMIC_RELAXED);
+        if (i >= t->games.size()){
+            break;
+        }
+        t->games[i].result = playGame(*w, t->games[i]);
+    }
+    return NULL;
+}
+
+/**
+ * Prints the results table and the timing of every engine.
+ */
+static void printResults(ostream& os, Tournament& t, vector<Worker>& workers){
+    size_t m = t.configs.size();
+    // wins[i][j]: games won by i against j
+    vector<vector<int> > wins(m, vector<int>(m, 0)), draws(m, vector<int>(m, 0));
+
+    for (size_t i = 0; i < t.games.size(); ++i){
+        Game& g = t.games[i];
+        if (g.result == 1){
+            wins[g.x][g.o]++;
+        } else if (g.result == -1){
+            wins[g.o][g.x]++;
+        } else {
+            draws[g.x][g.o]++;
+            draws[g.o][g.x]++;
+        }
+    }
+
+    os<<"Engines:"<<endl;
+    for (size_t i = 0; i < m; ++i){
+        os<<"  ["<<i<<"] "<<t.configs[i].name<<endl;
+    }
+
+    os<<endl<<"Results (wins/draws/losses of the row engine):"<<endl;
+    os<<setw(6)<<"";
+    for (size_t j = 0; j < m; ++j){
+        os<<setw(14)<<("[" + to_string(j) + "]");
+    }
+    os<<endl;
+    for (size_t i = 0; i < m; ++i){
+        os<<setw(6)<<("[" + to_string(i) + "]");
+        for (size_t j = 0; j < m; ++j){
+            if (i == j){
+                os<<setw(14)<<"-";
+            } else {
+                os<<setw(14)<<(to_string(wins[i][j]) + "/" + to_string(draws[i][j])
+                               + "/" + to_string(wins[j][i]));
+            }
+        }
+        os<<endl;
+    }
+
+    os<<endl<<"Summary:"<<endl;
+    os<<setw(6)<<"engine"<<setw(8)<<"games"<<setw(8)<<"wins"<<setw(8)<<"draws"
+      <<setw(8)<<"losses"<<setw(8)<<"score"<<setw(10)<<"moves"
+      <<setw(12)<<"avg ms"<<setw(12)<<"max ms"<<endl;
+    for (size_t i = 0; i < m; ++i){
+        int n_wins = 0, n_draws = 0, n_losses = 0;
+        for (size_t j = 0; j < m; ++j){
+            n_wins += wins[i][j];
+            n_draws += draws[i][j];
+            n_losses += wins[j][i];
+        }
+        int n_games = n_wins + n_draws + n_losses;
+
+        MoveStats stats = {0, 0, 0};
+        for (size_t k = 0; k < workers.size(); ++k){
+            stats.moves += workers[k].stats[i].moves;
+            stats.total_ms += workers[k].stats[i].total_ms;
+            if (workers[k].stats[i].max_ms > stats.max_ms){
+                stats.max_ms = workers[k].stats[i].max_ms;
+            }
+        }
+
+        os<<setw(6)<<("[" + to_string(i) + "]")<<setw(8)<<n_games<<setw(8)<<n_wins
+          <<setw(8)<<n_draws<<setw(8)<<n_losses<<setw(7)<<fixed<<setprecision(1)
+          <<(n_games > 0 ? 100.0*(n_wins + 0.5*n_draws)/n_games : 0)<<"%"
+          <<setw(10)<<stats.moves<<setw(12)<<setprecision(3)
+          <<(stats.moves > 0 ? stats.total_ms/stats.moves : 0)
+          <<setw(12)<<stats.max_ms<<endl;
+    }
+}
+
+static void usage(const char* name){
+    cout<<"Usage: "<<name<<" [--games N] [--threads T] [--openings K] [--rows R]"
+        <<" [--cols C] [--seed S] [--out FILE] ENGINE ENGINE..."<<endl;
+    cout<<"ENGINE: alphabeta|mcts[:easy|medium|hard|expert][,depth=N][,time=MS]"
+        <<"[,playouts=N][,hash=MB][,nodes=N]"<<endl;
+}
+
+int main(int argc, char** argv){
+    Tournament t;
+    int n_games = DEFAULT_GAMES;
+    int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = 1;
+    const char* out_path = NULL;
+
+    t.rows = 6;
+    t.cols = 7;
+    t.openings = DEFAULT_OPENINGS;
+    t.next_game = 0;
+
+    for (int i = 1; i < argc; ++i){
+        if (strncmp(argv[i], "--", 2) == 0 && i+1 >= argc){
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--games") == 0){
+            n_games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0){
+            n_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--openings") == 0){
+            t.openings = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rows") == 0){
+            t.rows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cols") == 0){
+            t.cols = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0){
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--out") == 0){
+            out_path = argv[++i];
+        } else {
+            EngineConfig config;
+            if (!parseEngine(argv[i], &config)){
+                cout<<"Invalid engine: "<<argv[i]<<endl;
+                usage(argv[0]);
+                return 1;
+            }
+            t.configs.push_back(config);
+        }
+    }
+
+    if (t.configs.size() < 2 || n_games <= 0 || n_threads <= 0 || t.openings < 0
+            || t.rows <= 0 || t.cols <= 0 || t.cols > MCTS_MAX_COLS){
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!Connect4Bitboard::fits(t.rows, t.cols)){
+        for (size_t i = 0; i < t.configs.size(); ++i){
+            if (t.configs[i].type != ENGINE_MCTS){
+                cout<<t.configs[i].name<<" cannot play on a "<<t.rows<<"x"
+                    <<t.cols<<" board: columns*(rows+1) must be at most 64,"
+                    <<" larger boards are only supported by mcts"<<endl;
+                return 1;
+            }
+        }
+    }
+
+    // every pair plays n_games, colors are swapped at every game
+    for (size_t i = 0; i < t.configs.size(); ++i){
+        for (size_t j = i+1; j < t.configs.size(); ++j){
+            for (int g = 0; g < n_games; ++g){
+                Game game;
+                game.x = g % 2 == 0 ? i : j;
+                game.o = g % 2 == 0 ? j : i;
+                game.seed = seed + g/2;
+                game.result = 0;
+                t.games.push_back(game);
+            }
+        }
+    }
+
+    if ((size_t) n_threads > t.games.size()){
+        n_threads = t.games.size();
+    }
+
+    vector<Worker> workers(n_threads);
+    double start = nowMs();
+    try{
+        for (int k = 0; k < n_threads; ++k){
+            workers[k].t = &t;
+            for (size_t i = 0; i < t.configs.size(); ++i){
+                workers[k].engines.push_back(createEngine(t.configs[i]));
+                MoveStats stats = {0, 0, 0};
+                workers[k].stats.push_back(stats);
+            }
+        }
+
+        int n_started = 0;
+        for (int k = 0; k < n_threads; ++k){
+            if (pthread_create(&workers[k].thread, NULL, workerThread, &workers[k]) != 0){
+                LOG(LOG_WARN, "Could not start thread %d", k);
+                break;
+            }
+            n_started++;
+        }
+        if (n_started == 0){
+            // plays all the games on the main thread
+            workerThread(&workers[0]);
+        }
+        for (int k = 0; k < n_started; ++k){
+            pthread_join(workers[k].thread, NULL);
+        }
+    } catch(const char* msg){
+        LOG(LOG_FATAL, "%s", msg);
+        return 1;
+    }
+    double elapsed = nowMs() - start;
+
+    ofstream file;
+    if (out_path != NULL){
+        file.open(out_path);
+        if (!file){
+            LOG_PERROR(LOG_ERR, "Could not open %s: %s", out_path);
+            return 1;
+        }
+    }
+    ostream& os = out_path != NULL ? file : cout;
+
+    os<<t.games.size()<<" games in "<<fixed<<setprecision(1)<<elapsed/1000
+      <<" s on "<<n_threads<<" threads"<<endl<<endl;
+    printResults(os, t, workers);
+
+    for (size_t k = 0; k < workers.size(); ++k){
+        for (size_t i = 0; i < workers[k].engines.size(); ++i){
+            delete workers[k].engines[i];
+        }
+    }
+    return 0;
+}
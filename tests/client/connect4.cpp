@@ -0,0 +1,205 @@
+#include "connect4.h"
+#include "connect4_bitboard.h"
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static const int N_GAMES = 2000;
+
+/**
+ * Plays the same random game on both boards and checks that they always agree
+ */
+bool playRandomGame(int rows, int cols){
+    Connect4 c(rows, cols);
+    Connect4Bitboard b(rows, cols);
+    char player = 'X';
+    int ret_c, ret_b;
+
+    do {
+        int col = rand()%cols;
+        ret_c = c.play(col, player);
+        ret_b = b.play(col, player);
+        if (ret_c != ret_b){
+            printf("play() mismatch on %dx%d: %d != %d\n", rows, cols, ret_c, ret_b);
+            return false;
+        }
+        if (c.getHash() != b.getHash()){
+            printf("Hash mismatch on %dx%d\n", rows, cols);
+            return false;
+        }
+
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                if (c.checkWin(i, j, 'X') != b.checkWin(i, j, 'X')
+                    || c.checkWin(i, j, 'O') != b.checkWin(i, j, 'O')){
+                    printf("checkWin(%d, %d) mismatch on %dx%d\n", i, j, rows, cols);
+                    return false;
+                }
+            }
+        }
+
+        if (ret_c == 0){
+            player = player == 'X' ? 'O' : 'X';
+        }
+    } while (ret_c == 0 || ret_c == -1);
+
+    ostringstream os_c, os_b;
+    os_c << c;
+    os_b << b;
+    if (os_c.str() != os_b.str()){
+        printf("Printed boards differ on %dx%d\n", rows, cols);
+        return false;
+    }
+
+    // the hash depends only on the position, not on the order of the moves
+    Connect4Bitboard replay(rows, cols);
+    uint64_t hash = b.getHash();
+    for (int j = 0; j < cols; ++j){
+        for (int i = rows-1; i >= 0; --i){
+            if (b.getCell(i, j) != 0){
+                replay.makeMove(j, b.getCell(i, j));
+            }
+        }
+    }
+    if (replay.getHash() != hash){
+        printf("Hash depends on the order of the moves on %dx%d\n", rows, cols);
+        return false;
+    }
+
+    while (b.getNumMoves() > 0){
+        b.undo();
+    }
+    if (b.getHash() != 0){
+        printf("undo() does not restore the hash on %dx%d\n", rows, cols);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reference implementation of checkWin(), working on the cells of the board
+ */
+template <class Board>
+bool referenceCheckWin(const Board& b, int row, int col, char player){
+    int dirs[][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+    for (int d = 0; d < 4; ++d){
+        int count = 1;
+        for (int sign = -1; sign <= 1; sign += 2){
+            int i = row + sign*dirs[d][0], j = col + sign*dirs[d][1];
+            while (i >= 0 && j >= 0 && i < b.getNumRows() && j < b.getNumCols()
+                    && b.getCell(i, j) == player){
+                count++;
+                i += sign*dirs[d][0];
+                j += sign*dirs[d][1];
+            }
+        }
+        if (count >= N_IN_A_ROW){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Plays a random game checking the board against the reference
+ * implementation, also for sizes which do not fit in a Connect4Bitboard
+ */
+bool playReferenceGame(int rows, int cols){
+    Connect4 c(rows, cols);
+    char player = 'X';
+    int ret;
+
+    do {
+        int col = rand()%cols;
+        ret = c.play(col, player);
+
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                if (c.checkWin(i, j, 'X') != referenceCheckWin(c, i, j, 'X')
+                    || c.checkWin(i, j, 'O') != referenceCheckWin(c, i, j, 'O')){
+                    printf("checkWin(%d, %d) wrong on %dx%d\n", i, j, rows, cols);
+                    return false;
+                }
+            }
+        }
+
+        if (ret == 0){
+            player = player == 'X' ? 'O' : 'X';
+        }
+    } while (ret == 0 || ret == -1);
+
+    // copies must not share the cells
+    Connect4 copy(c);
+    Connect4 other(rows, cols);
+    other = c;
+    ostringstream os_c, os_copy, os_other;
+    os_c << c;
+    os_copy << copy;
+    os_other << other;
+    if (os_c.str() != os_copy.str() || os_c.str() != os_other.str()){
+        printf("Copies differ on %dx%d\n", rows, cols);
+        return false;
+    }
+
+    // undo() restores the previous positions and their hash
+    vector<int> cols_played;
+    vector<uint64_t> hashes;
+    while (copy.getNumMoves() > 0){
+        hashes.push_back(copy.getHash());
+        cols_played.push_back(copy.undo());
+    }
+    ostringstream os_empty, os_new;
+    os_empty << copy;
+    os_new << Connect4(rows, cols);
+    if (copy.getHash() != 0 || copy.undo() != -1 || os_empty.str() != os_new.str()){
+        printf("undo() does not empty the board on %dx%d\n", rows, cols);
+        return false;
+    }
+    player = 'X';
+    for (int k = cols_played.size()-1; k >= 0; --k){
+        copy.play(cols_played[k], player);
+        player = player == 'X' ? 'O' : 'X';
+        if (copy.getHash() != hashes[k]){
+            printf("Hash differs after undo() and play() on %dx%d\n", rows, cols);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(){
+    int sizes[][2] = {{6, 7}, {4, 4}, {5, 6}, {7, 8}, {6, 9}};
+
+    srand(42);
+
+    for (unsigned int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s){
+        for (int i = 0; i < N_GAMES; ++i){
+            if (!playRandomGame(sizes[s][0], sizes[s][1])){
+                return 1;
+            }
+        }
+    }
+
+    // sizes with a specialized board and a generic one
+    int reference_sizes[][2] = {{6, 7}, {7, 8}, {8, 9}, {5, 5}, {10, 12}};
+    for (unsigned int s = 0; s < sizeof(reference_sizes)/sizeof(reference_sizes[0]); ++s){
+        for (int i = 0; i < N_GAMES/10; ++i){
+            if (!playReferenceGame(reference_sizes[s][0], reference_sizes[s][1])){
+                return 1;
+            }
+        }
+    }
+
+    try{
+        Connect4Bitboard too_big(8, 9);
+        printf("8x9 board should not fit in a bitboard\n");
+        return 1;
+    } catch(const char* msg){
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "connect4.h"
+#include "connect4_bitboard.h"
+#include "mcts_player.h"
+#include <cstdio>
+#include <cstring>
+
+/**
+ * Plays a sequence of moves (columns from 1, X first) and returns the player
+ * to move
+ */
+template <class Board>
+static char playMoves(Board* board, const char* moves){
+    char player = 'X';
+    for (const char* m = moves; *m; ++m){
+        board->makeMove(*m-'1', player);
+        player = player == 'X' ? 'O' : 'X';
+    }
+    return player;
+}
+
+/**
+ * Checks that the AI plays the expected column in the given position
+ */
+static bool checkMove(MCTSPlayer& ai, const char* moves, int expected){
+    Connect4Bitboard board;
+    char player = playMoves(&board, moves);
+    int col = ai.chooseMove(board, player);
+    if (col != expected){
+        printf("%s: expected column %d, got %d (%d threads)\n", moves,
+               expected+1, col+1, ai.getThreads());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Same of checkMove() on a Connect4 of the given size
+ */
+static bool checkGenericMove(MCTSPlayer& ai, int rows, int cols,
+                             const char* moves, int expected){
+    Connect4 board(rows, cols);
+    char player = playMoves(&board, moves);
+    int col = ai.chooseMove(board, player);
+    if (col != expected){
+        printf("%s on %dx%d: expected column %d, got %d (%d threads)\n", moves,
+               rows, cols, expected+1, col+1, ai.getThreads());
+        return false;
+    }
+    return true;
+}
+
+int main(){
+    bool ok = true;
+    int threads[] = {1, 4};
+
+    for (unsigned int t = 0; t < sizeof(threads)/sizeof(threads[0]); ++t){
+        MCTSPlayer ai(MCTS_MEDIUM_PLAYOUTS, 0, MCTS_DEFAULT_NODES);
+        if (!ai.setThreads(threads[t])){
+            printf("Could not set %d threads\n", threads[t]);
+            return 1;
+        }
+
+        // X wins vertically in column 1
+        ok &= checkMove(ai, "121212", 0);
+        // O must block X in column 1
+        ok &= checkMove(ai, "12131", 0);
+        // X wins horizontally in column 4
+        ok &= checkMove(ai, "112233", 3);
+        // O must block the horizontal threat of X in column 4
+        ok &= checkMove(ai, "17273", 3);
+
+        // the same on a Connect4, copied to a bitboard
+        ok &= checkGenericMove(ai, 6, 7, "12131", 0);
+        // 8x9 does not fit in a bitboard: the search runs on the Connect4
+        ok &= checkGenericMove(ai, 8, 9, "121212", 0);
+        ok &= checkGenericMove(ai, 8, 9, "12131", 0);
+        ok &= checkGenericMove(ai, 8, 9, "112233", 3);
+        ok &= checkGenericMove(ai, 8, 9, "19293", 3);
+
+        if (ai.getLastPlayouts() < MCTS_MEDIUM_PLAYOUTS){
+            printf("Only %lu playouts\n", (unsigned long) ai.getLastPlayouts());
+            ok = false;
+        }
+        if (ai.getLastNodes() == 0 || ai.getLastNodes() > MCTS_DEFAULT_NODES){
+            printf("Invalid number of nodes: %u\n", ai.getLastNodes());
+            ok = false;
+        }
+    }
+
+    // a tiny tree must not overflow: the search goes on with playouts only
+    MCTSPlayer small(2000, 0, 100);
+    ok &= checkMove(small, "121212", 0);
+    if (small.getLastNodes() > 100){
+        printf("The tree exceeded its capacity: %u nodes\n", small.getLastNodes());
+        ok = false;
+    }
+
+    // time budget
+    MCTSPlayer timed(0, 50, MCTS_DEFAULT_NODES);
+    Connect4Bitboard empty;
+    int col = timed.chooseMove(empty, 'X');
+    if (col < 0 || col >= empty.getNumCols() || timed.getLastPlayouts() == 0){
+        printf("Invalid move with a time budget: %d\n", col);
+        ok = false;
+    }
+
+    if (ok){
+        printf("MCTS tests passed\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+#include "solver.h"
+#include "connect4.h"
+#include <cstdlib>
+#include <cstdio>
+
+using namespace std;
+
+static const int N_POSITIONS = 300;
+static const int N_ENDGAMES = 100;
+static const int ENDGAME_EMPTY_CELLS = 16;
+
+/** Standard 6x7 positions with their perfect-play score */
+static const struct {
+    const char* moves;
+    int score;
+} KNOWN_POSITIONS[] = {
+    // Pons benchmark, Test_L3_R1
+    {"2252576253462244111563365343671351441", -1},
+    {"7422341735647741166133573473242566", 1},
+    {"23163416124767223154467471272416755633", 0},
+    // X wins now by completing column 1: (42+1-6)/2
+    {"121212", 18},
+    // O cannot stop both ends of the bottom row: X wins with its 4th token
+    {"33445", -18},
+};
+
+static char other(char player){
+    return player == 'X' ? 'O' : 'X';
+}
+
+/**
+ * Checks that the score of a position is consistent with the scores of the
+ * positions after each move, and that the best move reaches it
+ */
+bool checkPosition(Solver& solver, Connect4Bitboard& board, char side){
+    int size = board.getNumRows()*board.getNumCols();
+    int score = solver.solve(board, side);
+    int best = -size;
+
+    for (int col = 0; col < board.getNumCols(); ++col){
+        if (!board.canPlay(col)){
+            continue;
+        }
+        int s;
+        if (board.isWinningMove(col, side)){
+            s = (size+1-board.getNumMoves())/2;
+        } else {
+            board.makeMove(col, side);
+            s = board.isFull() ? 0 : -solver.solve(board, other(side));
+            board.undo();
+        }
+        if (s > best){
+            best = s;
+        }
+    }
+
+    if (best != score){
+        printf("Score %d differs from the best move score %d\n", score, best);
+        return false;
+    }
+
+    int best_score;
+    int col = solver.bestMove(board, side, &best_score);
+    if (best_score != score || !board.canPlay(col)){
+        printf("Best move %d has score %d instead of %d\n", col, best_score, score);
+        return false;
+    }
+
+    int weak = solver.solve(board, side, true);
+    if (weak != (score > 0 ? 1 : score < 0 ? -1 : 0)){
+        printf("Weak score %d does not match score %d\n", weak, score);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reference negamax on the generic board, without any of the pruning of the
+ * solver apart from a plain alpha-beta, so that its scores are independent
+ * from the solver ones.
+ */
+int referenceScore(Connect4& board, char side, int alpha, int beta){
+    int size = board.getNumRows()*board.getNumCols();
+    int moves = board.getNumMoves();
+
+    for (int col = 0; col < board.getNumCols(); ++col){
+        int ret = board.play(col, side);
+        if (ret == -1){
+            continue;
+        }
+        board.undo();
+        if (ret == 1){
+            return (size+1-moves)/2;
+        }
+    }
+
+    int best = -size;
+    for (int col = 0; col < board.getNumCols() && alpha < beta; ++col){
+        int ret = board.play(col, side);
+        if (ret == -1){
+            continue;
+        }
+        int s = ret == -2 ? 0 : -referenceScore(board, other(side), -beta, -alpha);
+        board.undo();
+        if (s > best){
+            best = s;
+        }
+        if (best > alpha){
+            alpha = best;
+        }
+    }
+    return best;
+}
+
+/**
+ * Checks the score of a position against the expected one, both with
+ * solve() and bestMove()
+ */
+bool checkScore(Solver& solver, const char* moves, Connect4Bitboard& board,
+        char side, int expected){
+    int score = solver.solve(board, side);
+    int best_score;
+    solver.bestMove(board, side, &best_score);
+    if (score != expected || best_score != expected){
+        printf("%s: got %d (best move %d), expected %d\n", moves, score,
+                best_score, expected);
+        return false;
+    }
+    return true;
+}
+
+int main(){
+    int sizes[][2] = {{4, 5}, {5, 4}, {4, 4}};
+
+    srand(42);
+    Solver solver(4);
+
+    for (unsigned int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s){
+        for (int i = 0; i < N_POSITIONS; ++i){
+            Connect4Bitboard board(sizes[s][0], sizes[s][1]);
+            char side = 'X';
+            int n_moves = rand()%(sizes[s][0]*sizes[s][1]);
+
+            // random position where the game is not over
+            for (int m = 0; m < n_moves; ++m){
+                int col = rand()%sizes[s][1];
+                if (!board.canPlay(col) || board.isWinningMove(col, side)){
+                    continue;
+                }
+                board.makeMove(col, side);
+                side = other(side);
+                if (board.isFull()){
+                    board.undo();
+                    side = other(side);
+                    break;
+                }
+            }
+
+            if (!checkPosition(solver, board, side)){
+                return 1;
+            }
+        }
+    }
+
+    solver.reset();
+    for (unsigned int i = 0; i < sizeof(KNOWN_POSITIONS)/sizeof(KNOWN_POSITIONS[0]); ++i){
+        Connect4Bitboard board;
+        char side;
+        if (!Solver::playSequence(KNOWN_POSITIONS[i].moves, &board, &side)){
+            printf("%s: invalid sequence\n", KNOWN_POSITIONS[i].moves);
+            return 1;
+        }
+        if (!checkScore(solver, KNOWN_POSITIONS[i].moves, board, side,
+                KNOWN_POSITIONS[i].score)){
+            return 1;
+        }
+    }
+
+    // random 6x7 endgames, scored by the reference search
+    for (int i = 0; i < N_ENDGAMES; ++i){
+        Connect4Bitboard board;
+        Connect4 reference;
+        char side = 'X';
+        char moves[42+1];
+        int n_moves = 0, misses = 0;
+
+        while (n_moves < 42 - ENDGAME_EMPTY_CELLS && misses < 100){
+            int col = rand()%7;
+            if (!board.canPlay(col) || board.isWinningMove(col, side)){
+                misses++;
+                continue;
+            }
+            board.makeMove(col, side);
+            reference.play(col, side);
+            moves[n_moves++] = '1' + col;
+            side = other(side);
+        }
+        if (n_moves < 42 - ENDGAME_EMPTY_CELLS){
+            // no quiet move was left, try another position
+            i--;
+            continue;
+        }
+        moves[n_moves] = '\0';
+
+        int expected = referenceScore(reference, side, -42, 42);
+        if (!checkScore(solver, moves, board, side, expected)){
+            return 1;
+        }
+    }
+
+    Connect4Bitboard board;
+    char side;
+    if (Solver::playSequence("4455443322", &board, &side)){
+        printf("A sequence ending the game should not be valid\n");
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
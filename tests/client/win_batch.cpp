@@ -0,0 +1,57 @@
+#include "connect4_bitboard.h"
+#include "win_batch.h"
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+/** Not a multiple of the vector sizes, to check the leftovers too */
+static const size_t N_BOARDS = 10007;
+
+int main(){
+    int sizes[][2] = {{6, 7}, {4, 4}, {5, 6}, {7, 8}, {6, 9}};
+    enum WinBatchImpl impls[] = {WIN_BATCH_AUTO, WIN_BATCH_SCALAR, WIN_BATCH_SSE2, WIN_BATCH_AVX2};
+
+    srand(42);
+
+    for (unsigned int s = 0; s < sizeof(sizes)/sizeof(sizes[0]); ++s){
+        int rows = sizes[s][0], cols = sizes[s][1];
+        vector<Connect4Bitboard> boards(N_BOARDS, Connect4Bitboard(rows, cols));
+        vector<uint8_t> results(N_BOARDS);
+
+        for (size_t i = 0; i < N_BOARDS; ++i){
+            char player = 'X';
+            int n_moves = rand() % (rows*cols);
+            for (int m = 0; m < n_moves; ++m){
+                int col = rand() % cols;
+                if (boards[i].canPlay(col)){
+                    boards[i].makeMove(col, player);
+                    player = player == 'X' ? 'O' : 'X';
+                }
+            }
+        }
+
+        for (unsigned int k = 0; k < sizeof(impls)/sizeof(impls[0]); ++k){
+            if (!winBatchSupported(impls[k])){
+                printf("%s not supported, skipped\n", winBatchName(impls[k]));
+                continue;
+            }
+            for (int p = 0; p < 2; ++p){
+                char player = p == 0 ? 'X' : 'O';
+                checkWinBatch(&boards[0], N_BOARDS, player, &results[0], impls[k]);
+                for (size_t i = 0; i < N_BOARDS; ++i){
+                    bool expected = boards[i].hasAlignment(boards[i].getTokens(player));
+                    if (results[i] != expected){
+                        printf("%s mismatch on board %lu (%dx%d)\n",
+                            winBatchName(impls[k]), (unsigned long) i, rows, cols);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("OK\n");
+    return 0;
+}
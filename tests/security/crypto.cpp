@@ -130,6 +130,24 @@ int main(){
         return 1;
     }
 
+    // X25519
+    EVP_PKEY *xkeyA=NULL, *xkeyB=NULL;
+    get_eph_key(SUITE_X25519, &xkeyA);
+    get_eph_key(SUITE_X25519, &xkeyB);
+    if (!is_suite_key(SUITE_X25519, xkeyA) || is_suite_key(SUITE_P256, xkeyA)
+            || !is_suite_key(SUITE_P256, keyA)){
+        printf("Keys of the wrong suite\n");
+        return 1;
+    }
+
+    char *xsecretA=NULL, *xsecretB=NULL;
+    lenA = dhke(xkeyA, xkeyB, &xsecretA);
+    lenB = dhke(xkeyB, xkeyA, &xsecretB);
+    if (lenA != 32 || lenA != lenB || memcmp(xsecretA, xsecretB, lenA) != 0){
+        printf("X25519 secret is different\n");
+        return 1;
+    }
+
     // random
     int nonceA, nonceB;
     nonceA = get_rand();
@@ -232,6 +250,29 @@ int main(){
         return 1;
     }
 
+    // Ed25519
+    EVP_PKEY* ed_key = NULL;
+    EVP_PKEY_CTX* ed_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL);
+    if (ed_ctx == NULL || EVP_PKEY_keygen_init(ed_ctx) <= 0 
+            || EVP_PKEY_keygen(ed_ctx, &ed_key) <= 0){
+        printf("ERROR: Ed25519 keygen\n");
+        return 1;
+    }
+    EVP_PKEY_CTX_free(ed_ctx);
+
+    char *ed_signature;
+    sign_len = dsa_sign(plaintext, strlen(plaintext)+1, &ed_signature, ed_key);
+    if (sign_len != 64 || !dsa_verify(plaintext, strlen(plaintext)+1, 
+                                      ed_signature, sign_len, ed_key)){
+        printf("Ed25519 verify failed!\n");
+        return 1;
+    }
+    if (dsa_verify(long_plaintext, strlen(long_plaintext)+1, 
+                   ed_signature, sign_len, ed_key)){
+        printf("Ed25519 verify succeeded with wrong message!\n");
+        return 1;
+    }
+
 
 
 
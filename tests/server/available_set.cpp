@@ -0,0 +1,123 @@
+#include "available_set.h"
+#include "user.h"
+#include <cstdio>
+#include <vector>
+
+#define CHECK(cond) do { if (!(cond)){ \
+        printf("Failed at line %d: %s\n", __LINE__, #cond); return 1; } } while (0)
+
+#define N_USERS (2*MAX_USERS_IN_MESSAGE + 5)
+
+/**
+ * Creates an available user (without socket) and adds it to the set
+ */
+static User* addUser(AvailableSet* set, const string& username){
+    User* u = new User(NULL);
+    u->setUsername(username);
+    u->setState(AVAILABLE);
+    set->add(username, u);
+    return u;
+}
+
+static string name(int i){
+    char buf[16];
+    snprintf(buf, sizeof(buf), "user%02d", i);
+    return buf;
+}
+
+/**
+ * Returns the comma separated list of the users from first to last
+ */
+static string names(int first, int last){
+    string s;
+    for (int i = first; i <= last; i++){
+        if (i > first){
+            s += ",";
+        }
+        s += name(i);
+    }
+    return s;
+}
+
+int main(){
+    AvailableSet set;
+    vector<User*> users;
+    string next;
+
+    for (int i = N_USERS-1; i >= 0; i--){
+        users.push_back(addUser(&set, name(i)));
+    }
+    CHECK(set.size() == N_USERS);
+
+    // list, list more, list more: pages in order, until next is empty
+    const int M = MAX_USERS_IN_MESSAGE;
+    CHECK(set.list("", 0, M, &next) == names(0, M-1));
+    CHECK(next == name(M-1));
+    CHECK(set.list(next, 0, M, &next) == names(M, 2*M-1));
+    CHECK(next == name(2*M-1));
+    CHECK(set.list(next, 0, M, &next) == names(2*M, N_USERS-1));
+    CHECK(next == "");
+
+    // the cursor wins over the offset
+    CHECK(set.list(name(2), 7, 3, &next) == names(3, 5));
+    CHECK(next == name(5));
+
+    // a page ending exactly at the last user leaves next empty
+    CHECK(set.list(name(N_USERS-4), 0, 3, &next) == names(N_USERS-3, N_USERS-1));
+    CHECK(next == "");
+
+    // cursor at the last user
+    CHECK(set.list(name(N_USERS-1), 0, M, &next) == "");
+    CHECK(next == "");
+
+    // cursor past the last user, it needs not be in the set
+    CHECK(set.list("zzz", 0, M, &next) == "");
+    CHECK(next == "");
+
+    // offsets
+    CHECK(set.list("", 5, 3, &next) == names(5, 7));
+    CHECK(next == name(7));
+    CHECK(set.list("", N_USERS-1, M, &next) == name(N_USERS-1));
+    CHECK(next == "");
+    CHECK(set.list("", N_USERS, M, &next) == "");
+    CHECK(next == "");
+    CHECK(set.list("", N_USERS+100, M, &next) == "");
+    CHECK(next == "");
+
+    // users that are no longer available but still in the set are skipped,
+    // also across the page boundary
+    User* u9 = users[N_USERS-1-(M-1)];
+    User* u10 = users[N_USERS-1-M];
+    u9->setState(PLAYING);
+    u10->setState(PLAYING);
+    CHECK(set.list("", 0, M, &next) == names(0, M-2) + "," + name(M+1));
+    CHECK(next == name(M+1));
+    CHECK(set.list(next, 0, M, &next) == names(M+2, 2*M+1));
+    CHECK(next == name(2*M+1));
+    CHECK(set.list(name(M-2), 0, 1, &next) == name(M+1));
+    CHECK(next == name(M+1));
+    u9->setState(AVAILABLE);
+    u10->setState(AVAILABLE);
+
+    // remove() only removes the user owning the username
+    User* other = new User(NULL);
+    other->setUsername(name(3));
+    set.remove(name(3), other);
+    CHECK(set.size() == N_USERS);
+    CHECK(set.list(name(2), 0, 1, &next) == name(3));
+    set.remove(name(3), users[N_USERS-1-3]);
+    CHECK(set.size() == N_USERS-1);
+    CHECK(set.list(name(2), 0, 1, &next) == name(4));
+    delete other;
+
+    // removing an unknown username does nothing
+    set.remove("nobody", users[0]);
+    CHECK(set.size() == N_USERS-1);
+
+    for (size_t i = 0; i < users.size(); i++){
+        delete users[i];
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "mailbox.h"
+#include <cstdio>
+
+#define CHECK(cond) do { if (!(cond)){ \
+        printf("Failed at line %d: %s\n", __LINE__, #cond); return 1; } } while (0)
+
+/** Message that counts its deletions */
+class TestMessage : public Message{
+public:
+    int id;
+    static int deleted;
+    TestMessage(int id) : id(id) {}
+    ~TestMessage() {deleted++;}
+    msglen_t write(char *buffer) {return 0;}
+    msglen_t read(char *buffer, msglen_t len) {return 0;}
+    string getName() {return "TestMessage";}
+    MessageType getType() {return START_GAME_PEER;}
+};
+
+int TestMessage::deleted = 0;
+
+int main(){
+    bool scheduled;
+    {
+        Mailbox mb;
+
+        // the first post makes it runnable, the following ones do not
+        CHECK(mb.post(new TestMessage(1), 3, &scheduled) && scheduled);
+        CHECK(mb.post(new TestMessage(2), 3, &scheduled) && !scheduled);
+        CHECK(mb.post(new TestMessage(3), 3, &scheduled) && !scheduled);
+
+        // full
+        TestMessage* extra = new TestMessage(4);
+        CHECK(!mb.post(extra, 3, &scheduled));
+        delete extra;
+
+        // in order
+        Message* batch[3];
+        CHECK(mb.take(batch, 2) == 2);
+        for (int i = 0; i < 2; i++){
+            CHECK(((TestMessage*) batch[i])->id == i+1);
+            delete batch[i];
+        }
+
+        // still runnable while not drained
+        CHECK(mb.post(new TestMessage(5), 3, &scheduled) && !scheduled);
+        CHECK(mb.take(batch, 3) == 2);
+        CHECK(((TestMessage*) batch[0])->id == 3);
+        CHECK(((TestMessage*) batch[1])->id == 5);
+        delete batch[0];
+        delete batch[1];
+
+        // drained: idle again
+        CHECK(mb.take(batch, 3) == 0);
+        CHECK(mb.post(new TestMessage(6), 3, &scheduled) && scheduled);
+    }
+
+    // the leftover message is deleted with the mailbox
+    CHECK(TestMessage::deleted == 6);
+
+    printf("OK\n");
+    return 0;
+}
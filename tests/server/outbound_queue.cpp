@@ -0,0 +1,89 @@
+#include "outbound_queue.h"
+#include <cstdio>
+#include <cstring>
+
+#define CHECK(cond) do { if (!(cond)){ \
+        printf("Failed at line %d: %s\n", __LINE__, #cond); return 1; } } while (0)
+
+int main(){
+    OutboundQueue q(10);
+    struct iovec iov[4];
+
+    CHECK(q.empty());
+    CHECK(q.push("abcd", 4));
+    CHECK(q.push("efg", 3));
+    CHECK(q.size() == 7);
+
+    // over the high-water mark: rejected and nothing changes
+    CHECK(!q.push("hijk", 4));
+    CHECK(q.size() == 7);
+    CHECK(q.push("hij", 3));
+
+    CHECK(q.fillIov(iov, 4) == 3);
+    CHECK(iov[0].iov_len == 4 && memcmp(iov[0].iov_base, "abcd", 4) == 0);
+    CHECK(q.fillIov(iov, 2) == 2);
+
+    // partial write inside the second packet
+    q.consume(5);
+    CHECK(q.size() == 5);
+    CHECK(q.fillIov(iov, 4) == 2);
+    CHECK(iov[0].iov_len == 2 && memcmp(iov[0].iov_base, "fg", 2) == 0);
+    CHECK(iov[1].iov_len == 3 && memcmp(iov[1].iov_base, "hij", 3) == 0);
+
+    // room has been freed
+    CHECK(q.push("klmno", 5));
+
+    q.consume(2);
+    CHECK(q.fillIov(iov, 4) == 2);
+    CHECK(memcmp(iov[0].iov_base, "hij", 3) == 0);
+
+    q.consume(8);
+    CHECK(q.empty());
+    CHECK(q.fillIov(iov, 4) == 0);
+
+    q.push("x", 1);
+    q.clear();
+    CHECK(q.empty());
+
+    // asynchronous send, partially written
+    CHECK(q.push("abcd", 4));
+    CHECK(q.lendIov(iov, 4) == 1);
+    CHECK(q.isSending());
+    CHECK(q.push("ef", 2));
+    q.sent(3);
+    CHECK(!q.isSending() && q.size() == 3);
+    CHECK(q.lendIov(iov, 4) == 2);
+    CHECK(iov[0].iov_len == 1 && memcmp(iov[0].iov_base, "d", 1) == 0);
+    q.sent(3);
+    CHECK(q.empty());
+
+    // closed with a send in flight: the lent packets stay valid until the
+    // send completes, then everything is dropped
+    OutboundQueue c(10);
+    CHECK(c.push("abcd", 4));
+    CHECK(c.push("efg", 3));
+    CHECK(c.lendIov(iov, 4) == 2);
+    const char* lent = (const char*) iov[0].iov_base;
+    c.close();
+    CHECK(c.isSending() && c.size() == 7);
+    CHECK(memcmp(lent, "abcd", 4) == 0);
+    c.sent(5);
+    CHECK(!c.isSending() && c.empty());
+    CHECK(c.fillIov(iov, 4) == 0);
+
+    // closed with a failed send in flight
+    CHECK(c.push("abc", 3));
+    CHECK(c.lendIov(iov, 4) == 1);
+    c.close();
+    c.sent(0);
+    CHECK(c.empty());
+
+    // closed with no send in flight: dropped at once
+    OutboundQueue d(10);
+    CHECK(d.push("abc", 3));
+    d.close();
+    CHECK(d.empty() && !d.isSending());
+
+    printf("OK\n");
+    return 0;
+}
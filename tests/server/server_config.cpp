@@ -0,0 +1,64 @@
+#include "server_config.h"
+#include <cstdio>
+
+#define CHECK(cond) do { if (!(cond)){ \
+        printf("Failed at line %d: %s\n", __LINE__, #cond); return 1; } } while (0)
+
+int main(){
+    ServerConfig c;
+    CHECK(c.max_users == MAX_USERS);
+    CHECK(c.max_msg_size == MAX_MSG_SIZE);
+    CHECK(c.workers >= 1);
+    CHECK(c.use_uring);
+
+    CHECK(c.set("workers", "3") && c.workers == 3);
+    CHECK(!c.set("workers", "0") && c.workers == 3);
+    CHECK(!c.set("workers", "3x"));
+    CHECK(!c.set("max_msg_size", "100000"));
+    CHECK(!c.set("max_msg_size", "100"));
+    CHECK(c.set("max_msg_size", "32768") && c.max_msg_size == 32768);
+    CHECK(c.reactors == N_REACTORS);
+    CHECK(c.set("reactors", "1") && c.reactors == 1);
+    CHECK(!c.set("reactors", "0") && c.reactors == 1);
+    CHECK(c.outbound_high_water == MAX_OUTBOUND_BYTES);
+    CHECK(c.set("outbound_high_water", "1048576") && c.outbound_high_water == 1048576);
+    CHECK(!c.set("outbound_high_water", "10"));
+    CHECK(!c.set("no_such_key", "1"));
+    CHECK(c.set("backend", "epoll") && !c.use_uring);
+    CHECK(c.eph_key_pool == EPH_KEY_POOL_SIZE);
+    CHECK(c.set("eph_key_pool", "0") && c.eph_key_pool == 0);
+    CHECK(!c.set("eph_key_pool", "100000"));
+
+    FILE* f = fopen("test_server_config.conf", "w");
+    CHECK(f != NULL);
+    fprintf(f, "# comment\n\nmax_users = 100  # trailing comment\n"
+               "max_queue_length=50\nworkers = 2\n");
+    fclose(f);
+
+    // options override the file, wherever --config is
+    const char* argv[] = {"--workers", "8", "--config", "test_server_config.conf",
+                          "--io-uring", "--max-msg-size", "4096", "--reactors", "2",
+                          "--outbound-high-water", "65536"};
+    ServerConfig d;
+    CHECK(d.parseArgs(11, (char**) argv));
+    CHECK(d.outbound_high_water == 65536);
+    CHECK(d.reactors == 2);
+    CHECK(d.max_users == 100);
+    CHECK(d.max_queue_length == 50);
+    CHECK(d.workers == 8);
+    CHECK(d.max_msg_size == 4096);
+    CHECK(d.use_uring);
+
+    const char* bad[] = {"--workers"};
+    CHECK(!d.parseArgs(1, (char**) bad));
+
+    f = fopen("test_server_config.conf", "w");
+    fprintf(f, "workers\n");
+    fclose(f);
+    CHECK(!d.loadFile("test_server_config.conf"));
+    CHECK(!d.loadFile("no_such_file.conf"));
+    remove("test_server_config.conf");
+
+    printf("OK\n");
+    return 0;
+}
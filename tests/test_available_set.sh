@@ -0,0 +1,10 @@
+#!/bin/bash
+# This test checks the paging of the index of the available users
+
+dir=$(dirname $0)
+cd ${dir}/server
+g++ -g -O2 -DLOG_LEVEL=LOG_ERR -I ../../include -I ../../src -I ../../src/server available_set.cpp ../../src/server/available_set.cpp ../../src/server/mailbox.cpp -o test_available_set -lpthread
+./test_available_set
+RET=$?
+cd - > /dev/null
+exit $RET
@@ -0,0 +1,29 @@
+#!/bin/bash
+# This test builds a small opening book and checks that the AI uses it
+
+function cleanup {
+    rm -f "/tmp/test_book.book" "/tmp/clientBook.out"
+}
+trap cleanup EXIT
+
+
+dir=$(dirname $0)
+
+cd $dir
+
+../dist/tools/book_gen /tmp/test_book.book --plies 4 --depth 4 > /dev/null || exit 1
+
+../dist/client/client ../certs/mirko_cert.pem ../certs/mirko_key.pem ../certs/ca_cert.pem ../certs/ca_crl.pem < test_book/movesSP.txt  > /tmp/clientBook.out
+
+from_book=$(grep -c "from the opening book" "/tmp/clientBook.out")
+ended=$(grep -i "you won\|you lost\|is a draw" "/tmp/clientBook.out" | wc -l)
+
+cd - > /dev/null
+
+# moves 2 and 4 of the game are in the book
+if [ "$from_book" -eq "2" ] && [ "$ended" -eq "1" ]
+then
+    exit 0
+else
+    exit 1
+fi
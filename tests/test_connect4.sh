@@ -0,0 +1,10 @@
+#!/bin/bash
+# This test checks that the board implementations behave the same
+
+dir=$(dirname $0)
+cd ${dir}/client
+g++ -g -DLOG_LEVEL=LOG_ERR -I ../../include -I ../../src/client connect4.cpp ../../src/client/connect4.cpp ../../src/client/connect4_bitboard.cpp -o test_connect4
+./test_connect4
+RET=$?
+cd -
+exit $RET
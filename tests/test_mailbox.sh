@@ -0,0 +1,10 @@
+#!/bin/bash
+# This test checks the mailboxes of the users of the server
+
+dir=$(dirname $0)
+cd ${dir}/server
+g++ -g -O2 -I ../../include -I ../../src/server mailbox.cpp ../../src/server/mailbox.cpp -o test_mailbox -lpthread
+./test_mailbox
+RET=$?
+cd - > /dev/null
+exit $RET
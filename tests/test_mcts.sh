@@ -0,0 +1,12 @@
+#!/bin/bash
+# This test checks that the MCTS AI takes immediate wins and blocks immediate
+# losses, with one and several playout threads, also on boards larger than a
+# bitboard
+
+dir=$(dirname $0)
+cd ${dir}/client
+g++ -g -O2 -DLOG_LEVEL=LOG_ERR -I ../../include -I ../../src/client mcts.cpp ../../src/client/mcts_player.cpp ../../src/client/ai_player.cpp ../../src/client/transposition_table.cpp ../../src/client/opening_book.cpp ../../src/client/connect4.cpp ../../src/client/connect4_bitboard.cpp -lpthread -o test_mcts
+./test_mcts
+RET=$?
+cd - > /dev/null
+exit $RET
@@ -0,0 +1,10 @@
+#!/bin/bash
+# This test checks that the message queue neither loses nor duplicates items
+
+dir=$(dirname $0)
+cd ${dir}/utils
+g++ -g -O2 -I ../../include message_queue.cpp -o test_message_queue -lpthread
+timeout 60 ./test_message_queue
+RET=$?
+cd - > /dev/null
+exit $RET
@@ -0,0 +1,11 @@
+#!/bin/bash
+# This test checks the outbound queue of the server connections, also when a
+# connection is closed with a send in flight
+
+dir=$(dirname $0)
+cd ${dir}/server
+g++ -g -O2 -I ../../include -I ../../src/server outbound_queue.cpp ../../src/server/outbound_queue.cpp -o test_outbound_queue
+./test_outbound_queue
+RET=$?
+cd - > /dev/null
+exit $RET
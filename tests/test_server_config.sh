@@ -0,0 +1,10 @@
+#!/bin/bash
+# This test checks the parsing of the config file and options of the server
+
+dir=$(dirname $0)
+cd ${dir}/server
+g++ -g -O2 -I ../../include -I ../../src/server server_config.cpp ../../src/server/server_config.cpp -o test_server_config
+./test_server_config
+RET=$?
+cd - > /dev/null
+exit $RET
@@ -0,0 +1,17 @@
+#!/bin/bash
+# This test checks the consistency of the solver and its scores on some
+# positions of the Pons test sets, plus endgames scored by a plain negamax
+
+dir=$(dirname $0)
+cd ${dir}/client
+g++ -g -O2 -DLOG_LEVEL=LOG_ERR -I ../../include -I ../../src/client solver.cpp ../../src/client/solver.cpp ../../src/client/connect4.cpp ../../src/client/connect4_bitboard.cpp ../../src/client/transposition_table.cpp -o test_solver
+./test_solver
+RET=$?
+cd - > /dev/null
+
+if [ "$RET" -eq "0" ]
+then
+    ${dir}/../dist/tools/solver --hash 16 --bench ${dir}/solver/positions.txt
+    RET=$?
+fi
+exit $RET
@@ -0,0 +1,37 @@
+#!/bin/bash
+# This test runs a short tournament and checks that all the games are counted,
+# then checks that only mcts plays on a board larger than a bitboard
+
+function cleanup {
+    rm -f "/tmp/tournament.out"
+}
+trap cleanup EXIT
+
+dir=$(dirname $0)
+
+${dir}/../dist/tools/tournament --games 6 --threads 2 --out /tmp/tournament.out \
+    alphabeta:easy alphabeta:depth=4 mcts:playouts=500 > /dev/null || exit 1
+
+cat /tmp/tournament.out
+
+# 3 pairs of 6 games, every engine plays 12 of them
+games=$(grep -c "^ *\[[0-9]\] *12 " /tmp/tournament.out)
+total=$(grep -c "^18 games" /tmp/tournament.out)
+
+if [ "$games" -ne "3" ] || [ "$total" -ne "1" ]
+then
+    exit 1
+fi
+
+# boards larger than a bitboard are only played by mcts
+${dir}/../dist/tools/tournament --games 2 --threads 2 --rows 8 --cols 9 \
+    --out /tmp/tournament.out mcts:playouts=200 mcts:playouts=500 > /dev/null \
+    || exit 1
+grep -q "^2 games" /tmp/tournament.out || exit 1
+
+if ${dir}/../dist/tools/tournament --games 2 --rows 8 --cols 9 \
+    alphabeta:easy mcts:playouts=200 > /dev/null
+then
+    exit 1
+fi
+exit 0
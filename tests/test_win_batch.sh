@@ -0,0 +1,10 @@
+#!/bin/bash
+# This test checks that the batched win check agrees with the scalar one
+
+dir=$(dirname $0)
+cd ${dir}/client
+g++ -g -O2 -DLOG_LEVEL=LOG_ERR -I ../../include -I ../../src/client win_batch.cpp ../../src/client/win_batch.cpp ../../src/client/connect4.cpp ../../src/client/connect4_bitboard.cpp -o test_win_batch
+./test_win_batch
+RET=$?
+cd - > /dev/null
+exit $RET
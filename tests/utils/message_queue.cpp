@@ -0,0 +1,84 @@
+#include "utils/message_queue.h"
+#include <cstdio>
+#include <unistd.h>
+#include <pthread.h>
+
+#define CHECK(cond) do { if (!(cond)){ \
+        printf("Failed at line %d: %s\n", __LINE__, #cond); return 1; } } while (0)
+
+#define N_THREADS_TEST 8
+#define ITEMS 100000
+
+typedef MessageQueue<long,1000> queue_t;
+
+static queue_t queue;
+static long received_sum = 0;
+static long received_count = 0;
+
+static void* producer(void* arg){
+    long id = (long) arg;
+    for (long i = 0; i < ITEMS; ++i){
+        while (!queue.pushSignal(id*ITEMS + i + 1)){
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void* consumer(void* arg){
+    long sum = 0, count = 0, e;
+    while ((e = queue.pullWait()) != 0){
+        sum += e;
+        count++;
+    }
+    __atomic_fetch_add(&received_sum, sum, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&received_count, count, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int main(){
+    pthread_t producers[N_THREADS_TEST], consumers[N_THREADS_TEST];
+    long e;
+
+    // bounded: the capacity is rounded up to 1024
+    MessageQueue<long,1000>* q = new MessageQueue<long,1000>();
+    CHECK(q->empty() && !q->tryPull(&e));
+    for (long i = 0; i < 1024; ++i){
+        CHECK(q->push(i));
+    }
+    CHECK(!q->push(1024));
+    CHECK(q->size() == 1024);
+    for (long i = 0; i < 1024; ++i){
+        CHECK(q->tryPull(&e) && e == i);
+    }
+    CHECK(q->empty());
+    delete q;
+
+    // consumers are already sleeping when the items arrive
+    for (int t = 0; t < N_THREADS_TEST; ++t){
+        pthread_create(&consumers[t], NULL, consumer, NULL);
+    }
+    usleep(100000);
+    for (long t = 0; t < N_THREADS_TEST; ++t){
+        pthread_create(&producers[t], NULL, producer, (void*) t);
+    }
+    for (int t = 0; t < N_THREADS_TEST; ++t){
+        pthread_join(producers[t], NULL);
+    }
+    for (int t = 0; t < N_THREADS_TEST; ++t){
+        while (!queue.pushSignal(0)){
+            sched_yield();
+        }
+    }
+    for (int t = 0; t < N_THREADS_TEST; ++t){
+        pthread_join(consumers[t], NULL);
+    }
+
+    long n = (long) N_THREADS_TEST*ITEMS;
+    CHECK(received_count == n);
+    CHECK(received_sum == n*(n+1)/2);
+    CHECK(queue.empty());
+
+    printf("OK\n");
+    return 0;
+}